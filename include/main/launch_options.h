@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace loquat
+{
+	/// <summary>
+	/// Settings chosen on the command line when the program is started.
+	/// Everything defaults to what a shipped build wants.
+	/// </summary>
+	struct LaunchOptions
+	{
+		/// <summary>
+		/// Watch the resource folder and reload resources as they change.
+		/// Watched resources are copied rather than mapped, so this is only
+		/// for editing resources while the program runs. Set with --watch.
+		/// </summary>
+		bool watch_resources = false;
+
+		/// <summary>
+		/// Where to write the resource cache's stats when the program exits,
+		/// empty to not write them. Set with --cache-stats followed by the
+		/// file name.
+		/// </summary>
+		std::string cache_stats_path;
+
+		/// <summary>
+		/// Keep what resource loaders produce on disk between runs. Set with
+		/// --derived-cache, or by giving a directory with
+		/// --derived-cache-dir.
+		/// </summary>
+		bool use_derived_data = false;
+
+		/// <summary>
+		/// Where loader output is kept. Defaults to a folder in the user's
+		/// cache directory, see get_default_derived_data_directory.
+		/// </summary>
+		std::string derived_data_directory;
+
+		/// <summary>
+		/// The most disk space loader output can take, in megabytes. Set with
+		/// --derived-cache-size.
+		/// </summary>
+		size_t derived_data_size_in_MB = 512;
+
+		/// <summary>
+		/// Let resources with the same contents share one buffer. Set with
+		/// --dedupe.
+		/// </summary>
+		bool deduplicate_resources = false;
+
+		/// <summary>
+		/// How far past its size the resource cache can go when what it holds
+		/// is in use, in megabytes. Set with --hard-limit. Zero leaves the
+		/// hard limit at the cache size.
+		/// </summary>
+		size_t resource_hard_limit_in_MB = 0;
+	};
+
+	/// <summary>
+	/// The folder loader output is kept in if no other is given. That is
+	/// loquat/derived under $XDG_CACHE_HOME or ~/.cache, or under
+	/// %LOCALAPPDATA% on Windows.
+	/// </summary>
+	/// <returns>The folder, empty if the user has no cache directory.
+	/// </returns>
+	[[nodiscard]]
+	std::string get_default_derived_data_directory() noexcept;
+
+	/// <summary>
+	/// Read the launch options from the command line. Anything that isn't
+	/// understood is logged and skipped.
+	/// </summary>
+	/// <param name="argc">The number of arguments, including the program.
+	/// </param>
+	/// <param name="argv">The arguments, starting with the program.</param>
+	/// <param name="options">Filled in with the options given.</param>
+	/// <returns>Whether every argument was understood.</returns>
+	[[nodiscard]]
+	bool parse_launch_options(int argc, char* argv[], LaunchOptions& options)
+		noexcept;
+}
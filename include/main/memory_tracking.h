@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "main/memory_utils.h"
+
+namespace loquat
+{
+	/// <summary>
+	/// The subsystems memory is counted against.
+	/// </summary>
+	enum class MemoryTag
+	{
+		General,
+		Geometry,
+		BVH,
+		Textures,
+		Film,
+		ResourceCache,
+		Logger,
+		Count
+	};
+
+	/// <summary>
+	/// The name of a tag, for reports.
+	/// </summary>
+	[[nodiscard]]
+	const char* get_memory_tag_name(const MemoryTag tag) noexcept;
+
+	/// <summary>
+	/// The resource every tagged resource allocates through, so it counts
+	/// all tracked memory together.
+	/// </summary>
+	[[nodiscard]]
+	TrackedMemoryResource& get_root_memory_resource() noexcept;
+
+	/// <summary>
+	/// The resource a subsystem should allocate from, so its memory is
+	/// counted against it. The resources live for the whole program.
+	/// </summary>
+	/// <param name="tag">The subsystem.</param>
+	[[nodiscard]]
+	TrackedMemoryResource& get_memory_resource(const MemoryTag tag) noexcept;
+
+	/// <summary>
+	/// An allocator over a subsystem's resource, to pass to anything that
+	/// takes an Allocator.
+	/// </summary>
+	/// <param name="tag">The subsystem.</param>
+	[[nodiscard]]
+	Allocator get_tagged_allocator(const MemoryTag tag) noexcept;
+
+	/// <summary>
+	/// An allocator over an object pool for a subsystem, for code that makes
+	/// lots of small objects from many threads, like scene setup. The pool's
+	/// slabs are counted against the subsystem, and are only given back when
+	/// the program exits.
+	/// </summary>
+	/// <param name="tag">The subsystem.</param>
+	[[nodiscard]]
+	Allocator get_pooled_allocator(const MemoryTag tag) noexcept;
+
+	/// <summary>
+	/// How much memory one tag, or everything, is using.
+	/// </summary>
+	struct MemoryUsage
+	{
+		/// <summary>
+		/// The tag's name.
+		/// </summary>
+		const char* name = "";
+
+		/// <summary>
+		/// The bytes in use when the report was made.
+		/// </summary>
+		size_t current_bytes = 0;
+
+		/// <summary>
+		/// The most bytes that have been in use at once.
+		/// </summary>
+		size_t peak_bytes = 0;
+
+		/// <summary>
+		/// The number of allocations made so far.
+		/// </summary>
+		uint64_t allocations = 0;
+	};
+
+	/// <summary>
+	/// A snapshot of the memory used by each subsystem.
+	/// </summary>
+	struct MemoryReport
+	{
+		/// <summary>
+		/// One entry for each tag, in tag order.
+		/// </summary>
+		std::vector<MemoryUsage> tags;
+
+		/// <summary>
+		/// Everything tracked, from the root resource. Its peak is the peak
+		/// of the total, which can be less than the sum of the tags' peaks.
+		/// </summary>
+		MemoryUsage total;
+
+		/// <summary>
+		/// Format the report, one tag per line.
+		/// </summary>
+		[[nodiscard]]
+		std::string to_string() const noexcept;
+	};
+
+	/// <summary>
+	/// Take a snapshot of the memory used by each subsystem. This only reads
+	/// counters, so it is cheap enough to call every frame.
+	/// </summary>
+	[[nodiscard]]
+	MemoryReport memory_report() noexcept;
+}
@@ -1,9 +1,12 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <cstdint>
+#include <cstring>
 #include <memory_resource>
 #include <new>
-#include <list>
+#include <utility>
 
 #ifdef __cpp_lib_hardware_interference_size
     using std::hardware_constructive_interference_size;
@@ -134,6 +137,12 @@ namespace loquat
 		}
 	}
 
+	/// <summary>
+	/// A memory resource that counts what goes through it, passing the
+	/// allocations on to another resource. Resources can be chained under a
+	/// parent, which then counts everything its children do, so one root
+	/// sees the whole program and each child one subsystem.
+	/// </summary>
 	class TrackedMemoryResource : public std::pmr::memory_resource
 	{
 	public:
@@ -142,18 +151,23 @@ namespace loquat
 			: source{ source }
 		{}
 
+		/// <summary>
+		/// Track memory under a parent, which allocates it.
+		/// </summary>
+		/// <param name="name">What the memory is for, for reports.</param>
+		/// <param name="parent">The resource to allocate from.</param>
+		TrackedMemoryResource(const char* name,
+			TrackedMemoryResource* parent) noexcept
+			: source{ parent }
+			, parent{ parent }
+			, name{ name }
+		{}
+
 		void* do_allocate(size_t size, size_t alignment) noexcept
 		{
 			void* ptr = source->allocate(size, alignment);
-			uint64_t current_bytes = allocated_bytes.fetch_add(size) + size;
-			uint64_t previous_max =
-				max_allocated_bytes.load(std::memory_order_relaxed);
-
-			while (previous_max < current_bytes && !max_allocated_bytes
-				.compare_exchange_weak(previous_max, current_bytes))
-			{
-			}
-
+			allocation_count.fetch_add(1, std::memory_order_relaxed);
+			add_bytes(size);
 			return ptr;
 		}
 
@@ -168,6 +182,35 @@ namespace loquat
 			return this == &other;
 		}
 
+		/// <summary>
+		/// Count memory the subsystem got some other way, like pages mapped
+		/// straight from the system, here and in every parent.
+		/// </summary>
+		/// <param name="size">The number of bytes.</param>
+		void track_external(size_t size) noexcept
+		{
+			for (TrackedMemoryResource* resource = this; resource != nullptr;
+				resource = resource->parent)
+			{
+				resource->allocation_count.fetch_add(1,
+					std::memory_order_relaxed);
+				resource->add_bytes(size);
+			}
+		}
+
+		/// <summary>
+		/// Stop counting memory passed to track_external, once it is freed.
+		/// </summary>
+		/// <param name="size">The number of bytes.</param>
+		void untrack_external(size_t size) noexcept
+		{
+			for (TrackedMemoryResource* resource = this; resource != nullptr;
+				resource = resource->parent)
+			{
+				resource->allocated_bytes -= size;
+			}
+		}
+
 		size_t CurrentAllocatedBytes() const noexcept
 		{
 			return allocated_bytes.load();
@@ -178,10 +221,44 @@ namespace loquat
 			return max_allocated_bytes.load();
 		}
 
+		/// <summary>
+		/// The number of allocations made through the resource, including
+		/// tracked external ones.
+		/// </summary>
+		[[nodiscard]]
+		uint64_t get_allocation_count() const noexcept
+		{
+			return allocation_count.load(std::memory_order_relaxed);
+		}
+
+		/// <summary>
+		/// What the memory is for.
+		/// </summary>
+		[[nodiscard]]
+		const char* get_name() const noexcept
+		{
+			return name;
+		}
+
 	private:
+		void add_bytes(size_t size) noexcept
+		{
+			uint64_t current_bytes = allocated_bytes.fetch_add(size) + size;
+			uint64_t previous_max =
+				max_allocated_bytes.load(std::memory_order_relaxed);
+
+			while (previous_max < current_bytes && !max_allocated_bytes
+				.compare_exchange_weak(previous_max, current_bytes))
+			{
+			}
+		}
+
 		std::pmr::memory_resource* source;
+		TrackedMemoryResource* parent = nullptr;
+		const char* name = "root";
 		std::atomic<uint64_t> allocated_bytes{ 0 };
 		std::atomic<uint64_t> max_allocated_bytes{ 0 };
+		std::atomic<uint64_t> allocation_count{ 0 };
 	};
 
 	template <typename T>
@@ -202,26 +279,75 @@ namespace loquat
 		struct Invalid {};
 	};
 
+	/// <summary>
+	/// How a ScratchBuffer picks the size of a new block when it runs out.
+	/// </summary>
+	struct ScratchGrowthPolicy
+	{
+		/// <summary>
+		/// Each new block is this many times the size of the one before.
+		/// </summary>
+		size_t growth_factor = 2;
+
+		/// <summary>
+		/// New blocks aren't made bigger than this by growth alone, though a
+		/// single allocation that needs more still gets a block that fits.
+		/// </summary>
+		size_t max_block_size = 16 * 1024 * 1024;
+	};
+
+	/// <summary>
+	/// Where a ScratchBuffer was at some point, to rewind to.
+	/// </summary>
+	struct ScratchMark
+	{
+		/// <summary>
+		/// The block that was being allocated from.
+		/// </summary>
+		void* block = nullptr;
+
+		/// <summary>
+		/// How far into that block the buffer had allocated.
+		/// </summary>
+		size_t offset = 0;
+	};
+
+	/// <summary>
+	/// A bump allocator for short lived allocations, like the BSDFs made
+	/// while evaluating one pixel sample. Everything is freed at once by
+	/// reset, or back to a mark by rewind.
+	/// 
+	/// Memory comes in blocks chained through headers kept at the start of
+	/// each block, so growing never allocates anything but the block. When
+	/// the current block runs out the next one in the chain is used, or a
+	/// bigger one is added. Blocks are only given back on reset, where they
+	/// are merged into one block big enough for everything that was used.
+	/// So after the first few resets a buffer that sees the same work every
+	/// time stops allocating altogether.
+	/// </summary>
 	class alignas(hardware_destructive_interference_size) ScratchBuffer
 	{
 	public:
 		ScratchBuffer(size_t size = 256) noexcept
-			: allocation_size{ size }
 		{
-			pointer = (char*)g_allocator->allocate_bytes(size, align);
+			head = allocate_block(size);
+			current = head;
 		}
 
 		ScratchBuffer(const ScratchBuffer&) = delete;
 
 		ScratchBuffer(ScratchBuffer&& other) noexcept
-			: pointer{ other.pointer }
-			, allocation_size{ other.allocation_size }
+			: head{ other.head }
+			, current{ other.current }
 			, offset{ other.offset }
-			, small_buffers{ std::move(other.small_buffers) }
+			, growth{ other.growth }
+			, poison_on_reset{ other.poison_on_reset }
+			, block_allocations{ other.block_allocations }
 		{
-			other.pointer = nullptr;
-			other.allocation_size = 0;
+			other.head = nullptr;
+			other.current = nullptr;
 			other.offset = 0;
+			other.block_allocations = 0;
 		}
 
 		ScratchBuffer& operator=(const ScratchBuffer&) = delete;
@@ -229,32 +355,31 @@ namespace loquat
 		ScratchBuffer& operator=(ScratchBuffer&& other) noexcept
 		{
 			using std::swap;
-			swap(other.pointer, pointer);
-			swap(other.allocation_size, allocation_size);
+			swap(other.head, head);
+			swap(other.current, current);
 			swap(other.offset, offset);
-			swap(other.small_buffers, small_buffers);
+			swap(other.growth, growth);
+			swap(other.poison_on_reset, poison_on_reset);
+			swap(other.block_allocations, block_allocations);
 
 			return *this;
 		}
 
 		~ScratchBuffer() noexcept
 		{
-			reset();
-			g_allocator->deallocate_bytes(pointer, allocation_size, align);
+			free_blocks(head);
 		}
 
 		void* allocate(size_t size, size_t align) noexcept
 		{
-			if (offset % align != 0)
+			char* ptr = align_up(data(current) + offset, align);
+			if (static_cast<size_t>(ptr - data(current)) + size
+				> current->size)
 			{
-				offset += align - (offset % align);
+				advance(size, align);
+				ptr = align_up(data(current) + offset, align);
 			}
-			if (offset + size > allocation_size)
-			{
-				reallocate(size);
-			}
-			void* ptr = pointer + offset;
-			offset += size;
+			offset = static_cast<size_t>(ptr - data(current)) + size;
 			return ptr;
 		}
 
@@ -263,7 +388,8 @@ namespace loquat
 			noexcept
 		{
 			T* ptr = (T*) allocate(sizeof(T), alignof(T));
-			return g_allocator->construct(ptr, std::forward<Args>(args)...);
+			g_allocator->construct(ptr, std::forward<Args>(args)...);
+			return ptr;
 		}
 
 		template <typename T>
@@ -281,34 +407,220 @@ namespace loquat
 			return ret;
 		}
 
+		/// <summary>
+		/// Remember where the buffer is, so everything allocated after this
+		/// can be freed by rewind without touching what came before. Meant
+		/// for nested work, like evaluating the BxDFs of one BSDF.
+		/// </summary>
+		[[nodiscard]]
+		ScratchMark mark() const noexcept
+		{
+			return ScratchMark{ current, offset };
+		}
+
+		/// <summary>
+		/// Free everything allocated since a mark. Blocks added since then
+		/// are kept for the next allocations to use.
+		/// </summary>
+		/// <param name="mark">A mark from this buffer, taken since the last
+		/// reset.</param>
+		void rewind(const ScratchMark mark) noexcept
+		{
+			if (poison_on_reset)
+			{
+				Block* block = static_cast<Block*>(mark.block);
+				poison(block, mark.offset, block == current ? offset
+					: block->size);
+				while (block != current)
+				{
+					block = block->next;
+					poison(block, 0, block == current ? offset
+						: block->size);
+				}
+			}
+			current = static_cast<Block*>(mark.block);
+			offset = mark.offset;
+		}
+
+		/// <summary>
+		/// Free everything allocated since the last reset. If the buffer had
+		/// to grow, every block is merged into one that holds all of them,
+		/// so the same work next time fits without growing.
+		/// </summary>
 		void reset() noexcept
 		{
-			for (const auto& buffer : small_buffers)
+			if (head == nullptr)
 			{
-				g_allocator->deallocate_bytes(buffer.first, buffer.second,
-					align);
+				return;
+			}
+			if (poison_on_reset)
+			{
+				rewind(ScratchMark{ head, 0 });
 			}
-			small_buffers.clear();
+			if (head->next != nullptr)
+			{
+				const size_t high_water = get_capacity();
+				free_blocks(head);
+				head = allocate_block(high_water);
+			}
+			current = head;
 			offset = 0;
 		}
 
-	private:
+		/// <summary>
+		/// Set how new blocks are sized when the buffer runs out.
+		/// </summary>
+		void set_growth_policy(const ScratchGrowthPolicy policy) noexcept
+		{
+			growth = policy;
+		}
 
-		void reallocate(size_t min_size) noexcept
+		/// <summary>
+		/// Fill freed memory with a pattern on reset and rewind, so anything
+		/// still pointing into it shows up as garbage rather than quietly
+		/// reading stale data. For debugging, since it touches every byte.
+		/// </summary>
+		void set_poison_on_reset(const bool enable) noexcept
 		{
-			small_buffers.push_back(std::make_pair(pointer, allocation_size));
-			allocation_size = 
-				std::max(2 * min_size, allocation_size + min_size);
-			pointer = (char*) 
-				g_allocator->allocate_bytes(allocation_size, align);
-			offset = 0;
+			poison_on_reset = enable;
+		}
+
+		/// <summary>
+		/// The number of blocks taken from the global allocator over the
+		/// buffer's life. Once a render loop reaches a steady state this
+		/// stops going up.
+		/// </summary>
+		[[nodiscard]]
+		size_t get_block_allocations() const noexcept
+		{
+			return block_allocations;
+		}
+
+		/// <summary>
+		/// The usable size of every block in the chain together.
+		/// </summary>
+		[[nodiscard]]
+		size_t get_capacity() const noexcept
+		{
+			size_t capacity = 0;
+			for (const Block* block = head; block != nullptr;
+				block = block->next)
+			{
+				capacity += block->size;
+			}
+			return capacity;
 		}
 
+		/// <summary>
+		/// The byte freed memory is filled with in poison mode.
+		/// </summary>
+		static constexpr unsigned char POISON = 0xcd;
+
+	private:
+		/// <summary>
+		/// The header at the start of each block. The usable memory starts
+		/// one alignment unit in, so it is as aligned as the block.
+		/// </summary>
+		struct Block
+		{
+			Block* next;
+			size_t size;
+		};
+
 		static constexpr size_t align 
 			= hardware_destructive_interference_size;
-		char* pointer = nullptr;
-		size_t allocation_size = 0;
+		static_assert(sizeof(Block) <= align);
+
+		[[nodiscard]]
+		static char* data(Block* block) noexcept
+		{
+			return reinterpret_cast<char*>(block) + align;
+		}
+
+		[[nodiscard]]
+		static char* align_up(char* ptr, const size_t alignment) noexcept
+		{
+			const uintptr_t address = reinterpret_cast<uintptr_t>(ptr);
+			return ptr + ((alignment - address % alignment) % alignment);
+		}
+
+		[[nodiscard]]
+		Block* allocate_block(size_t size) noexcept
+		{
+			++block_allocations;
+			Block* block = static_cast<Block*>(
+				g_allocator->allocate_bytes(align + size, align));
+			block->next = nullptr;
+			block->size = size;
+			return block;
+		}
+
+		static void free_blocks(Block* block) noexcept
+		{
+			while (block != nullptr)
+			{
+				Block* next = block->next;
+				g_allocator->deallocate_bytes(block, align + block->size,
+					align);
+				block = next;
+			}
+		}
+
+		static void poison(Block* block, const size_t from, const size_t to)
+			noexcept
+		{
+			if (from < to)
+			{
+				memset(data(block) + from, POISON, to - from);
+			}
+		}
+
+		/// <summary>
+		/// Move to a block with room for an allocation, reusing the next one
+		/// in the chain if it is big enough, and adding a block after the
+		/// current one if not.
+		/// </summary>
+		void advance(const size_t size, const size_t alignment) noexcept
+		{
+			//NOTE(ches) blocks start aligned to align, so only bigger
+			// alignments can need padding at the start
+			const size_t needed = size + (alignment > align ? alignment : 0);
+			if (current->next != nullptr && current->next->size >= needed)
+			{
+				current = current->next;
+				offset = 0;
+				return;
+			}
+
+			const size_t grown = std::min(current->size * growth.growth_factor,
+				growth.max_block_size);
+			Block* block = allocate_block(std::max(grown, needed));
+			block->next = current->next;
+			current->next = block;
+			current = block;
+			offset = 0;
+		}
+
+		Block* head = nullptr;
+		Block* current = nullptr;
 		size_t offset = 0;
-		std::list<std::pair<char*, size_t>> small_buffers;
+		ScratchGrowthPolicy growth;
+		bool poison_on_reset = false;
+		size_t block_allocations = 0;
 	};
+
+	/// <summary>
+	/// The calling thread's own scratch buffer, created the first time the
+	/// thread asks. Render workers should use this rather than making their
+	/// own, and reset it after each pixel sample, so the blocks it has grown
+	/// to are kept from one sample to the next.
+	/// </summary>
+	/// <returns>The thread's scratch buffer.</returns>
+	[[nodiscard]]
+	inline ScratchBuffer& get_thread_scratch_buffer() noexcept
+	{
+		//NOTE(ches) big enough that most samples never grow it
+		thread_local ScratchBuffer scratch_buffer{ 64 * 1024 };
+		return scratch_buffer;
+	}
 }
\ No newline at end of file
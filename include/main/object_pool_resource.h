@@ -0,0 +1,272 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <mutex>
+
+#include "main/memory_utils.h"
+
+namespace loquat
+{
+	/// <summary>
+	/// A snapshot of how much memory an object pool is holding on to.
+	/// </summary>
+	struct ObjectPoolStats
+	{
+		/// <summary>
+		/// The number of slabs taken from upstream.
+		/// </summary>
+		size_t slab_count = 0;
+
+		/// <summary>
+		/// The bytes in those slabs.
+		/// </summary>
+		size_t slab_bytes = 0;
+
+		/// <summary>
+		/// The number of objects too big, or too strictly aligned, for a
+		/// size class, which went straight to upstream.
+		/// </summary>
+		size_t large_count = 0;
+
+		/// <summary>
+		/// The bytes in those objects.
+		/// </summary>
+		size_t large_bytes = 0;
+
+		/// <summary>
+		/// The number of objects freed by a thread other than the one that
+		/// allocated them.
+		/// </summary>
+		uint64_t remote_frees = 0;
+
+		/// <summary>
+		/// The number of threads that have allocated from the pool.
+		/// </summary>
+		size_t thread_count = 0;
+	};
+
+	/// <summary>
+	/// A memory resource for the millions of small objects a scene is built
+	/// from, such as shapes, primitives, textures and materials.
+	///
+	/// Objects are rounded up to a multiple of 16 bytes and carved out of
+	/// slabs, one set of slabs per size class, with no header per object.
+	/// Every thread has its own free list for each class, so threads building
+	/// the scene in parallel never wait on each other. An object freed by a
+	/// thread other than the one that allocated it is pushed onto the
+	/// allocating thread's list of remote frees without taking a lock, and
+	/// that thread takes the whole list back the next time its own free list
+	/// runs dry.
+	///
+	/// Slabs are only given back to upstream when the pool is destroyed, so
+	/// the pool must outlive everything allocated from it. Anything bigger
+	/// than MAX_CLASS_SIZE goes straight to upstream. Deallocation needs the
+	/// same size and alignment that were passed to allocate.
+	///
+	/// To opt in, pass an Allocator over the pool to scene setup instead of
+	/// g_allocator, see get_pooled_allocator.
+	/// </summary>
+	class ObjectPoolResource : public std::pmr::memory_resource
+	{
+	public:
+		/// <summary>
+		/// The size of a slab. A slab is aligned to its size, so the slab an
+		/// object belongs to can be found from its address.
+		/// </summary>
+		static constexpr size_t SLAB_SIZE = size_t{ 64 } * 1024;
+
+		/// <summary>
+		/// The step between size classes, which is also the alignment every
+		/// pooled object gets.
+		/// </summary>
+		static constexpr size_t CLASS_GRANULARITY = 16;
+
+		/// <summary>
+		/// The largest object that comes from a slab.
+		/// </summary>
+		static constexpr size_t MAX_CLASS_SIZE = 256;
+
+		/// <summary>
+		/// The number of size classes, from CLASS_GRANULARITY to
+		/// MAX_CLASS_SIZE.
+		/// </summary>
+		static constexpr size_t CLASS_COUNT =
+			MAX_CLASS_SIZE / CLASS_GRANULARITY;
+
+		/// <summary>
+		/// The most threads that get their own free lists. Threads beyond
+		/// this share one set of lists behind a lock.
+		/// </summary>
+		static constexpr size_t MAX_THREADS = 256;
+
+		/// <summary>
+		/// Create a pool.
+		/// </summary>
+		/// <param name="upstream">Where slabs and large objects come from.
+		/// It must outlive the pool.</param>
+		explicit ObjectPoolResource(std::pmr::memory_resource* upstream =
+			std::pmr::get_default_resource()) noexcept;
+		ObjectPoolResource(const ObjectPoolResource&) = delete;
+		ObjectPoolResource& operator=(const ObjectPoolResource&) = delete;
+
+		/// <summary>
+		/// Give every slab back to upstream.
+		/// </summary>
+		~ObjectPoolResource();
+
+		/// <summary>
+		/// Take a snapshot of the pool's memory use.
+		/// </summary>
+		[[nodiscard]]
+		ObjectPoolStats get_stats() const noexcept;
+
+	protected:
+		void* do_allocate(size_t size, size_t alignment) noexcept override;
+		void do_deallocate(void* pointer, size_t size, size_t alignment)
+			noexcept override;
+		bool do_is_equal(const std::pmr::memory_resource& other) const
+			noexcept override;
+
+	private:
+		struct ThreadCache;
+
+		/// <summary>
+		/// The header at the start of every slab.
+		/// </summary>
+		struct Slab
+		{
+			/// <summary>
+			/// The thread cache that carves objects out of the slab, and
+			/// that objects freed on other threads are sent back to.
+			/// </summary>
+			ThreadCache* owner = nullptr;
+
+			/// <summary>
+			/// The next slab the pool has taken, so they can all be given
+			/// back.
+			/// </summary>
+			Slab* next = nullptr;
+
+			/// <summary>
+			/// The size class of the slab's objects.
+			/// </summary>
+			uint32_t size_class = 0;
+		};
+
+		/// <summary>
+		/// An object that has been freed, linked through its first bytes.
+		/// </summary>
+		struct FreeObject
+		{
+			FreeObject* next;
+		};
+
+		/// <summary>
+		/// One thread's objects of one size class.
+		/// </summary>
+		struct alignas(hardware_destructive_interference_size) ClassCache
+		{
+			/// <summary>
+			/// Objects freed by the owning thread.
+			/// </summary>
+			FreeObject* free_list = nullptr;
+
+			/// <summary>
+			/// The part of the newest slab that has never been handed out.
+			/// </summary>
+			char* untouched = nullptr;
+			char* untouched_end = nullptr;
+
+			/// <summary>
+			/// Objects freed by other threads, pushed without a lock and
+			/// only ever taken all at once, by the owning thread.
+			/// </summary>
+			std::atomic<FreeObject*> remote_frees{ nullptr };
+		};
+
+		/// <summary>
+		/// Everything one thread allocates through.
+		/// </summary>
+		struct ThreadCache
+		{
+			std::array<ClassCache, CLASS_COUNT> classes;
+
+			/// <summary>
+			/// The number of objects other threads have sent back.
+			/// </summary>
+			std::atomic<uint64_t> remote_frees{ 0 };
+		};
+
+		/// <summary>
+		/// Where slabs and large objects come from.
+		/// </summary>
+		std::pmr::memory_resource* upstream;
+
+		/// <summary>
+		/// Each thread's cache, by thread slot, created the first time the
+		/// thread allocates. Only the thread in a slot sets its entry.
+		/// </summary>
+		std::array<std::atomic<ThreadCache*>, MAX_THREADS> caches{};
+
+		/// <summary>
+		/// The cache shared by threads that didn't get a slot.
+		/// </summary>
+		ThreadCache overflow_cache;
+
+		/// <summary>
+		/// Guards the overflow cache, apart from its remote frees.
+		/// </summary>
+		std::mutex overflow_mutex;
+
+		/// <summary>
+		/// Every slab taken, newest first.
+		/// </summary>
+		std::atomic<Slab*> slabs{ nullptr };
+
+		std::atomic<size_t> slab_count{ 0 };
+		std::atomic<size_t> large_count{ 0 };
+		std::atomic<size_t> large_bytes{ 0 };
+		std::atomic<size_t> thread_count{ 0 };
+
+		/// <summary>
+		/// The calling thread's cache.
+		/// </summary>
+		/// <returns>The cache, null if the thread didn't get a slot.
+		/// </returns>
+		[[nodiscard]]
+		ThreadCache* get_thread_cache() noexcept;
+
+		/// <summary>
+		/// Take an object out of a cache.
+		/// </summary>
+		/// <param name="cache">The cache, which the caller must own.</param>
+		/// <param name="size_class">The object's size class.</param>
+		/// <returns>The object, null if upstream is out of memory.</returns>
+		[[nodiscard]]
+		void* allocate_from(ThreadCache& cache, size_t size_class) noexcept;
+
+		/// <summary>
+		/// Give a cache a fresh slab to carve objects out of.
+		/// </summary>
+		/// <returns>Whether upstream had the memory.</returns>
+		[[nodiscard]]
+		bool add_slab(ThreadCache& cache, size_t size_class) noexcept;
+
+		/// <summary>
+		/// Find the slab an object was carved out of.
+		/// </summary>
+		[[nodiscard]]
+		static Slab* get_slab(void* pointer) noexcept;
+
+		/// <summary>
+		/// Whether an allocation is small enough, and loosely enough aligned,
+		/// to come from a slab.
+		/// </summary>
+		[[nodiscard]]
+		static bool is_pooled(size_t size, size_t alignment) noexcept;
+	};
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+#include "main/memory_tracking.h"
+#include "main/memory_utils.h"
+
+namespace loquat
+{
+	/// <summary>
+	/// A snapshot of how much memory a scene arena is holding on to.
+	/// </summary>
+	struct SceneArenaStats
+	{
+		/// <summary>
+		/// The number of chunks mapped.
+		/// </summary>
+		size_t chunk_count = 0;
+
+		/// <summary>
+		/// The bytes mapped for those chunks.
+		/// </summary>
+		size_t mapped_bytes = 0;
+
+		/// <summary>
+		/// The bytes handed out, including alignment padding.
+		/// </summary>
+		size_t used_bytes = 0;
+
+		/// <summary>
+		/// The bytes in chunks the system gave us huge pages for outright.
+		/// </summary>
+		size_t huge_page_bytes = 0;
+
+		/// <summary>
+		/// The bytes in chunks where we only asked the system to back them
+		/// with huge pages when it can, which it may or may not have done.
+		/// </summary>
+		size_t advised_bytes = 0;
+
+		/// <summary>
+		/// Whether the arena has been made read only.
+		/// </summary>
+		bool sealed = false;
+	};
+
+	/// <summary>
+	/// A memory resource for scene data that is built once and then only
+	/// read while rendering, like geometry, BVH nodes and spectra.
+	///
+	/// Memory is handed out by bumping a pointer through chunks that are
+	/// whole multiples of HUGE_PAGE_SIZE, and aligned to it, so the system
+	/// can back them with huge pages and traversal takes far fewer TLB
+	/// misses than it would with the data spread across the heap. Chunks
+	/// come from explicit huge pages when the system has some reserved,
+	/// otherwise from ordinary pages the system is asked to back with huge
+	/// pages, and otherwise from ordinary pages.
+	///
+	/// Nothing is freed until the arena is released or destroyed. Once the
+	/// scene is built, the arena can be sealed, which makes every chunk read
+	/// only so that a stray write faults straight away rather than quietly
+	/// changing the scene.
+	///
+	/// Allocation is thread safe. Failure returns null rather than throwing.
+	/// </summary>
+	class SceneArena : public std::pmr::memory_resource
+	{
+	public:
+		/// <summary>
+		/// The size of a huge page, which chunks are sized and aligned to.
+		/// </summary>
+		static constexpr size_t HUGE_PAGE_SIZE = size_t{ 2 } * 1024 * 1024;
+
+		/// <summary>
+		/// The default size of a chunk.
+		/// </summary>
+		static constexpr size_t DEFAULT_CHUNK_SIZE = 8 * HUGE_PAGE_SIZE;
+
+		/// <summary>
+		/// Create an arena. No memory is mapped until the first allocation.
+		/// </summary>
+		/// <param name="tag">The subsystem the mapped memory is counted
+		/// against.</param>
+		/// <param name="chunk_size">The size of each chunk, rounded up to a
+		/// whole number of huge pages. Bigger allocations get a chunk of
+		/// their own.</param>
+		explicit SceneArena(const MemoryTag tag = MemoryTag::Geometry,
+			const size_t chunk_size = DEFAULT_CHUNK_SIZE) noexcept;
+		SceneArena(const SceneArena&) = delete;
+		SceneArena& operator=(const SceneArena&) = delete;
+
+		/// <summary>
+		/// Unmap every chunk.
+		/// </summary>
+		~SceneArena();
+
+		/// <summary>
+		/// Make every chunk read only. Allocating from a sealed arena fails.
+		/// </summary>
+		/// <returns>Whether the system protected every chunk.</returns>
+		[[nodiscard]]
+		bool seal() noexcept;
+
+		/// <summary>
+		/// Make every chunk writable again, so the scene can be edited or
+		/// added to.
+		/// </summary>
+		/// <returns>Whether the system unprotected every chunk.</returns>
+		[[nodiscard]]
+		bool unseal() noexcept;
+
+		/// <summary>
+		/// Unmap every chunk, freeing everything allocated from the arena at
+		/// once. The arena can be used again afterwards.
+		/// </summary>
+		void release() noexcept;
+
+		/// <summary>
+		/// Take a snapshot of the arena's memory use.
+		/// </summary>
+		[[nodiscard]]
+		SceneArenaStats get_stats() const noexcept;
+
+	protected:
+		void* do_allocate(size_t size, size_t alignment) noexcept override;
+		void do_deallocate(void* pointer, size_t size, size_t alignment)
+			noexcept override;
+		bool do_is_equal(const std::pmr::memory_resource& other) const
+			noexcept override;
+
+	private:
+		/// <summary>
+		/// How a chunk's pages came from the system.
+		/// </summary>
+		enum class PageKind
+		{
+			Huge,
+			Advised,
+			Ordinary
+		};
+
+		/// <summary>
+		/// One mapping.
+		/// </summary>
+		struct Chunk
+		{
+			char* pages = nullptr;
+			size_t size = 0;
+			PageKind kind = PageKind::Ordinary;
+		};
+
+		/// <summary>
+		/// The subsystem the mapped memory is counted against.
+		/// </summary>
+		MemoryTag tag;
+
+		/// <summary>
+		/// The size of each chunk, a multiple of HUGE_PAGE_SIZE.
+		/// </summary>
+		size_t chunk_size;
+
+		/// <summary>
+		/// Guards everything below.
+		/// </summary>
+		mutable std::mutex mutex;
+
+		/// <summary>
+		/// Every chunk mapped, in the order they were mapped.
+		/// </summary>
+		std::vector<Chunk> chunks;
+
+		/// <summary>
+		/// The part of the current chunk that hasn't been handed out.
+		/// </summary>
+		char* cursor = nullptr;
+		char* end = nullptr;
+
+		/// <summary>
+		/// The bytes handed out, including alignment padding.
+		/// </summary>
+		size_t used_bytes = 0;
+
+		bool sealed = false;
+
+		/// <summary>
+		/// Map a new chunk and remember it.
+		/// </summary>
+		/// <param name="size">The size of the chunk, a multiple of
+		/// HUGE_PAGE_SIZE.</param>
+		/// <returns>The chunk, null on failure.</returns>
+		[[nodiscard]]
+		Chunk* add_chunk(size_t size) noexcept;
+
+		/// <summary>
+		/// Change whether every chunk can be written to.
+		/// </summary>
+		[[nodiscard]]
+		bool set_writable(bool writable) noexcept;
+	};
+}
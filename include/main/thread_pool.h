@@ -0,0 +1,66 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace loquat
+{
+	/// <summary>
+	/// A fixed set of worker threads that run jobs from a shared queue, in
+	/// the order they were submitted.
+	/// </summary>
+	class ThreadPool
+	{
+	public:
+		/// <summary>
+		/// A unit of work to run on one of the workers.
+		/// </summary>
+		using Job = std::function<void()>;
+
+		/// <summary>
+		/// Start the worker threads.
+		/// </summary>
+		/// <param name="thread_count">The number of workers. Zero means one
+		/// worker per hardware thread.</param>
+		explicit ThreadPool(size_t thread_count) noexcept;
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		ThreadPool(ThreadPool&&) = delete;
+		ThreadPool& operator=(ThreadPool&&) = delete;
+
+		/// <summary>
+		/// Finish every job that was already queued, then stop the workers.
+		/// </summary>
+		~ThreadPool();
+
+		/// <summary>
+		/// Queue a job to run on the next free worker.
+		/// </summary>
+		/// <param name="job">The job to run.</param>
+		void enqueue(Job job) noexcept;
+
+		/// <summary>
+		/// The number of worker threads.
+		/// </summary>
+		/// <returns>How many workers the pool has.</returns>
+		[[nodiscard]]
+		size_t size() const noexcept;
+
+	private:
+		/// <summary>
+		/// The loop each worker runs until the pool shuts down.
+		/// </summary>
+		void work() noexcept;
+
+		std::vector<std::thread> workers;
+		std::deque<Job> jobs;
+		std::mutex job_mutex;
+		std::condition_variable job_available;
+		bool stopping = false;
+	};
+}
@@ -105,6 +105,15 @@ namespace loquat
 			Sampler sampler, ScratchBuffer& scratch_buffer) = 0;
 
 	protected:
+		/// <summary>
+		/// Evaluate a pixel sample with the calling thread's scratch buffer,
+		/// then reset it. render runs every sample through this, so it
+		/// doesn't touch the global allocator once the buffers have grown to
+		/// fit.
+		/// </summary>
+		void run_pixel_sample(Point2i pixel, int sample_index,
+			Sampler sampler);
+
 		Camera camera;
 		Sampler sampler_prototype;
 	};
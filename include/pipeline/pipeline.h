@@ -27,14 +27,29 @@ namespace loquat
 		VkPipeline graphics_pipeline = nullptr;
 		std::vector<VkFramebuffer> frame_buffers;
 
+		/// <summary>
+		/// Set when one of the shaders has been reloaded, meaning the
+		/// pipeline needs to be recreated to pick it up.
+		/// </summary>
+		bool outdated = false;
+
 	private:
+		friend void recreate_pipeline() noexcept;
+
 		std::unique_ptr<Shader> shader;
 		VkPipelineLayout layout = nullptr;
 		std::vector<VkDynamicState> dynamic_states;
+		std::vector<size_t> shader_subscriptions;
 	};
 
 	void create_pipeline() noexcept;
 
+	/// <summary>
+	/// Rebuild the pipeline around its existing shader, after the shader
+	/// modules have been reloaded. Waits for the device to be idle first.
+	/// </summary>
+	void recreate_pipeline() noexcept;
+
 	/// <summary>
 	/// Set up frame buffers for the pipeline.
 	/// </summary>
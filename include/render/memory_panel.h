@@ -0,0 +1,12 @@
+#pragma once
+
+namespace loquat::render
+{
+	/// <summary>
+	/// Draw a window with how much memory each subsystem is using, to find
+	/// out what grew when memory runs short. Must be called between ImGui
+	/// frames.
+	/// </summary>
+	/// <param name="open">Set to false when the window is closed.</param>
+	void draw_memory_panel(bool* open) noexcept;
+}
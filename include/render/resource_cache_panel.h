@@ -0,0 +1,11 @@
+#pragma once
+
+namespace loquat::render
+{
+	/// <summary>
+	/// Draw a window with the resource cache's stats, for tuning its size
+	/// and eviction policy. Must be called between ImGui frames.
+	/// </summary>
+	/// <param name="open">Set to false when the window is closed.</param>
+	void draw_resource_cache_panel(bool* open) noexcept;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include "resource/resource_eviction_policy.h"
+#include "resource/resource_lru_list.h"
+
+namespace loquat
+{
+	/// <summary>
+	/// Adaptive replacement, weighted by size.
+	///
+	/// Resources that have only been used once since they were loaded live
+	/// in the recent list, and move to the frequent list the second time they
+	/// are used. We also remember the names of resources recently evicted
+	/// from each list. Loading one of those again means we gave its list too
+	/// little room, so the target size of the recent list moves towards
+	/// whichever list it came from. A scan over lots of resources that are
+	/// only used once just cycles through the recent list, leaving the
+	/// frequent list alone.
+	/// </summary>
+	class ARCEvictionPolicy : public ResourceEvictionPolicy
+	{
+		/// <summary>
+		/// Which list a handle is in, stored in the handle.
+		/// </summary>
+		enum Queue : uint8_t
+		{
+			QUEUE_NONE = 0,
+			QUEUE_RECENT,
+			QUEUE_FREQUENT
+		};
+
+		/// <summary>
+		/// A resource that was evicted, which we only remember by name.
+		/// </summary>
+		struct Ghost
+		{
+			/// <summary>
+			/// The name of the resource.
+			/// </summary>
+			std::string name;
+
+			/// <summary>
+			/// How many bytes it used.
+			/// </summary>
+			size_t size;
+
+			/// <summary>
+			/// The list it was evicted from.
+			/// </summary>
+			Queue queue;
+		};
+
+		using GhostList = std::list<Ghost>;
+
+		/// <summary>
+		/// The number of bytes the shard is expected to hold.
+		/// </summary>
+		const size_t capacity;
+
+		/// <summary>
+		/// How many bytes we would like the recent list to use. Adapts as
+		/// ghosts are hit.
+		/// </summary>
+		size_t recent_target = 0;
+
+		/// <summary>
+		/// Handles that have been used once, most recent first.
+		/// </summary>
+		ResourceLRUList recent;
+
+		/// <summary>
+		/// Handles that have been used more than once, most recent first.
+		/// </summary>
+		ResourceLRUList frequent;
+
+		/// <summary>
+		/// The bytes charged for the handles in each list.
+		/// </summary>
+		size_t recent_bytes = 0;
+		size_t frequent_bytes = 0;
+
+		/// <summary>
+		/// Resources evicted from each list, most recent first.
+		/// </summary>
+		GhostList recent_ghosts;
+		GhostList frequent_ghosts;
+
+		/// <summary>
+		/// The bytes the resources in each ghost list used to take up.
+		/// </summary>
+		size_t recent_ghost_bytes = 0;
+		size_t frequent_ghost_bytes = 0;
+
+		/// <summary>
+		/// Finds ghosts by name.
+		/// </summary>
+		std::unordered_map<std::string, GhostList::iterator> ghosts;
+
+		/// <summary>
+		/// Remember an evicted handle.
+		/// </summary>
+		/// <param name="handle">The handle being evicted.</param>
+		/// <param name="queue">The list it was in.</param>
+		void add_ghost(const ResourceHandle* handle, Queue queue) noexcept;
+
+		/// <summary>
+		/// Forget a ghost.
+		/// </summary>
+		/// <param name="ghost">The ghost to forget.</param>
+		void remove_ghost(GhostList::iterator ghost) noexcept;
+
+		/// <summary>
+		/// Forget the oldest ghosts until the ghost lists are no larger than
+		/// the cache they describe.
+		/// </summary>
+		void trim_ghosts() noexcept;
+
+	public:
+		/// <summary>
+		/// Create a policy for a shard.
+		/// </summary>
+		/// <param name="capacity">The number of bytes the shard is expected
+		/// to hold.</param>
+		explicit ARCEvictionPolicy(size_t capacity) noexcept;
+
+		virtual void insert(ResourceHandle* handle) noexcept;
+		virtual void touch(ResourceHandle* handle) noexcept;
+		virtual void remove(ResourceHandle* handle) noexcept;
+		[[nodiscard]]
+		virtual ResourceHandle* evict() noexcept;
+	};
+}
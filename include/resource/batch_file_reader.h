@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace loquat
+{
+	/// <summary>
+	/// One read in a batch: a range of a file, and where to put it.
+	/// </summary>
+	struct FileRead
+	{
+		/// <summary>
+		/// The full path of the file.
+		/// </summary>
+		std::string path;
+
+		/// <summary>
+		/// Where to start reading, from the start of the file.
+		/// </summary>
+		size_t offset = 0;
+
+		/// <summary>
+		/// How many bytes to read.
+		/// </summary>
+		size_t length = 0;
+
+		/// <summary>
+		/// Where to put them, with room for at least length bytes.
+		/// </summary>
+		char* buffer = nullptr;
+
+		/// <summary>
+		/// Filled in with the number of bytes actually read, which is less
+		/// than the length if the file was shorter or could not be read.
+		/// </summary>
+		size_t bytes_read = 0;
+	};
+
+	/// <summary>
+	/// Reads many files at once, so the storage device always has a deep
+	/// queue of requests to work on instead of one file at a time.
+	/// </summary>
+	class BatchFileReader
+	{
+	public:
+		virtual ~BatchFileReader() = default;
+
+		/// <summary>
+		/// Open and read every file in a batch, and wait for all of them.
+		/// Safe to call from several threads, though batches from different
+		/// threads may be serialized.
+		/// </summary>
+		/// <param name="reads">The reads to do. Each one's bytes_read is
+		/// filled in.</param>
+		virtual void read(std::vector<FileRead>& reads) noexcept = 0;
+
+		/// <summary>
+		/// A short name for the kind of reader, for logging.
+		/// </summary>
+		/// <returns>The name of the reader.</returns>
+		[[nodiscard]]
+		virtual const char* get_name() const noexcept = 0;
+	};
+
+	/// <summary>
+	/// Create the best batch reader the platform supports. That is io_uring
+	/// on Linux kernels that have it, and otherwise a pool of threads doing
+	/// blocking reads.
+	/// </summary>
+	/// <param name="queue_depth">The most reads to have in flight at once.
+	/// </param>
+	/// <param name="thread_count">The number of threads for the fallback
+	/// reader.</param>
+	/// <returns>The reader, allocated with alloc.</returns>
+	[[nodiscard]]
+	BatchFileReader* make_batch_file_reader(size_t queue_depth,
+		size_t thread_count) noexcept;
+}
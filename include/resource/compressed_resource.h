@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace loquat
+{
+	/// <summary>
+	/// The header at the very start of a compressed resource.
+	///
+	/// The header is followed by the chunks, in order. Each chunk starts with
+	/// a 32 bit little endian size, followed by that many bytes of data. If
+	/// the top bit of the size is set the data is stored as is, otherwise it
+	/// is an lz_compress block. Every chunk but the last decodes to exactly
+	/// chunk_size bytes.
+	/// </summary>
+	struct CompressedResourceHeader
+	{
+		/// <summary>
+		/// Always "LQLZ".
+		/// </summary>
+		char magic[4];
+
+		/// <summary>
+		/// The version of the compressed format.
+		/// </summary>
+		uint32_t version;
+
+		/// <summary>
+		/// The size of the resource after decompression, in bytes.
+		/// </summary>
+		uint64_t decoded_size;
+
+		/// <summary>
+		/// The decoded size of each chunk, in bytes.
+		/// </summary>
+		uint32_t chunk_size;
+
+		/// <summary>
+		/// The number of chunks that follow the header.
+		/// </summary>
+		uint32_t chunk_count;
+	};
+
+	/// <summary>
+	/// The version of the compressed format that we read and write.
+	/// </summary>
+	constexpr uint32_t COMPRESSED_RESOURCE_VERSION = 1;
+
+	/// <summary>
+	/// The default decoded size of a chunk. Matches can't reach further back
+	/// than this anyways, so larger chunks barely compress better.
+	/// </summary>
+	constexpr uint32_t COMPRESSED_RESOURCE_CHUNK_SIZE = 64 * 1024;
+
+	/// <summary>
+	/// Read the header out of a compressed resource, checking that it is
+	/// valid.
+	/// </summary>
+	/// <param name="raw_buffer">The start of the compressed resource.</param>
+	/// <param name="raw_size">The number of bytes available, which only has
+	/// to cover the header.</param>
+	/// <param name="header">Set to the header if it is valid.</param>
+	/// <returns>Whether the header is valid.</returns>
+	[[nodiscard]]
+	bool read_compressed_header(const char* raw_buffer, size_t raw_size,
+		CompressedResourceHeader& header) noexcept;
+
+	/// <summary>
+	/// Read the decoded size out of a compressed resource, checking that the
+	/// header is valid.
+	/// </summary>
+	/// <param name="raw_buffer">The compressed resource.</param>
+	/// <param name="raw_size">The size of the compressed resource, in bytes.
+	/// </param>
+	/// <param name="decoded_size">Set to the decoded size if the header is
+	/// valid.</param>
+	/// <returns>Whether the header is valid.</returns>
+	[[nodiscard]]
+	bool compressed_resource_size(const char* raw_buffer, size_t raw_size,
+		size_t& decoded_size) noexcept;
+
+	/// <summary>
+	/// Compress data into chunks, in the compressed resource format.
+	/// </summary>
+	/// <param name="data">The data to compress.</param>
+	/// <param name="size">The size of the data, in bytes.</param>
+	/// <param name="output">Where to write the compressed resource. Any
+	/// existing contents are replaced.</param>
+	/// <param name="chunk_size">The decoded size of each chunk, in bytes.
+	/// </param>
+	/// <returns>Whether the data was compressed successfully.</returns>
+	bool compress_resource(const char* data, size_t size,
+		std::vector<char>& output,
+		uint32_t chunk_size = COMPRESSED_RESOURCE_CHUNK_SIZE) noexcept;
+
+	/// <summary>
+	/// Decompress a compressed resource one chunk at a time, straight into
+	/// the destination, so there is never a second full size copy.
+	/// </summary>
+	/// <param name="raw_buffer">The compressed resource.</param>
+	/// <param name="raw_size">The size of the compressed resource, in bytes.
+	/// </param>
+	/// <param name="destination">Where to write the decoded data.</param>
+	/// <param name="destination_size">The size of the destination, which
+	/// must match the decoded size in the header.</param>
+	/// <returns>Whether the whole resource decoded successfully.</returns>
+	[[nodiscard]]
+	bool decompress_resource(const char* raw_buffer, size_t raw_size,
+		char* destination, size_t destination_size) noexcept;
+
+	/// <summary>
+	/// Return the number of bytes stored for a chunk, from the size in front
+	/// of it.
+	/// </summary>
+	/// <param name="chunk_header">The chunk's 32 bit size.</param>
+	/// <returns>The number of bytes that follow the size.</returns>
+	[[nodiscard]]
+	size_t compressed_chunk_stored_size(uint32_t chunk_header) noexcept;
+
+	/// <summary>
+	/// Decode a single chunk, for reading a compressed resource a chunk at a
+	/// time instead of all at once.
+	/// </summary>
+	/// <param name="chunk_header">The chunk's 32 bit size.</param>
+	/// <param name="input">The chunk's stored bytes, as many as
+	/// compressed_chunk_stored_size says.</param>
+	/// <param name="destination">Where to write the decoded data.</param>
+	/// <param name="decoded_size">The size the chunk decodes to, which is
+	/// the header's chunk size for every chunk but the last.</param>
+	/// <returns>Whether the chunk decoded to exactly that size.</returns>
+	[[nodiscard]]
+	bool decompress_chunk(uint32_t chunk_header, const char* input,
+		char* destination, size_t decoded_size) noexcept;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "resource/resource_loader.h"
+
+namespace loquat
+{
+	class ResourceHandle;
+
+	/// <summary>
+	/// Loads compressed resources, see compressed_resource.h, which are named
+	/// with a .lz extension.
+	///
+	/// The raw buffer is never used directly. The decoded size comes from the
+	/// header, so the cache allocates the final buffer up front and the
+	/// chunks are decoded straight into it one at a time. When the file can
+	/// map the resource the chunks are decoded from the mapping, otherwise
+	/// they are streamed in one at a time, so only a chunk of the compressed
+	/// data is ever in memory.
+	/// </summary>
+	class CompressedResourceLoader : public ResourceLoader
+	{
+		virtual bool discard_raw_buffer_after_load();
+		virtual std::string get_derived_data_version();
+		virtual size_t get_loaded_resource_size(char* raw_buffer,
+			size_t raw_size);
+		virtual std::string get_pattern();
+		virtual double get_reload_cost(size_t raw_size, size_t loaded_size);
+		virtual size_t get_streamed_resource_size(ResourceStream& stream);
+		virtual bool load_resource(char* raw_buffer, size_t raw_size,
+			std::shared_ptr<ResourceHandle> handle);
+		virtual bool load_stream(ResourceStream& stream,
+			std::shared_ptr<ResourceHandle> handle);
+		virtual bool prefer_mapped_raw();
+		virtual bool use_raw_file();
+		virtual bool use_stream();
+	};
+}
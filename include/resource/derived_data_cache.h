@@ -0,0 +1,182 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "resource/resource_file.h"
+
+namespace loquat
+{
+	/// <summary>
+	/// Identifies one loader's output for one version of a resource's raw
+	/// data.
+	/// </summary>
+	struct DerivedDataKey
+	{
+		/// <summary>
+		/// A hash of the raw data.
+		/// </summary>
+		uint64_t raw_hash = 0;
+
+		/// <summary>
+		/// The size of the raw data, in bytes, as a check on the hash.
+		/// </summary>
+		uint64_t raw_size = 0;
+
+		/// <summary>
+		/// A hash of the loader's name and output version.
+		/// </summary>
+		uint64_t loader_hash = 0;
+	};
+
+	/// <summary>
+	/// Keeps what loaders produce in files on local disk, so the next run can
+	/// map the output instead of running the loader over the raw data again.
+	///
+	/// Entries are keyed by the raw data's contents rather than the
+	/// resource's name, so a resource that is edited simply misses, and
+	/// stale entries age out. When the folder grows past its limit, the
+	/// entries that were least recently used are deleted.
+	///
+	/// Safe to use from multiple threads, and from several processes sharing
+	/// a folder, since entries are written under a temporary name and then
+	/// renamed into place.
+	/// </summary>
+	class DerivedDataCache
+	{
+		/// <summary>
+		/// The folder entries are kept in, ending in a separator.
+		/// </summary>
+		const std::string directory;
+
+		/// <summary>
+		/// The most the entries may take up on disk, in bytes.
+		/// </summary>
+		const size_t max_size;
+
+		/// <summary>
+		/// The bytes the entries take up, as far as we know. Other processes
+		/// writing to the same folder aren't seen until the next trim.
+		/// </summary>
+		std::atomic<size_t> disk_size;
+
+		/// <summary>
+		/// Used to give temporary files unique names.
+		/// </summary>
+		std::atomic<uint64_t> next_temporary;
+
+		/// <summary>
+		/// Makes sure only one thread trims at a time.
+		/// </summary>
+		std::mutex trim_mutex;
+
+		/// <summary>
+		/// Counters for the stats.
+		/// </summary>
+		std::atomic<uint64_t> hits;
+		std::atomic<uint64_t> misses;
+		std::atomic<uint64_t> stores;
+
+		/// <summary>
+		/// The file an entry is kept in.
+		/// </summary>
+		/// <param name="key">The entry's key.</param>
+		/// <returns>The full path of the file.</returns>
+		[[nodiscard]]
+		std::string path_for(const DerivedDataKey& key) const noexcept;
+
+		/// <summary>
+		/// Delete the least recently used entries until the folder is back
+		/// under its limit, recounting its size on the way.
+		/// </summary>
+		void trim() noexcept;
+
+	public:
+		/// <summary>
+		/// Create a cache over a folder. Nothing is touched until open.
+		/// </summary>
+		/// <param name="directory">The folder to keep entries in, which is
+		/// created if needed.</param>
+		/// <param name="size_in_MB">The most the entries may take up on
+		/// disk, in megabytes.</param>
+		DerivedDataCache(const std::string directory, const size_t size_in_MB)
+			noexcept;
+
+		DerivedDataCache(const DerivedDataCache&) = delete;
+		DerivedDataCache& operator=(const DerivedDataCache&) = delete;
+
+		/// <summary>
+		/// Create the folder if it doesn't exist, and trim it if it is
+		/// already over the limit.
+		/// </summary>
+		/// <returns>Whether the folder can be used.</returns>
+		bool open() noexcept;
+
+		/// <summary>
+		/// Work out the key for a loader's output.
+		/// </summary>
+		/// <param name="raw_hash">A hash of the raw data the loader would
+		/// run on. The raw data is hashed once for both this and the
+		/// resource cache's deduplication, so it is passed in.</param>
+		/// <param name="raw_size">The size of the raw data, in bytes.
+		/// </param>
+		/// <param name="version">The loader's name and output version.
+		/// </param>
+		/// <returns>The key.</returns>
+		[[nodiscard]]
+		static DerivedDataKey make_key(const uint64_t raw_hash,
+			const size_t raw_size, const std::string& version) noexcept;
+
+		/// <summary>
+		/// Map an entry, if there is one. Entries that are truncated or were
+		/// written for a different key are ignored.
+		/// </summary>
+		/// <param name="key">The key to look for.</param>
+		/// <returns>The mapping of the loader's output, with null data if
+		/// there is no entry.</returns>
+		[[nodiscard]]
+		ResourceMapping find(const DerivedDataKey& key) noexcept;
+
+		/// <summary>
+		/// Write an entry, replacing any with the same key. Failing to write
+		/// is not an error, the entry just isn't there next time.
+		/// </summary>
+		/// <param name="key">The key to store under.</param>
+		/// <param name="data">The loader's output.</param>
+		/// <param name="size">The size of the output, in bytes.</param>
+		void store(const DerivedDataKey& key, const char* data,
+			const size_t size) noexcept;
+
+		/// <summary>
+		/// The number of lookups that found an entry.
+		/// </summary>
+		[[nodiscard]]
+		uint64_t get_hits() const noexcept;
+
+		/// <summary>
+		/// The number of lookups that didn't.
+		/// </summary>
+		[[nodiscard]]
+		uint64_t get_misses() const noexcept;
+
+		/// <summary>
+		/// The number of entries written.
+		/// </summary>
+		[[nodiscard]]
+		uint64_t get_stores() const noexcept;
+
+		/// <summary>
+		/// The bytes the entries take up on disk.
+		/// </summary>
+		[[nodiscard]]
+		size_t get_disk_size() const noexcept;
+
+		/// <summary>
+		/// Zero the hit, miss and store counters.
+		/// </summary>
+		void reset_stats() noexcept;
+	};
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vector>
+
+#include "resource/resource_eviction_policy.h"
+
+namespace loquat
+{
+	/// <summary>
+	/// Greedy dual size frequency.
+	///
+	/// Each handle gets a priority of the shard's inflation value, plus how
+	/// often it has been used times its reload cost over its size, and the
+	/// handle with the lowest priority is evicted. The inflation value rises
+	/// to the priority of each handle evicted, so handles that were popular
+	/// a long time ago eventually age out. Small resources that are costly
+	/// to load again, like shaders, outlive large cheap ones like textures.
+	/// </summary>
+	class GDSFEvictionPolicy : public ResourceEvictionPolicy
+	{
+		/// <summary>
+		/// A binary min heap of the tracked handles, ordered by priority.
+		/// Each handle stores its own index, so it can be found again.
+		/// </summary>
+		std::vector<ResourceHandle*> heap;
+
+		/// <summary>
+		/// The priority of the last handle evicted.
+		/// </summary>
+		double inflation = 0.0;
+
+		/// <summary>
+		/// Recalculate the priority of a handle from its use count.
+		/// </summary>
+		/// <param name="handle">The handle to update.</param>
+		void update_priority(ResourceHandle* handle) const noexcept;
+
+		/// <summary>
+		/// Move the handle at an index towards the root until the heap is in
+		/// order again.
+		/// </summary>
+		/// <param name="index">The index of the handle.</param>
+		void sift_up(size_t index) noexcept;
+
+		/// <summary>
+		/// Move the handle at an index towards the leaves until the heap is
+		/// in order again.
+		/// </summary>
+		/// <param name="index">The index of the handle.</param>
+		void sift_down(size_t index) noexcept;
+
+		/// <summary>
+		/// Put a handle at an index in the heap.
+		/// </summary>
+		/// <param name="index">The index.</param>
+		/// <param name="handle">The handle.</param>
+		void place(size_t index, ResourceHandle* handle) noexcept;
+
+	public:
+		virtual void insert(ResourceHandle* handle) noexcept;
+		virtual void touch(ResourceHandle* handle) noexcept;
+		virtual void remove(ResourceHandle* handle) noexcept;
+		[[nodiscard]]
+		virtual ResourceHandle* evict() noexcept;
+	};
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace loquat
+{
+	/// <summary>
+	/// A wildcard pattern compiled for matching against many names. It
+	/// matches exactly what wildcard_match does: a star matches any run of
+	/// characters, and a question mark matches any one character except a
+	/// dot.
+	///
+	/// The pattern is split at its stars into literal pieces. The first
+	/// piece has to start the name and the last has to end it, and the ones
+	/// in between are found left to right, so a match never backtracks and
+	/// takes time proportional to the name.
+	/// </summary>
+	class GlobPattern
+	{
+		/// <summary>
+		/// One of the pieces between stars.
+		/// </summary>
+		struct Piece
+		{
+			/// <summary>
+			/// The characters, which may include question marks.
+			/// </summary>
+			std::string_view text;
+
+			/// <summary>
+			/// Whether the text has a question mark, so it can't be found
+			/// with a plain search.
+			/// </summary>
+			bool has_any = false;
+		};
+
+		/// <summary>
+		/// The pattern as given, which the pieces point into.
+		/// </summary>
+		std::string pattern;
+
+		/// <summary>
+		/// The pieces between stars. Empty pieces at the ends are kept, so
+		/// there is always one more piece than there are stars, ignoring
+		/// repeated stars.
+		/// </summary>
+		std::vector<Piece> pieces;
+
+		/// <summary>
+		/// The fewest characters a name needs to match.
+		/// </summary>
+		size_t min_length = 0;
+
+		/// <summary>
+		/// Split the pattern into pieces. The pieces point into the pattern,
+		/// so this has to be done again whenever it is copied.
+		/// </summary>
+		void compile() noexcept;
+
+		/// <summary>
+		/// Check a piece against the characters at the start of some text.
+		/// The text must be at least as long as the piece.
+		/// </summary>
+		[[nodiscard]]
+		static bool piece_matches(const Piece& piece, const char* text)
+			noexcept;
+
+		/// <summary>
+		/// Find the first place a piece matches in some text.
+		/// </summary>
+		/// <returns>The offset of the match, npos if there is none.
+		/// </returns>
+		[[nodiscard]]
+		static size_t find_piece(const Piece& piece, std::string_view text)
+			noexcept;
+
+	public:
+		/// <summary>
+		/// Compile a pattern.
+		/// </summary>
+		/// <param name="pattern">The wildcard pattern.</param>
+		explicit GlobPattern(std::string_view pattern) noexcept;
+
+		GlobPattern(const GlobPattern& other) noexcept;
+		GlobPattern& operator=(const GlobPattern& other) noexcept;
+
+		/// <summary>
+		/// Check whether a name matches the pattern.
+		/// </summary>
+		/// <param name="name">The name to check.</param>
+		/// <returns>Whether it matches.</returns>
+		[[nodiscard]]
+		bool matches(std::string_view name) const noexcept;
+
+		/// <summary>
+		/// The literal characters every match starts with, up to the first
+		/// star or question mark.
+		/// </summary>
+		[[nodiscard]]
+		std::string_view get_prefix() const noexcept;
+
+		/// <summary>
+		/// The literal characters every match ends with, after the last star
+		/// or question mark. Empty if the pattern has no stars, since the
+		/// prefix already says everything.
+		/// </summary>
+		[[nodiscard]]
+		std::string_view get_suffix() const noexcept;
+
+		/// <summary>
+		/// Whether the pattern has no wildcards, so only one name matches.
+		/// </summary>
+		[[nodiscard]]
+		bool is_literal() const noexcept;
+	};
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "resource/resource_eviction_policy.h"
+#include "resource/resource_lru_list.h"
+
+namespace loquat
+{
+	/// <summary>
+	/// Evicts the least recently used resource, ignoring size and cost.
+	/// </summary>
+	class LRUEvictionPolicy : public ResourceEvictionPolicy
+	{
+		/// <summary>
+		/// The tracked handles, most recently used first.
+		/// </summary>
+		ResourceLRUList lru_list;
+
+	public:
+		virtual void insert(ResourceHandle* handle) noexcept;
+		virtual void touch(ResourceHandle* handle) noexcept;
+		virtual void remove(ResourceHandle* handle) noexcept;
+		[[nodiscard]]
+		virtual ResourceHandle* evict() noexcept;
+	};
+}
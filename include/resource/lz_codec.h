@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+
+namespace loquat
+{
+	/// <summary>
+	/// The largest distance back that a match can refer to, in bytes.
+	/// </summary>
+	constexpr size_t LZ_MAX_OFFSET = 65535;
+
+	/// <summary>
+	/// The most bytes that compressing a block of the given size can produce,
+	/// for incompressible data.
+	/// </summary>
+	/// <param name="size">The size of the uncompressed block, in bytes.
+	/// </param>
+	/// <returns>The worst case compressed size, in bytes.</returns>
+	[[nodiscard]]
+	constexpr size_t lz_compress_bound(size_t size) noexcept
+	{
+		return size + size / 255 + 16;
+	}
+
+	/// <summary>
+	/// Compress a block with a fast LZ77 style codec.
+	///
+	/// The output is a series of sequences, each a token byte holding the
+	/// literal and match lengths, the literals, and a two byte little endian
+	/// offset back to the match. Lengths that don't fit in the token are
+	/// continued in following bytes, 255 at a time. The last sequence is
+	/// only literals.
+	/// </summary>
+	/// <param name="source">The data to compress.</param>
+	/// <param name="source_size">The size of the data, in bytes.</param>
+	/// <param name="destination">Where to write the compressed data.</param>
+	/// <param name="capacity">The size of the destination, which must be at
+	/// least lz_compress_bound(source_size).</param>
+	/// <returns>The compressed size, in bytes, or 0 if the destination is
+	/// too small.</returns>
+	[[nodiscard]]
+	size_t lz_compress(const char* source, size_t source_size,
+		char* destination, size_t capacity) noexcept;
+
+	/// <summary>
+	/// Decompress a block that was written by lz_compress. Every read and
+	/// write is bounds checked, so corrupt data fails instead of overrunning
+	/// either buffer.
+	/// </summary>
+	/// <param name="source">The compressed data.</param>
+	/// <param name="source_size">The size of the compressed data, in bytes.
+	/// </param>
+	/// <param name="destination">Where to write the decompressed data.
+	/// </param>
+	/// <param name="destination_size">The exact size of the decompressed
+	/// data, in bytes.</param>
+	/// <returns>Whether the block decompressed to exactly destination_size
+	/// bytes.</returns>
+	[[nodiscard]]
+	bool lz_decompress(const char* source, size_t source_size,
+		char* destination, size_t destination_size) noexcept;
+}
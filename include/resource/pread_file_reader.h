@@ -0,0 +1,40 @@
+#pragma once
+
+#include "main/thread_pool.h"
+#include "resource/batch_file_reader.h"
+
+namespace loquat
+{
+	/// <summary>
+	/// Reads a batch of files with a pool of threads, each doing ordinary
+	/// blocking opens and positioned reads. Used wherever io_uring isn't
+	/// available.
+	/// </summary>
+	class PreadFileReader : public BatchFileReader
+	{
+		/// <summary>
+		/// The threads that do the reads.
+		/// </summary>
+		ThreadPool pool;
+
+	public:
+		/// <summary>
+		/// Create a reader.
+		/// </summary>
+		/// <param name="thread_count">The number of reads to do at once.
+		/// </param>
+		explicit PreadFileReader(size_t thread_count) noexcept;
+
+		virtual void read(std::vector<FileRead>& reads) noexcept;
+
+		[[nodiscard]]
+		virtual const char* get_name() const noexcept;
+	};
+
+	/// <summary>
+	/// Read one range of a file with blocking calls.
+	/// </summary>
+	/// <param name="read">The read to do, whose bytes_read is filled in.
+	/// </param>
+	void read_file_blocking(FileRead& read) noexcept;
+}
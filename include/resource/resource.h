@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <functional>
 #include <string>
 #include <string_view>
 
@@ -39,4 +41,19 @@ namespace loquat
 		/// including the path to the resource.</param>
 		Resource(std::string_view resource_name);
 	};
+
+	/// <summary>
+	/// Hashes resource names, allowing lookups by string view without
+	/// constructing a temporary string.
+	/// </summary>
+	struct ResourceNameHash
+	{
+		using is_transparent = void;
+
+		[[nodiscard]]
+		size_t operator()(std::string_view name) const noexcept
+		{
+			return std::hash<std::string_view>{}(name);
+		}
+	};
 }
@@ -0,0 +1,282 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <mutex>
+
+#include "main/memory_utils.h"
+
+namespace loquat
+{
+	/// <summary>
+	/// A snapshot of how much memory a buffer pool is holding on to, and how
+	/// much of that is actually in use.
+	/// </summary>
+	struct ResourceBufferPoolStats
+	{
+		/// <summary>
+		/// The bytes callers asked for, for every live buffer.
+		/// </summary>
+		size_t requested_bytes = 0;
+
+		/// <summary>
+		/// The bytes handed out for every live buffer, after rounding up to
+		/// a size class or a whole number of pages.
+		/// </summary>
+		size_t allocated_bytes = 0;
+
+		/// <summary>
+		/// The bytes of slabs and large buffers mapped from the system. This
+		/// is what the pool adds to the process's footprint, as long as the
+		/// pages have been touched. Spare slabs aren't counted, since their
+		/// pages are handed back.
+		/// </summary>
+		size_t mapped_bytes = 0;
+
+		/// <summary>
+		/// The number of slabs holding small buffers.
+		/// </summary>
+		size_t slab_count = 0;
+
+		/// <summary>
+		/// The number of large buffers, each mapped on its own.
+		/// </summary>
+		size_t large_count = 0;
+
+		/// <summary>
+		/// The fraction of mapped memory that isn't holding data callers
+		/// asked for, from rounding and from free room in slabs.
+		/// </summary>
+		[[nodiscard]]
+		double fragmentation() const noexcept
+		{
+			if (mapped_bytes == 0)
+			{
+				return 0.0;
+			}
+			return 1.0 - static_cast<double>(requested_bytes)
+				/ static_cast<double>(mapped_bytes);
+		}
+	};
+
+	/// <summary>
+	/// A memory resource just for resource buffers, so that hours of loading
+	/// and evicting don't fragment the general heap.
+	///
+	/// Small buffers come out of slabs, one set of slabs per size class,
+	/// with four classes per power of two so rounding never wastes more than
+	/// a fifth. A slab that empties out goes straight back to the system,
+	/// except for one spare per class, which keeps its address space but
+	/// gives up its pages. Anything bigger than the largest
+	/// class is mapped on its own and unmapped as soon as it is freed.
+	///
+	/// Deallocation needs the same size that was passed to allocate.
+	/// Failure returns null rather than throwing.
+	/// </summary>
+	class ResourceBufferPool : public std::pmr::memory_resource
+	{
+	public:
+		/// <summary>
+		/// The smallest and largest slabs. Each class's slabs are sized to
+		/// hold about SLAB_BUFFER_COUNT buffers, within these limits. A slab
+		/// is aligned to its size, so the slab a buffer belongs to can be
+		/// found from its address.
+		/// </summary>
+		static constexpr size_t MIN_SLAB_SIZE = size_t{ 64 } * 1024;
+		static constexpr size_t MAX_SLAB_SIZE = size_t{ 1 } << 20;
+		static constexpr size_t SLAB_BUFFER_COUNT = 16;
+
+		/// <summary>
+		/// The smallest size class.
+		/// </summary>
+		static constexpr size_t MIN_CLASS_SIZE = 64;
+
+		/// <summary>
+		/// The largest buffer that comes from a slab.
+		/// </summary>
+		static constexpr size_t MAX_CLASS_SIZE = size_t{ 128 } * 1024;
+
+		/// <summary>
+		/// The number of size classes, from MIN_CLASS_SIZE to MAX_CLASS_SIZE.
+		/// </summary>
+		static constexpr size_t CLASS_COUNT = 45;
+
+		/// <summary>
+		/// The strictest alignment a slab buffer gets. Larger alignments are
+		/// mapped on their own.
+		/// </summary>
+		static constexpr size_t SLAB_ALIGNMENT = 16;
+
+		ResourceBufferPool() noexcept = default;
+		ResourceBufferPool(const ResourceBufferPool&) = delete;
+		ResourceBufferPool& operator=(const ResourceBufferPool&) = delete;
+
+		/// <summary>
+		/// Give every spare slab back. Buffers must all be freed by now.
+		/// </summary>
+		~ResourceBufferPool();
+
+		/// <summary>
+		/// The number of bytes a buffer really takes up, after rounding.
+		/// </summary>
+		/// <param name="size">The size that would be requested.</param>
+		/// <returns>The size class, or the size rounded up to whole pages.
+		/// </returns>
+		[[nodiscard]]
+		static size_t rounded_size(const size_t size) noexcept;
+
+		/// <summary>
+		/// Take a snapshot of the pool's memory use.
+		/// </summary>
+		[[nodiscard]]
+		ResourceBufferPoolStats get_stats() const noexcept;
+
+	protected:
+		void* do_allocate(size_t size, size_t alignment) noexcept override;
+		void do_deallocate(void* pointer, size_t size, size_t alignment)
+			noexcept override;
+		bool do_is_equal(const std::pmr::memory_resource& other) const
+			noexcept override;
+
+	private:
+		/// <summary>
+		/// The header at the start of every slab.
+		/// </summary>
+		struct Slab
+		{
+			/// <summary>
+			/// The neighbouring slabs in the class's list of slabs with room.
+			/// </summary>
+			Slab* previous = nullptr;
+			Slab* next = nullptr;
+
+			/// <summary>
+			/// Buffers that were freed, linked through their first bytes.
+			/// </summary>
+			void* free_list = nullptr;
+
+			/// <summary>
+			/// Where buffers that have never been handed out start.
+			/// </summary>
+			char* untouched = nullptr;
+
+			/// <summary>
+			/// The number of buffers the slab holds.
+			/// </summary>
+			uint32_t capacity = 0;
+
+			/// <summary>
+			/// The number of buffers handed out.
+			/// </summary>
+			uint32_t live = 0;
+
+			/// <summary>
+			/// Whether the slab is in the class's list of slabs with room.
+			/// </summary>
+			bool listed = false;
+		};
+
+		/// <summary>
+		/// The slabs for one size class.
+		/// </summary>
+		struct alignas(hardware_destructive_interference_size) SizeClass
+		{
+			/// <summary>
+			/// Guards the slabs in the class.
+			/// </summary>
+			std::mutex mutex;
+
+			/// <summary>
+			/// Slabs that have room for another buffer.
+			/// </summary>
+			Slab* with_room = nullptr;
+
+			/// <summary>
+			/// An empty slab kept around, so a class that keeps going from
+			/// one buffer to none doesn't map and unmap a slab every time.
+			/// </summary>
+			Slab* spare = nullptr;
+
+			/// <summary>
+			/// The number of slabs in use by the class, not counting the
+			/// spare.
+			/// </summary>
+			std::atomic<size_t> slab_count{ 0 };
+
+			/// <summary>
+			/// The number of buffers handed out from the class.
+			/// </summary>
+			std::atomic<size_t> live{ 0 };
+		};
+
+		/// <summary>
+		/// Every size class.
+		/// </summary>
+		std::array<SizeClass, CLASS_COUNT> classes;
+
+		/// <summary>
+		/// The bytes callers asked for, for every live buffer.
+		/// </summary>
+		std::atomic<size_t> requested_bytes{ 0 };
+
+		/// <summary>
+		/// The bytes mapped for large buffers.
+		/// </summary>
+		std::atomic<size_t> large_bytes{ 0 };
+
+		/// <summary>
+		/// The number of large buffers.
+		/// </summary>
+		std::atomic<size_t> large_count{ 0 };
+
+		/// <summary>
+		/// Find the size class for a buffer.
+		/// </summary>
+		/// <param name="size">The requested size, at most MAX_CLASS_SIZE.
+		/// </param>
+		/// <returns>The index of the smallest class it fits in.</returns>
+		[[nodiscard]]
+		static size_t class_index(const size_t size) noexcept;
+
+		/// <summary>
+		/// The size of the buffers in a class.
+		/// </summary>
+		/// <param name="index">The class index.</param>
+		/// <returns>The buffer size, in bytes.</returns>
+		[[nodiscard]]
+		static size_t class_size(const size_t index) noexcept;
+
+		/// <summary>
+		/// The size of the slabs for a class.
+		/// </summary>
+		/// <param name="index">The class index.</param>
+		/// <returns>The slab size, a power of two.</returns>
+		[[nodiscard]]
+		static size_t slab_size(const size_t index) noexcept;
+
+		/// <summary>
+		/// Lay out a slab for a size class, with every buffer free.
+		/// </summary>
+		/// <param name="pages">The slab's memory, slab_size bytes aligned to
+		/// slab_size.</param>
+		/// <param name="index">The class index.</param>
+		/// <returns>The slab header, at the start of the pages.</returns>
+		[[nodiscard]]
+		static Slab* format_slab(void* pages, const size_t index) noexcept;
+
+		/// <summary>
+		/// Add a slab to its class's list of slabs with room. The class must
+		/// be locked.
+		/// </summary>
+		static void link(SizeClass& size_class, Slab* slab) noexcept;
+
+		/// <summary>
+		/// Take a slab out of its class's list of slabs with room. The class
+		/// must be locked.
+		/// </summary>
+		static void unlink(SizeClass& size_class, Slab* slab) noexcept;
+	};
+}
@@ -1,66 +1,727 @@
 #pragma once
 
-#include <list>
-#include <map>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
+#include "main/memory_utils.h"
+#include "main/thread_pool.h"
+#include "resource/derived_data_cache.h"
+#include "resource/resource_buffer_pool.h"
+#include "resource/resource_cache_stats.h"
+#include "resource/resource_eviction_policy.h"
 #include "resource/resource_file.h"
+#include "resource/resource_graph.h"
 #include "resource/resource_handle.h"
 #include "resource/resource_loader.h"
+#include "resource/resource_loader_index.h"
+#include "resource/resource_name_table.h"
 
 namespace loquat
 {
-	using ResourceHandleList = std::list<std::shared_ptr<ResourceHandle>>;
-	using ResourceHandleMap = std::map<std::string, std::shared_ptr<ResourceHandle>>;
-	using ResourceLoaders = std::list<std::shared_ptr<ResourceLoader>>;
+	using ResourceHandleFuture =
+		std::shared_future<std::shared_ptr<ResourceHandle>>;
+	using ResourceHandlePromise = std::promise<std::shared_ptr<ResourceHandle>>;
+	using ResourceHandleMap = std::unordered_map<std::string,
+		std::shared_ptr<ResourceHandle>, ResourceNameHash, std::equal_to<>>;
+	using PendingResourceMap = std::unordered_map<std::string,
+		ResourceHandleFuture, ResourceNameHash, std::equal_to<>>;
 
-	using ProgressCallback = void (*)(int, bool&);
+	/// <summary>
+	/// Notified as resources are preloaded, with the number of bytes loaded
+	/// so far and the total number of bytes to load. Setting the flag to true
+	/// cancels the rest of the preload.
+	/// </summary>
+	using ProgressCallback = void (*)(size_t, size_t, bool&);
 
+	/// <summary>
+	/// Notified with the new handle when a resource is reloaded because it
+	/// changed in the resource file.
+	/// </summary>
+	using ResourceChangedCallback =
+		std::function<void(std::shared_ptr<ResourceHandle>)>;
+
+	/// <summary>
+	/// Notified with the number of bytes free under the soft limit when the
+	/// cache has room again after running out.
+	/// </summary>
+	using MemoryAvailableCallback = std::function<void(size_t)>;
+
+	/// <summary>
+	/// Caches resources loaded from a resource file, evicting resources when
+	/// we run out of room. Which resources go first is up to the eviction
+	/// policy, which is least recently used unless told otherwise. Pinned
+	/// resources are never evicted.
+	/// 
+	/// The cache is safe to use from multiple threads. Handles are split
+	/// across a number of shards by name hash, each with its own lock, name
+	/// index and eviction policy, so threads working on different resources
+	/// rarely contend. Memory accounting is shared between the shards.
+	/// 
+	/// Evicting a resource only drops the cache's reference, and its memory
+	/// stays charged until every handle to it is gone. So the cache size is
+	/// a soft limit: loads evict what they can to stay under it, and if what
+	/// is left is all held outside the cache, loads on the cache's threads
+	/// wait a while for memory to be freed. Past that, loads may go over, up
+	/// to the hard limit, before they fail.
+	/// </summary>
 	class ResourceCache
 	{
 		friend class ResourceHandle;
 
 		/// <summary>
-		/// The list of resource handles that are currently loaded. These are 
-		/// stored in least-recently-used order, so every time a resource is used
-		/// it gets moved to the front of the list.
+		/// One slice of the cache. Each resource name always maps to the same
+		/// shard, and everything in a shard is guarded by its mutex.
 		/// </summary>
-		ResourceHandleList lru_list;
+		struct alignas(hardware_destructive_interference_size) Shard
+		{
+			/// <summary>
+			/// Guards the rest of the shard, including the eviction state and
+			/// pin counts inside the handles that belong to it.
+			/// </summary>
+			std::mutex mutex;
+
+			/// <summary>
+			/// Decides which of the shard's handles to evict. Every handle in
+			/// the shard that isn't pinned is tracked by it.
+			/// </summary>
+			ResourceEvictionPolicy* eviction_policy = nullptr;
+
+			/// <summary>
+			/// Used to look up resource handles by name. This owns the cache's
+			/// reference to each handle.
+			/// </summary>
+			ResourceHandleMap resources;
+
+			/// <summary>
+			/// Resources that some thread is currently loading. Other threads
+			/// asking for the same resource wait on the future instead of
+			/// loading it a second time.
+			/// </summary>
+			PendingResourceMap pending;
+
+			/// <summary>
+			/// Counters for the shard's share of the stats. They are only
+			/// changed with the mutex held, but get_stats reads them without
+			/// it.
+			/// </summary>
+			std::atomic<uint64_t> hits{ 0 };
+			std::atomic<uint64_t> misses{ 0 };
+			std::atomic<uint64_t> joined{ 0 };
+			std::atomic<uint64_t> failed_loads{ 0 };
+			std::atomic<uint64_t> bytes_loaded{ 0 };
+			std::atomic<uint64_t> evictions{ 0 };
+			std::atomic<uint64_t> bytes_evicted{ 0 };
+			std::atomic<uint64_t> prefetches{ 0 };
+
+			/// <summary>
+			/// Handles that were evicted or removed while something outside
+			/// the cache still held them, so their memory is still charged.
+			/// Only used for reporting. Entries whose handle has gone are
+			/// swept out now and then.
+			/// </summary>
+			std::vector<std::weak_ptr<ResourceHandle>> evicted_held;
+
+			/// <summary>
+			/// The size evicted_held can grow to before it is next swept.
+			/// </summary>
+			size_t evicted_sweep_size = 64;
+		};
 
 		/// <summary>
-		/// Used to look up resource handles by name.
+		/// The shards that resources are split between.
 		/// </summary>
-		ResourceHandleMap resources;
+		std::unique_ptr<Shard[]> shards;
 
 		/// <summary>
-		/// A list of resource loaders. The most specific loaders should come
-		/// first on the list, with more generic loaders last on the list.
-		/// 
-		/// Registering loaders pushes them to the front of the list.
+		/// The number of shards, always a power of two.
+		/// </summary>
+		size_t shard_count;
+
+		/// <summary>
+		/// The shard we will next try to evict from. Eviction rotates through
+		/// the shards, so the cache as a whole only approximately follows the
+		/// eviction policy.
+		/// </summary>
+		std::atomic<size_t> eviction_cursor;
+
+		/// <summary>
+		/// The resource loaders. The most specific loaders should be
+		/// registered last, since later loaders take priority over earlier
+		/// ones.
 		/// </summary>
-		ResourceLoaders resource_loaders;
+		ResourceLoaderIndex resource_loaders;
 
 		/// <summary>
 		/// The resource file that we load from.
 		/// </summary>
 		ResourceFile* file;
 
+		/// <summary>
+		/// The total amount of memory allocated for the cache.
+		/// </summary>
+		const size_t cache_size;
+
 		/// <summary>
 		/// The amount of cache memory in use.
 		/// </summary>
-		size_t cache_size;
+		std::atomic<size_t> allocated;
 
 		/// <summary>
-		/// The total amount of memory allocated for the cache.
+		/// The most memory the cache may use once nothing is left to evict.
+		/// Never below the cache size.
+		/// </summary>
+		std::atomic<size_t> hard_limit;
+
+		/// <summary>
+		/// How long a load on one of the cache's threads waits for memory to
+		/// be freed before going over the cache size.
+		/// </summary>
+		std::atomic<std::chrono::steady_clock::duration::rep>
+			backpressure_timeout;
+
+		/// <summary>
+		/// Bumped whenever memory is freed or a resource becomes evictable,
+		/// so loads waiting for memory know to try again.
+		/// </summary>
+		std::atomic<uint64_t> memory_generation;
+
+		/// <summary>
+		/// The number of loads waiting for memory.
+		/// </summary>
+		std::atomic<size_t> memory_waiters;
+
+		/// <summary>
+		/// Guards waiting for memory.
+		/// </summary>
+		std::mutex budget_mutex;
+
+		/// <summary>
+		/// Signalled when memory_generation changes and loads are waiting.
+		/// </summary>
+		std::condition_variable memory_freed;
+
+		/// <summary>
+		/// Set when a load found nothing left to evict, and cleared once
+		/// enough memory is freed to notify the memory subscribers.
+		/// </summary>
+		std::atomic<bool> memory_pressure;
+
+		/// <summary>
+		/// Loads that had to wait for memory, the ones that gave up waiting,
+		/// and the ones that went over the cache size.
+		/// </summary>
+		std::atomic<uint64_t> backpressure_waits;
+		std::atomic<uint64_t> backpressure_timeouts;
+		std::atomic<uint64_t> over_budget_loads;
+
+		/// <summary>
+		/// Where every resource buffer is allocated from, kept apart from the
+		/// general heap so churn doesn't fragment it.
+		/// </summary>
+		ResourceBufferPool buffer_pool;
+
+		/// <summary>
+		/// The most cache memory that has been in use at once since the stats
+		/// were last reset.
+		/// </summary>
+		std::atomic<size_t> peak_allocated;
+
+		/// <summary>
+		/// Bytes read or mapped from the file since the stats were last
+		/// reset.
+		/// </summary>
+		std::atomic<uint64_t> bytes_read;
+
+		/// <summary>
+		/// Time spent reading from the file.
+		/// </summary>
+		LatencyHistogram file_read_latency;
+
+		/// <summary>
+		/// Time spent running resource loaders.
+		/// </summary>
+		LatencyHistogram loader_latency;
+
+		/// <summary>
+		/// Where to write the stats when the cache is destroyed, empty to not
+		/// write them.
+		/// </summary>
+		std::string stats_dump_path;
+
+		/// <summary>
+		/// Where loader output is kept between runs, null if it isn't.
+		/// </summary>
+		DerivedDataCache* derived_data;
+
+		/// <summary>
+		/// Identifies what a loader made from some raw data, so resources
+		/// with the same contents can share it.
 		/// </summary>
-		size_t allocated;
+		struct ContentKey
+		{
+			/// <summary>
+			/// A hash of the raw data.
+			/// </summary>
+			uint64_t hash;
+
+			/// <summary>
+			/// The size of the raw data, in bytes.
+			/// </summary>
+			size_t size;
+
+			/// <summary>
+			/// The loader that ran over it.
+			/// </summary>
+			const ResourceLoader* loader;
+
+			[[nodiscard]]
+			bool operator==(const ContentKey&) const noexcept = default;
+		};
+
+		struct ContentKeyHash
+		{
+			[[nodiscard]]
+			size_t operator()(const ContentKey& key) const noexcept
+			{
+				return static_cast<size_t>(key.hash)
+					^ std::hash<const void*>{}(key.loader);
+			}
+		};
+
+		/// <summary>
+		/// Whether resources with the same contents share one buffer.
+		/// </summary>
+		bool deduplicate;
+
+		/// <summary>
+		/// The handle that owns the buffer for each set of contents. Entries
+		/// whose handle has gone are swept out now and then.
+		/// </summary>
+		std::unordered_map<ContentKey, std::weak_ptr<ResourceHandle>,
+			ContentKeyHash> content_index;
+
+		/// <summary>
+		/// The size the content index can grow to before it is next swept.
+		/// </summary>
+		size_t content_sweep_size;
+
+		/// <summary>
+		/// Guards the content index.
+		/// </summary>
+		std::mutex content_mutex;
+
+		/// <summary>
+		/// Loads that shared another resource's buffer, and the cache memory
+		/// they didn't need because of it.
+		/// </summary>
+		std::atomic<uint64_t> deduplicated_loads;
+		std::atomic<uint64_t> deduplicated_bytes;
+
+		/// <summary>
+		/// Every resource name in the file, for matching patterns against.
+		/// Built the first time it is needed, and again once the file's
+		/// resources change.
+		/// </summary>
+		std::shared_ptr<const ResourceNameTable> name_table;
+
+		/// <summary>
+		/// Guards the name table pointer.
+		/// </summary>
+		std::mutex name_table_mutex;
+
+		/// <summary>
+		/// Workers that read raw resource data from the file.
+		/// </summary>
+		ThreadPool* io_pool;
+
+		/// <summary>
+		/// Workers that run resource loaders over data that has been read.
+		/// </summary>
+		ThreadPool* compute_pool;
+
+		/// <summary>
+		/// The maximum number of reads a preload keeps in flight at once.
+		/// </summary>
+		size_t preload_depth;
+
+		/// <summary>
+		/// An asynchronous load that is waiting for an I/O thread.
+		/// </summary>
+		struct QueuedLoad
+		{
+			/// <summary>
+			/// The shard the resource belongs to.
+			/// </summary>
+			Shard* shard;
+
+			/// <summary>
+			/// The resource to load.
+			/// </summary>
+			Resource resource;
+
+			/// <summary>
+			/// The claim on the load, to complete once it is done.
+			/// </summary>
+			std::shared_ptr<ResourceHandlePromise> claim;
+		};
+
+		/// <summary>
+		/// Asynchronous loads that no I/O thread has picked up yet. They are
+		/// taken off in batches, so their reads can all be in flight at once.
+		/// </summary>
+		std::deque<QueuedLoad> queued_loads;
+
+		/// <summary>
+		/// Guards the queued loads and whether loads are still accepted.
+		/// </summary>
+		std::mutex queued_load_mutex;
+
+		/// <summary>
+		/// Set when the cache starts shutting down, after which nothing new
+		/// is queued. Loads finishing on the compute threads would otherwise
+		/// keep queueing prefetches for I/O threads that are gone.
+		/// </summary>
+		std::atomic<bool> stopping_loads{ false };
+
+		/// <summary>
+		/// Someone who wants to know when a resource is reloaded.
+		/// </summary>
+		struct Subscription
+		{
+			/// <summary>
+			/// Identifies the subscription, so it can be removed.
+			/// </summary>
+			size_t id;
+
+			/// <summary>
+			/// The name of the resource being watched.
+			/// </summary>
+			std::string name;
+
+			/// <summary>
+			/// Called with the new handle after the resource is reloaded.
+			/// </summary>
+			ResourceChangedCallback callback;
+		};
+
+		/// <summary>
+		/// Everyone who wants to know when resources are reloaded.
+		/// </summary>
+		std::vector<Subscription> subscriptions;
+
+		/// <summary>
+		/// The ID to give the next subscription. Never 0.
+		/// </summary>
+		size_t next_subscription_id = 1;
+
+		/// <summary>
+		/// Someone who wants to know when the cache has room again.
+		/// </summary>
+		struct MemorySubscription
+		{
+			/// <summary>
+			/// Identifies the subscription, so it can be removed. Shares its
+			/// numbering with the resource subscriptions.
+			/// </summary>
+			size_t id;
+
+			/// <summary>
+			/// Called with the bytes free under the soft limit.
+			/// </summary>
+			MemoryAvailableCallback callback;
+		};
+
+		/// <summary>
+		/// Everyone who wants to know when the cache has room again.
+		/// </summary>
+		std::vector<MemorySubscription> memory_subscriptions;
+
+		/// <summary>
+		/// Guards the subscriptions.
+		/// </summary>
+		std::mutex subscription_mutex;
+
+		/// <summary>
+		/// Raw resource data that has been read from the file, but not yet
+		/// processed by a loader.
+		/// </summary>
+		struct RawResource
+		{
+			/// <summary>
+			/// The raw data, null if reading failed.
+			/// </summary>
+			char* buffer = nullptr;
+
+			/// <summary>
+			/// The size of the data in the file, in bytes.
+			/// </summary>
+			size_t size = 0;
+
+			/// <summary>
+			/// The size of the buffer, which may have room for a null.
+			/// </summary>
+			size_t allocation_size = 0;
+
+			/// <summary>
+			/// Whether the buffer is counted against the cache size.
+			/// </summary>
+			bool counted = false;
+
+			/// <summary>
+			/// If the buffer is mapped straight from the file, this keeps the
+			/// mapping alive and the buffer must not be freed.
+			/// </summary>
+			std::shared_ptr<void> mapping;
+		};
+
+		/// <summary>
+		/// The result of looking up a resource that may need to be loaded.
+		/// Exactly one of these is true: the handle is set because the
+		/// resource is loaded, the claim is set because the caller is now
+		/// responsible for loading it, or only the future is set because
+		/// someone else is already loading it.
+		/// </summary>
+		struct Lookup
+		{
+			std::shared_ptr<ResourceHandle> handle;
+			ResourceHandleFuture in_flight;
+			std::shared_ptr<ResourceHandlePromise> claim;
+		};
+
+		/// <summary>
+		/// Find the shard that a resource name belongs to.
+		/// </summary>
+		/// <param name="name">The name of the resource.</param>
+		/// <returns>The shard responsible for that name.</returns>
+		[[nodiscard]]
+		Shard& shard_for(std::string_view name) const noexcept;
+
+		/// <summary>
+		/// Insert a freshly loaded handle into its shard. The shard must
+		/// already be locked.
+		/// </summary>
+		/// <param name="shard">The locked shard.</param>
+		/// <param name="handle">The handle to insert.</param>
+		void insert(Shard& shard, std::shared_ptr<ResourceHandle> handle)
+			noexcept;
+
+		/// <summary>
+		/// Remove a handle from its shard, whether or not it is pinned. The
+		/// shard must already be locked. The cache reference is handed back,
+		/// so the caller can drop it after releasing the lock.
+		/// </summary>
+		/// <param name="shard">The locked shard.</param>
+		/// <param name="entry">The handle's entry in the shard.</param>
+		/// <returns>The removed handle.</returns>
+		std::shared_ptr<ResourceHandle> remove(Shard& shard,
+			ResourceHandleMap::iterator entry) noexcept;
+
+		/// <summary>
+		/// Remove the handle the eviction policy picks from a shard. The shard
+		/// must already be locked. The cache reference is handed back, so the
+		/// caller can drop it after releasing the lock.
+		/// </summary>
+		/// <param name="shard">The locked shard.</param>
+		/// <returns>The evicted handle, empty if the shard had nothing that
+		/// could be evicted.</returns>
+		std::shared_ptr<ResourceHandle> evict_one(Shard& shard) noexcept;
+
+		/// <summary>
+		/// Look up a resource, touching it if it is loaded. If it is neither
+		/// loaded nor being loaded, the caller claims the load and must
+		/// finish it with complete_load.
+		/// </summary>
+		/// <param name="shard">The shard the resource belongs to.</param>
+		/// <param name="resource">The resource to look up.</param>
+		/// <returns>The result of the lookup.</returns>
+		[[nodiscard]]
+		Lookup lookup_or_claim(Shard& shard, const Resource& resource) noexcept;
+
+		/// <summary>
+		/// Publish the result of a claimed load, inserting the handle into the
+		/// cache and waking anyone waiting on it.
+		/// </summary>
+		/// <param name="shard">The shard the resource belongs to.</param>
+		/// <param name="resource">The resource that was loaded.</param>
+		/// <param name="handle">The loaded handle, empty on failure.</param>
+		/// <param name="promise">The promise from the claim.</param>
+		void complete_load(Shard& shard, const Resource& resource,
+			std::shared_ptr<ResourceHandle> handle,
+			ResourceHandlePromise& promise) noexcept;
+
+		/// <summary>
+		/// Find the first registered loader whose pattern matches a resource.
+		/// </summary>
+		/// <param name="resource">The resource to be loaded.</param>
+		/// <returns>The loader to use, empty if none match.</returns>
+		[[nodiscard]]
+		std::shared_ptr<ResourceLoader> find_loader(const Resource& resource)
+			noexcept;
+
+		/// <summary>
+		/// Map the raw data for a resource, if the file can.
+		/// </summary>
+		/// <param name="resource">The resource to map.</param>
+		/// <param name="raw">Filled in with the mapping.</param>
+		/// <returns>Whether the resource was mapped.</returns>
+		[[nodiscard]]
+		bool map_raw(const Resource& resource, RawResource& raw) noexcept;
+
+		/// <summary>
+		/// Get the raw data for a resource ready to be read. If the file can
+		/// map it, the data is just mapped. Otherwise a buffer is allocated
+		/// for it, which the caller has to read into.
+		/// </summary>
+		/// <param name="resource">The resource to prepare.</param>
+		/// <param name="loader">The loader that will process the data.</param>
+		/// <param name="raw">Filled in with the mapping or the empty buffer.
+		/// </param>
+		/// <returns>Whether the resource was found and there was room for
+		/// it.</returns>
+		[[nodiscard]]
+		bool prepare_raw(const Resource& resource, ResourceLoader& loader,
+			RawResource& raw) noexcept;
+
+		/// <summary>
+		/// Read the raw data for a resource from the file. This is the part of
+		/// loading that waits on the disk.
+		/// </summary>
+		/// <param name="resource">The resource to read.</param>
+		/// <param name="loader">The loader that will process the data.</param>
+		/// <returns>The raw data, with a null buffer on failure.</returns>
+		[[nodiscard]]
+		RawResource read_raw(const Resource& resource, ResourceLoader& loader)
+			noexcept;
+
+		/// <summary>
+		/// Run a loader over raw data and create the handle for it. This is
+		/// the part of loading that uses the CPU.
+		/// </summary>
+		/// <param name="resource">The resource being loaded.</param>
+		/// <param name="loader">The loader to run.</param>
+		/// <param name="raw">The raw data, which this takes ownership of.
+		/// </param>
+		/// <returns>The handle for the loaded resource, empty on failure.
+		/// </returns>
+		[[nodiscard]]
+		std::shared_ptr<ResourceHandle> process_raw(Resource& resource,
+			ResourceLoader& loader, RawResource raw) noexcept;
+
+		/// <summary>
+		/// The part of process_raw that creates a handle with its own
+		/// buffer, either by running the loader or by mapping its output
+		/// from the derived data cache.
+		/// </summary>
+		/// <param name="resource">The resource being loaded.</param>
+		/// <param name="loader">The loader to run.</param>
+		/// <param name="raw">The raw data, which this takes ownership of.
+		/// </param>
+		/// <param name="content_hash">A hash of the raw data, if the derived
+		/// data cache is used.</param>
+		/// <param name="derived_version">The loader's derived data version,
+		/// empty to not use the derived data cache.</param>
+		/// <returns>The handle for the loaded resource, empty on failure.
+		/// </returns>
+		[[nodiscard]]
+		std::shared_ptr<ResourceHandle> run_loader(Resource& resource,
+			ResourceLoader& loader, RawResource raw,
+			const uint64_t content_hash, const std::string& derived_version)
+			noexcept;
+
+		/// <summary>
+		/// Create a handle that shares the buffer of a resource that is
+		/// already loaded with the same contents. The new handle isn't
+		/// charged anything, keeps the other one alive, and can't be written
+		/// to. Resources with extra data are never shared.
+		/// </summary>
+		/// <param name="resource">The resource being loaded.</param>
+		/// <param name="key">The contents to look for.</param>
+		/// <returns>The new handle, empty if nothing loaded has the same
+		/// contents.</returns>
+		[[nodiscard]]
+		std::shared_ptr<ResourceHandle> share_content(Resource& resource,
+			const ContentKey& key) noexcept;
+
+		/// <summary>
+		/// Remember a freshly loaded handle, so later resources with the
+		/// same contents can share its buffer. The handle can't be written to
+		/// from then on. Handles with extra data are skipped.
+		/// </summary>
+		/// <param name="key">The handle's contents.</param>
+		/// <param name="handle">The handle.</param>
+		void index_content(const ContentKey& key,
+			const std::shared_ptr<ResourceHandle>& handle) noexcept;
+
+		/// <summary>
+		/// Load a resource with a loader that streams, reading only what the
+		/// loader asks for.
+		/// </summary>
+		/// <param name="resource">The resource to load.</param>
+		/// <param name="loader">The loader to run.</param>
+		/// <returns>The handle for the loaded resource, empty on failure.
+		/// </returns>
+		[[nodiscard]]
+		std::shared_ptr<ResourceHandle> load_streamed(Resource& resource,
+			ResourceLoader& loader) noexcept;
+
+		/// <summary>
+		/// Queue a claimed load for the I/O threads, or load it right away if
+		/// the cache has no threads. If the cache is shutting down, the load
+		/// fails instead.
+		/// </summary>
+		/// <param name="shard">The shard the resource belongs to.</param>
+		/// <param name="resource">The resource to load.</param>
+		/// <param name="claim">The claim on the load.</param>
+		void queue_load(Shard& shard, Resource resource,
+			std::shared_ptr<ResourceHandlePromise> claim) noexcept;
+
+		/// <summary>
+		/// Take a batch of queued loads, read all of their raw data at once,
+		/// and hand each one to a compute thread as it is ready. Run on an
+		/// I/O thread.
+		/// </summary>
+		void load_queued() noexcept;
+
+		/// <summary>
+		/// Get the name table, building it if the file's resources have
+		/// changed since it was last built.
+		/// </summary>
+		/// <returns>The current name table.</returns>
+		[[nodiscard]]
+		std::shared_ptr<const ResourceNameTable> get_name_table() noexcept;
+
+		/// <summary>
+		/// Raise the peak allocation to a new total, if it is higher.
+		/// </summary>
+		/// <param name="total">The amount of cache memory now in use.</param>
+		void note_allocated(size_t total) noexcept;
+
+		/// <summary>
+		/// Free a raw buffer and give back any cache memory it used.
+		/// </summary>
+		/// <param name="raw">The raw data to release.</param>
+		void release_raw(RawResource& raw) noexcept;
 
 	protected:
 
 		/// <summary>
 		/// Attempt to make room in the cache by freeing memory. If there is no
 		/// possible way to free memory, we return false.
+		/// 
+		/// Resources are evicted to stay under the cache size. Once nothing
+		/// is left to evict, a load on one of the cache's threads waits up to
+		/// the backpressure timeout for memory to be freed, and then the
+		/// room is taken from between the cache size and the hard limit.
 		/// </summary>
 		/// <param name="size">The number of bytes we want to make room for.
 		/// </param>
@@ -70,11 +731,31 @@ namespace loquat
 		/// <summary>
 		/// Allocate raw memory of the specified size. If we did not have room
 		/// to do so, null will be returned.
+		/// 
+		/// The cache is charged for the size the buffer pool rounds up to,
+		/// see charge_for, so the budget matches the memory really used.
 		/// </summary>
 		/// <param name="size">The number of bytes to allocate.</param>
 		/// <returns>The allocated memory, or null in the worst case.</returns>
 		char* allocate(size_t size) noexcept;
 
+		/// <summary>
+		/// The number of bytes allocate charges against the cache for a
+		/// buffer.
+		/// </summary>
+		/// <param name="size">The size passed to allocate.</param>
+		/// <returns>The size after rounding.</returns>
+		[[nodiscard]]
+		static size_t charge_for(size_t size) noexcept;
+
+		/// <summary>
+		/// Give a buffer from allocate back to the buffer pool. This doesn't
+		/// touch the cache's accounting, see memory_has_been_freed.
+		/// </summary>
+		/// <param name="buffer">The buffer.</param>
+		/// <param name="size">The size passed to allocate.</param>
+		void release_buffer(char* buffer, size_t size) noexcept;
+
 		/// <summary>
 		/// Looks up a resource by handle and remove it from the cache.
 		/// 
@@ -102,19 +783,20 @@ namespace loquat
 		std::shared_ptr<ResourceHandle> find(Resource* resource) noexcept;
 
 		/// <summary>
-		/// Moves a handle to the front of the LRU list, to maintain the desired
-		/// sorting.
+		/// Tells the eviction policy that a handle was used.
 		/// </summary>
-		/// <param name="handle">The handle to update in the LRU tracking.</param>
+		/// <param name="handle">The handle that was used.</param>
 		void update(std::shared_ptr<ResourceHandle> handle) noexcept;
 
 		/// <summary>
-		/// Free the least recently used resource.
+		/// Free the resource the eviction policy picks from the next shard
+		/// that has anything it can evict.
 		/// 
 		/// The cache will only count the memory as freed once the resource
 		/// pointed to by the handle is destroyed.
 		/// </summary>
-		void free_one_resource() noexcept;
+		/// <returns>Whether there was anything to free.</returns>
+		bool free_one_resource() noexcept;
 
 		/// <summary>
 		/// Called whenever memory associated with a resource has actually been
@@ -123,6 +805,45 @@ namespace loquat
 		/// <param name="size"></param>
 		void memory_has_been_freed(size_t size) noexcept;
 
+		/// <summary>
+		/// Reserve memory past the cache size, up to the hard limit.
+		/// </summary>
+		/// <param name="size">The number of bytes to reserve.</param>
+		/// <returns>Whether it fit under the hard limit.</returns>
+		bool reserve_over_budget(size_t size) noexcept;
+
+		/// <summary>
+		/// Wait for memory to be freed or a resource to become evictable.
+		/// </summary>
+		/// <param name="seen">The memory generation before the caller last
+		/// tried to evict.</param>
+		/// <param name="deadline">When to give up.</param>
+		/// <returns>Whether something changed in time. False if the wait
+		/// timed out or the cache is shutting down.</returns>
+		bool wait_for_memory(const uint64_t seen,
+			const std::chrono::steady_clock::time_point deadline) noexcept;
+
+		/// <summary>
+		/// Wake the loads waiting for memory, so they try again.
+		/// </summary>
+		void wake_memory_waiters() noexcept;
+
+		/// <summary>
+		/// Tell the memory subscribers there is room, on an I/O thread.
+		/// </summary>
+		/// <param name="available">The bytes free under the soft limit.
+		/// </param>
+		void notify_memory_available(size_t available) noexcept;
+
+		/// <summary>
+		/// Remember a handle that left a shard while still held outside the
+		/// cache, for the pin report.
+		/// </summary>
+		/// <param name="shard">The shard it left.</param>
+		/// <param name="handle">The handle.</param>
+		void note_evicted_held(Shard& shard,
+			const std::shared_ptr<ResourceHandle>& handle) noexcept;
+
 	public:
 		/// <summary>
 		/// Create a resource cache for a file.
@@ -130,7 +851,15 @@ namespace loquat
 		/// <param name="size_in_MB">The amount of memory allocated to the 
 		/// cache, in megabytes.</param>
 		/// <param name="file">The file we are loading resources from.</param>
-		ResourceCache(const size_t size_in_MB, ResourceFile* file) noexcept;
+		/// <param name="shard_count">How many independently locked shards to
+		/// split the cache into. Rounded up to a power of two. Use more than
+		/// one when many threads load resources at the same time.</param>
+		/// <param name="eviction_policy">How to pick resources to evict.
+		/// </param>
+		ResourceCache(const size_t size_in_MB, ResourceFile* file,
+			const size_t shard_count = 1,
+			const ResourceEvictionPolicyType eviction_policy =
+			ResourceEvictionPolicyType::LRU) noexcept;
 
 		/// <summary>
 		/// Clean up.
@@ -141,9 +870,16 @@ namespace loquat
 		/// Initializes the resource cache, preparing to load resources. If we
 		/// had an issue, like the file already being in use by another cache
 		/// instance, we will return false.
+		/// 
+		/// This also starts the threads used for asynchronous loading.
 		/// </summary>
+		/// <param name="io_thread_count">The number of threads that read
+		/// resources from the file.</param>
+		/// <param name="compute_thread_count">The number of threads that run
+		/// resource loaders. Zero means one per hardware thread.</param>
 		/// <returns>Whether we initialized successfully.</returns>
-		bool init() noexcept;
+		bool init(const size_t io_thread_count = 4,
+			const size_t compute_thread_count = 0) noexcept;
 
 		/// <summary>
 		/// Register a resource loader, placing it at the front of the list of 
@@ -156,25 +892,99 @@ namespace loquat
 		/// <param name="loader">The loader to register.</param>
 		void register_loader(std::shared_ptr<ResourceLoader> loader) noexcept;
 
+		/// <summary>
+		/// Switch to one of the eviction policies that come with the cache.
+		/// </summary>
+		/// <param name="type">The kind of policy.</param>
+		void set_eviction_policy(const ResourceEvictionPolicyType type)
+			noexcept;
+
+		/// <summary>
+		/// Switch to a custom eviction policy. Resources already in the cache
+		/// are handed to the new policy coldest first, so it starts out with
+		/// roughly the same idea of what is in use.
+		/// </summary>
+		/// <param name="factory">Creates the policy for each shard.</param>
+		void set_eviction_policy(const ResourceEvictionPolicyFactory& factory)
+			noexcept;
+
 		/// <summary>
 		/// If a resource is already in the cache, return it. Otherwise, we load
 		/// the resource from file first.
 		/// 
 		/// If we had an error, like running out of memory, an empty pointer is
 		/// returned.
+		/// 
+		/// Safe to call from any thread. If another thread is already loading
+		/// the same resource, this waits for that load rather than starting
+		/// another one.
 		/// </summary>
 		/// <param name="resource">The resource to fetch.</param>
 		/// <returns>A handle to the resource.</returns>
 		[[nodiscard]]
 		std::shared_ptr<ResourceHandle> get_handle(Resource* resource) noexcept;
 
+		/// <summary>
+		/// Start fetching a resource without waiting for it. If the resource
+		/// is already in the cache the future is ready immediately. Otherwise
+		/// it joins a queue that the I/O threads read from in batches, and
+		/// the loader runs on a compute thread.
+		/// 
+		/// The future holds an empty pointer if the resource could not be
+		/// loaded.
+		/// </summary>
+		/// <param name="resource">The resource to fetch.</param>
+		/// <returns>A future for the handle to the resource.</returns>
+		[[nodiscard]]
+		ResourceHandleFuture get_handle_async(Resource resource) noexcept;
+
+		/// <summary>
+		/// Start loading a resource in the background if it isn't loaded or
+		/// on its way already, without waiting for it and without counting
+		/// as a request. Once it is loaded, its dependencies are prefetched
+		/// in turn, so this warms everything it refers to as well.
+		/// 
+		/// Loads run on the same threads as get_handle_async, so the
+		/// dependencies of a resource all load in parallel. A cache without
+		/// loader threads ignores prefetches.
+		/// </summary>
+		/// <param name="resource">The resource to prefetch.</param>
+		void prefetch(const Resource& resource) noexcept;
+
+		/// <summary>
+		/// Load a set of resources and everything they depend on, directly
+		/// or not, and wait for all of it. Each level of dependencies loads
+		/// in parallel, and cycles are fine.
+		/// 
+		/// Meant for warming up a level or a material ahead of time, off the
+		/// main thread. Hold on to the graph to keep the resources loaded.
+		/// </summary>
+		/// <param name="roots">The resources to start from.</param>
+		/// <returns>The graph of every resource reached. Resources that
+		/// failed to load have empty handles, and their dependencies aren't
+		/// known.</returns>
+		[[nodiscard]]
+		ResourceGraph load_graph(const std::vector<Resource>& roots) noexcept;
+
+		/// <summary>
+		/// Set how many reads a preload may have in flight at once.
+		/// </summary>
+		/// <param name="depth">The maximum number of outstanding reads.
+		/// </param>
+		void set_preload_depth(const size_t depth) noexcept;
+
 		/// <summary>
 		/// Pre-load a set of resources matching the specified wildcard pattern.
 		/// For example, a pattern of "*.jpg" loads all the jpeg files in the 
 		/// resource file.
 		/// 
-		/// This takes in a callback which will be notified with the percentage
-		/// progress, and whether we have canceled loading.
+		/// Matching resources are read in the order they are stored in the
+		/// file, with up to the preload depth of them loading in parallel.
+		/// The window is topped up half at a time, so reads are batched.
+		/// 
+		/// This takes in a callback which will be notified with the progress
+		/// in bytes, and which can cancel loading. Once canceled, no new reads
+		/// are started, and the reads already in flight are waited on.
 		/// </summary>
 		/// <param name="pattern">The wildcard pattern specifying which 
 		/// resources to load.</param>
@@ -185,19 +995,198 @@ namespace loquat
 
 		/// <summary>
 		/// Searches through the cache for assets that match the specified 
-		/// wildcard pattern.
+		/// wildcard pattern, ignoring case.
+		/// 
+		/// The pattern is compiled once and run over a table of every name
+		/// that is kept between calls, so a query doesn't copy any names.
 		/// </summary>
 		/// <param name="pattern">The wildcard pattern to look for.</param>
-		/// <returns>A list of resource names that match the given pattern.
-		/// </returns>
+		/// <returns>The lowercased names of the resources that match the
+		/// given pattern, in the order the file lists them.</returns>
 		[[nodiscard]]
-		std::vector<std::string> match(std::string_view pattern) noexcept;
+		ResourceNameMatches match(std::string_view pattern) noexcept;
+
+		/// <summary>
+		/// Fetch a resource like get_handle, and keep it in the cache until it
+		/// is unpinned, no matter how much room other resources need. Pins
+		/// are counted, so a resource pinned twice needs to be unpinned twice.
+		/// They belong to the resource rather than the handle, and carry over
+		/// when reload_changed loads it again.
+		/// </summary>
+		/// <param name="resource">The resource to pin.</param>
+		/// <returns>A handle to the resource, empty on failure.</returns>
+		std::shared_ptr<ResourceHandle> pin(Resource* resource) noexcept;
 
 		/// <summary>
-		/// Free every handle in the cache. Useful for loading a new level or 
-		/// debugging.
+		/// Undo one pin, letting the resource be evicted again once every pin
+		/// is undone.
+		/// </summary>
+		/// <param name="handle">The handle returned by pin, or any later
+		/// handle for the same resource.</param>
+		void unpin(const std::shared_ptr<ResourceHandle>& handle) noexcept;
+
+		/// <summary>
+		/// Free every handle in the cache that isn't pinned. Useful for
+		/// loading a new level or debugging.
 		/// </summary>
 		void flush() noexcept;
+
+		/// <summary>
+		/// Drop a resource from the cache, so the next time it is requested
+		/// it is loaded from the file again. Handles that are already held
+		/// keep the old data. This drops the resource even if it is pinned.
+		/// </summary>
+		/// <param name="resource">The resource to drop.</param>
+		/// <returns>Whether the resource was in the cache.</returns>
+		bool invalidate(const Resource& resource) noexcept;
+
+		/// <summary>
+		/// Ask the resource file to watch for changes to resources, so that
+		/// reload_changed can pick them up. Call this before loading
+		/// anything, since files stop handing out live mappings once they
+		/// are watched, and handles mapped before then would see changes.
+		/// </summary>
+		/// <returns>Whether the resource file supports watching.</returns>
+		bool watch_for_changes() noexcept;
+
+		/// <summary>
+		/// Open a stream over a resource without loading it into the cache,
+		/// for reading just the parts of a large resource that are needed.
+		/// </summary>
+		/// <param name="resource">The resource to read.</param>
+		/// <returns>The stream, empty if the resource is not found.</returns>
+		[[nodiscard]]
+		std::shared_ptr<ResourceStream> open_stream(const Resource& resource)
+			noexcept;
+
+		/// <summary>
+		/// Be notified whenever a resource is reloaded because it changed.
+		/// Callbacks are run by reload_changed, on the thread that calls it.
+		/// </summary>
+		/// <param name="resource">The resource to watch.</param>
+		/// <param name="callback">Called with the new handle.</param>
+		/// <returns>An ID for the subscription, to unsubscribe with.
+		/// </returns>
+		size_t subscribe(const Resource& resource,
+			ResourceChangedCallback callback) noexcept;
+
+		/// <summary>
+		/// Stop being notified about a resource, or about memory.
+		/// </summary>
+		/// <param name="subscription">The ID returned by subscribe or
+		/// subscribe_memory_available.</param>
+		void unsubscribe(const size_t subscription) noexcept;
+
+		/// <summary>
+		/// Check for resources that changed in the file. Each one that was
+		/// cached or has subscribers is invalidated and loaded again by its
+		/// resource loader, and then the subscribers are notified. Resources
+		/// that nobody has asked for are left alone.
+		/// 
+		/// Meant to be called once a frame, after watch_for_changes.
+		/// </summary>
+		/// <returns>The number of resources that were reloaded.</returns>
+		size_t reload_changed() noexcept;
+
+		/// <summary>
+		/// Take a snapshot of the cache's counters. The counters are always
+		/// on, and cheap enough to leave on in release builds.
+		/// </summary>
+		/// <returns>The stats since the cache was created or they were last
+		/// reset.</returns>
+		[[nodiscard]]
+		ResourceCacheStats get_stats() const noexcept;
+
+		/// <summary>
+		/// Zero every counter, and start tracking the peak allocation again
+		/// from what is in use now.
+		/// </summary>
+		void reset_stats() noexcept;
+
+		/// <summary>
+		/// List the resources whose memory the cache can't get back by
+		/// evicting: pinned ones, cached ones held outside the cache, and
+		/// evicted ones still held. Takes every shard's lock in turn, so it
+		/// is meant for debugging rather than every frame.
+		/// </summary>
+		/// <returns>The report, largest resources first.</returns>
+		[[nodiscard]]
+		ResourcePinReport get_pin_report() const noexcept;
+
+		/// <summary>
+		/// Let the cache go over its size, up to a hard limit, when what it
+		/// holds can't be evicted because it is in use. Loads only fail once
+		/// they would go past this. By default the hard limit is the cache
+		/// size.
+		/// </summary>
+		/// <param name="size_in_MB">The hard limit in megabytes, raised to
+		/// the cache size if it is below.</param>
+		void set_hard_limit(const size_t size_in_MB) noexcept;
+
+		/// <summary>
+		/// Set how long loads on the cache's threads wait for memory to be
+		/// freed, once nothing is left to evict, before going over the cache
+		/// size. Synchronous loads never wait. By default this is 100 ms.
+		/// </summary>
+		/// <param name="timeout">How long to wait, zero to never wait.
+		/// </param>
+		void set_backpressure_timeout(
+			const std::chrono::milliseconds timeout) noexcept;
+
+		/// <summary>
+		/// Be notified when the cache has room again after loads found
+		/// nothing left to evict, once usage drops an eighth below the cache
+		/// size. Callbacks run on one of the cache's I/O threads, and may
+		/// load resources.
+		/// </summary>
+		/// <param name="callback">Called with the bytes free under the cache
+		/// size.</param>
+		/// <returns>An ID for the subscription, to unsubscribe with.
+		/// </returns>
+		size_t subscribe_memory_available(MemoryAvailableCallback callback)
+			noexcept;
+
+		/// <summary>
+		/// Write the stats to a file when the cache is destroyed, so a whole
+		/// run can be looked at afterwards.
+		/// </summary>
+		/// <param name="path">The file to write, or empty to not write
+		/// one.</param>
+		void dump_stats_on_exit(std::string path) noexcept;
+
+		/// <summary>
+		/// Keep what loaders produce on disk, so later runs can map it
+		/// instead of loading it again. Only loaders that give a derived data
+		/// version are cached, see ResourceLoader::get_derived_data_version.
+		/// 
+		/// Must be called before anything is loaded.
+		/// </summary>
+		/// <param name="directory">The folder to keep the output in.</param>
+		/// <param name="size_in_MB">The most disk space to use, in
+		/// megabytes. The least recently used output is deleted to stay
+		/// under it.</param>
+		/// <returns>Whether the folder could be used.</returns>
+		bool use_derived_data_cache(const std::string directory,
+			const size_t size_in_MB) noexcept;
+
+		/// <summary>
+		/// Let resources with byte for byte the same raw data share one
+		/// buffer, as long as the same loader loads them. The raw data is
+		/// still read, but only the first copy is kept, and the rest are
+		/// handles onto it that cost the cache nothing. The buffer is freed
+		/// once every handle sharing it is gone.
+		/// 
+		/// Buffers that could be shared can't be written to, since every name
+		/// would see the change, so while this is on their handles return
+		/// null from get_writeable_buffer, even before a second name shares
+		/// them. Off by default.
+		/// Loaders have to produce the same output for the same raw data.
+		/// Resources their loader gave extra data, and streamed resources,
+		/// are never shared.
+		/// </summary>
+		/// <param name="enable">Whether to share buffers from now on.
+		/// </param>
+		void set_deduplication(const bool enable) noexcept;
 	};
 
 	[[nodiscard]] extern bool 
@@ -0,0 +1,348 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "resource/resource_buffer_pool.h"
+
+namespace loquat
+{
+	/// <summary>
+	/// A snapshot of a latency histogram, safe to copy around and read at
+	/// leisure.
+	/// </summary>
+	struct LatencySummary
+	{
+		/// <summary>
+		/// The number of buckets. Bucket 0 holds samples under a microsecond,
+		/// bucket i holds samples from 2^(i - 1) up to 2^i microseconds, and
+		/// the last bucket holds everything slower than that.
+		/// </summary>
+		static constexpr size_t BUCKET_COUNT = 24;
+
+		/// <summary>
+		/// The number of samples in each bucket.
+		/// </summary>
+		std::array<uint64_t, BUCKET_COUNT> buckets{};
+
+		/// <summary>
+		/// The number of samples recorded.
+		/// </summary>
+		uint64_t count = 0;
+
+		/// <summary>
+		/// The sum of every sample, in nanoseconds.
+		/// </summary>
+		uint64_t total_ns = 0;
+
+		/// <summary>
+		/// The slowest sample, in nanoseconds.
+		/// </summary>
+		uint64_t max_ns = 0;
+
+		/// <summary>
+		/// The upper bound of a bucket, in microseconds.
+		/// </summary>
+		/// <param name="bucket">The bucket index.</param>
+		/// <returns>The bound, or 0 for the last bucket, which has none.
+		/// </returns>
+		[[nodiscard]]
+		static uint64_t bucket_limit_us(const size_t bucket) noexcept;
+
+		/// <summary>
+		/// The average sample, in microseconds.
+		/// </summary>
+		[[nodiscard]]
+		double mean_us() const noexcept;
+
+		/// <summary>
+		/// Estimate a percentile from the buckets. The answer is the upper
+		/// bound of the bucket it falls in, so it can be up to twice the real
+		/// value.
+		/// </summary>
+		/// <param name="fraction">The percentile, from 0 to 1.</param>
+		/// <returns>The estimate, in microseconds.</returns>
+		[[nodiscard]]
+		double percentile_us(const double fraction) const noexcept;
+	};
+
+	/// <summary>
+	/// Counts how long something takes, bucketed by powers of two.
+	///
+	/// Recording is a few relaxed atomic adds and never locks, so this is
+	/// cheap enough to leave on in release builds for anything that takes
+	/// longer than a microsecond or so.
+	/// </summary>
+	class LatencyHistogram
+	{
+		std::array<std::atomic<uint64_t>, LatencySummary::BUCKET_COUNT>
+			buckets{};
+		std::atomic<uint64_t> count{ 0 };
+		std::atomic<uint64_t> total_ns{ 0 };
+		std::atomic<uint64_t> max_ns{ 0 };
+
+	public:
+		/// <summary>
+		/// Record one sample.
+		/// </summary>
+		/// <param name="elapsed">How long it took.</param>
+		void record(const std::chrono::steady_clock::duration elapsed)
+			noexcept;
+
+		/// <summary>
+		/// Copy the counts out. Samples recorded at the same time may or may
+		/// not be included.
+		/// </summary>
+		[[nodiscard]]
+		LatencySummary summary() const noexcept;
+
+		/// <summary>
+		/// Forget every sample.
+		/// </summary>
+		void reset() noexcept;
+	};
+
+	/// <summary>
+	/// Times a scope and records it in a histogram when the scope ends.
+	/// </summary>
+	class ScopedLatency
+	{
+		LatencyHistogram& histogram;
+		const std::chrono::steady_clock::time_point start;
+
+	public:
+		explicit ScopedLatency(LatencyHistogram& histogram) noexcept
+			: histogram{ histogram }
+			, start{ std::chrono::steady_clock::now() }
+		{
+		}
+
+		ScopedLatency(const ScopedLatency&) = delete;
+		ScopedLatency& operator=(const ScopedLatency&) = delete;
+
+		~ScopedLatency()
+		{
+			histogram.record(std::chrono::steady_clock::now() - start);
+		}
+	};
+
+	/// <summary>
+	/// A snapshot of what a resource cache has been doing, to tune its size
+	/// and eviction policy against.
+	/// </summary>
+	struct ResourceCacheStats
+	{
+		/// <summary>
+		/// Requests for resources that were already loaded.
+		/// </summary>
+		uint64_t hits = 0;
+
+		/// <summary>
+		/// Requests that had to load the resource.
+		/// </summary>
+		uint64_t misses = 0;
+
+		/// <summary>
+		/// Requests for resources that another request was already loading,
+		/// which waited for that load instead of starting their own.
+		/// </summary>
+		uint64_t joined = 0;
+
+		/// <summary>
+		/// Loads that failed, for a missing resource, no room, or a loader
+		/// error.
+		/// </summary>
+		uint64_t failed_loads = 0;
+
+		/// <summary>
+		/// Loads started by prefetching dependencies rather than by a
+		/// request. Requests that find them later count as hits or joins.
+		/// </summary>
+		uint64_t prefetched = 0;
+
+		/// <summary>
+		/// Bytes read or mapped from the resource file.
+		/// </summary>
+		uint64_t bytes_read = 0;
+
+		/// <summary>
+		/// Bytes of loaded resources added to the cache.
+		/// </summary>
+		uint64_t bytes_loaded = 0;
+
+		/// <summary>
+		/// Resources evicted to make room.
+		/// </summary>
+		uint64_t evictions = 0;
+
+		/// <summary>
+		/// Cache memory given up by evicted resources.
+		/// </summary>
+		uint64_t bytes_evicted = 0;
+
+		/// <summary>
+		/// The cache memory in use when the snapshot was taken.
+		/// </summary>
+		size_t allocated = 0;
+
+		/// <summary>
+		/// The most cache memory that has ever been in use at once.
+		/// </summary>
+		size_t peak_allocated = 0;
+
+		/// <summary>
+		/// The memory the cache evicts to stay under.
+		/// </summary>
+		size_t cache_size = 0;
+
+		/// <summary>
+		/// The most memory the cache may use when nothing is left to evict.
+		/// </summary>
+		size_t hard_limit = 0;
+
+		/// <summary>
+		/// Loads that found nothing left to evict and waited for memory to
+		/// be freed.
+		/// </summary>
+		uint64_t backpressure_waits = 0;
+
+		/// <summary>
+		/// Loads that gave up waiting for memory.
+		/// </summary>
+		uint64_t backpressure_timeouts = 0;
+
+		/// <summary>
+		/// Loads that went over the cache size, up to the hard limit.
+		/// </summary>
+		uint64_t over_budget_loads = 0;
+
+		/// <summary>
+		/// Time spent in ResourceFile reads. A batch of reads counts as one
+		/// sample per batch, since they are all in flight together.
+		/// </summary>
+		LatencySummary file_read;
+
+		/// <summary>
+		/// Time spent in ResourceLoader loads, including streaming loads,
+		/// which read as they go.
+		/// </summary>
+		LatencySummary loader;
+
+		/// <summary>
+		/// How the memory behind the cache's buffers is laid out, including
+		/// how much of it is lost to fragmentation.
+		/// </summary>
+		ResourceBufferPoolStats buffers;
+
+		/// <summary>
+		/// Loads that shared the buffer of a resource with the same contents
+		/// instead of keeping their own.
+		/// </summary>
+		uint64_t deduplicated = 0;
+
+		/// <summary>
+		/// Cache memory those loads would have been charged for.
+		/// </summary>
+		uint64_t bytes_deduplicated = 0;
+
+		/// <summary>
+		/// Loads that mapped a loader's output saved by an earlier run.
+		/// </summary>
+		uint64_t derived_hits = 0;
+
+		/// <summary>
+		/// Loads that looked for saved output and had to run the loader.
+		/// </summary>
+		uint64_t derived_misses = 0;
+
+		/// <summary>
+		/// Loader outputs saved for later runs.
+		/// </summary>
+		uint64_t derived_stores = 0;
+
+		/// <summary>
+		/// The disk space taken by saved loader output, in bytes.
+		/// </summary>
+		size_t derived_disk_size = 0;
+
+		/// <summary>
+		/// The fraction of requests that were hits, counting joined requests
+		/// as hits since they didn't load anything themselves.
+		/// </summary>
+		[[nodiscard]]
+		double hit_rate() const noexcept;
+
+		/// <summary>
+		/// Format the stats as a human readable report, one stat per line.
+		/// </summary>
+		[[nodiscard]]
+		std::string to_string() const noexcept;
+	};
+
+	/// <summary>
+	/// A resource whose memory the cache can't get back by evicting it.
+	/// </summary>
+	struct ResourcePin
+	{
+		/// <summary>
+		/// The name of the resource.
+		/// </summary>
+		std::string name;
+
+		/// <summary>
+		/// The cache memory charged for it.
+		/// </summary>
+		size_t size = 0;
+
+		/// <summary>
+		/// The number of references to it from outside the cache, including
+		/// other resources sharing its buffer.
+		/// </summary>
+		long holders = 0;
+
+		/// <summary>
+		/// How many times it is pinned.
+		/// </summary>
+		size_t pin_count = 0;
+
+		/// <summary>
+		/// Whether it is still in the cache, rather than evicted.
+		/// </summary>
+		bool cached = false;
+	};
+
+	/// <summary>
+	/// Everything holding on to a resource cache's memory, for finding out
+	/// why it runs out of room.
+	/// </summary>
+	struct ResourcePinReport
+	{
+		/// <summary>
+		/// The resources, largest first.
+		/// </summary>
+		std::vector<ResourcePin> pins;
+
+		/// <summary>
+		/// Memory held by resources that are still cached.
+		/// </summary>
+		size_t cached_bytes = 0;
+
+		/// <summary>
+		/// Memory held by resources that were evicted, which the cache has
+		/// no way to get back.
+		/// </summary>
+		size_t evicted_bytes = 0;
+
+		/// <summary>
+		/// Format the report, one resource per line.
+		/// </summary>
+		/// <param name="max_pins">The most resources to list.</param>
+		[[nodiscard]]
+		std::string to_string(const size_t max_pins = 32) const noexcept;
+	};
+}
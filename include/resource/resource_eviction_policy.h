@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace loquat
+{
+	class ResourceHandle;
+
+	/// <summary>
+	/// Decides which resource a cache shard gives up when the cache runs out
+	/// of room.
+	///
+	/// Each shard has its own policy, and the cache only calls it with that
+	/// shard's mutex held, so policies don't need any locking of their own.
+	/// The policy only tracks handles that may be evicted. Pinned handles are
+	/// removed from it until they are unpinned.
+	/// </summary>
+	class ResourceEvictionPolicy
+	{
+	public:
+		virtual ~ResourceEvictionPolicy() = default;
+
+		/// <summary>
+		/// Start tracking a handle that was just added to the cache.
+		/// </summary>
+		/// <param name="handle">The handle to track.</param>
+		virtual void insert(ResourceHandle* handle) noexcept = 0;
+
+		/// <summary>
+		/// Note that a tracked handle was used.
+		/// </summary>
+		/// <param name="handle">The handle that was used.</param>
+		virtual void touch(ResourceHandle* handle) noexcept = 0;
+
+		/// <summary>
+		/// Stop tracking a handle that is leaving the cache for some reason
+		/// other than eviction, or being pinned.
+		/// </summary>
+		/// <param name="handle">The handle to stop tracking.</param>
+		virtual void remove(ResourceHandle* handle) noexcept = 0;
+
+		/// <summary>
+		/// Pick the handle to evict and stop tracking it.
+		/// </summary>
+		/// <returns>The handle to evict, null if nothing is tracked.
+		/// </returns>
+		[[nodiscard]]
+		virtual ResourceHandle* evict() noexcept = 0;
+	};
+
+	/// <summary>
+	/// The eviction policies that come with the cache.
+	/// </summary>
+	enum class ResourceEvictionPolicyType
+	{
+		/// <summary>
+		/// Evict the least recently used resource.
+		/// </summary>
+		LRU,
+
+		/// <summary>
+		/// Adaptive replacement, which keeps resources that have been used
+		/// more than once apart from ones that have only been used once, so a
+		/// single pass over lots of resources can't flush the ones in regular
+		/// use.
+		/// </summary>
+		ARC,
+
+		/// <summary>
+		/// Greedy dual size frequency, which prefers to keep resources that
+		/// are small, used often, and expensive to load again.
+		/// </summary>
+		GDSF
+	};
+
+	/// <summary>
+	/// Creates the eviction policy for one shard, given the number of bytes
+	/// that shard is expected to hold. The policy must be allocated with
+	/// alloc, and the cache takes ownership of it.
+	/// </summary>
+	using ResourceEvictionPolicyFactory =
+		std::function<ResourceEvictionPolicy*(size_t)>;
+
+	/// <summary>
+	/// Create one of the eviction policies that come with the cache.
+	/// </summary>
+	/// <param name="type">The kind of policy.</param>
+	/// <param name="capacity">The number of bytes the shard is expected to
+	/// hold.</param>
+	/// <returns>The policy, allocated with alloc.</returns>
+	[[nodiscard]]
+	ResourceEvictionPolicy* make_eviction_policy(
+		ResourceEvictionPolicyType type, size_t capacity) noexcept;
+}
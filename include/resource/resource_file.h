@@ -1,10 +1,68 @@
 #pragma once
 
+#include <memory>
 #include <string>
+#include <vector>
+
+#include "resource/resource_stream.h"
 
 namespace loquat
 {
-	class Resource;
+
+	/// <summary>
+	/// A view of a resource that is mapped straight into memory from storage,
+	/// rather than copied into a buffer.
+	/// </summary>
+	struct ResourceMapping
+	{
+		/// <summary>
+		/// The start of the resource data, null if the resource is not mapped.
+		/// Writes go to private copies of the pages, never back to the file.
+		/// </summary>
+		char* data = nullptr;
+
+		/// <summary>
+		/// The size of the resource, in bytes.
+		/// </summary>
+		size_t size = 0;
+
+		/// <summary>
+		/// Keeps the mapping alive. The memory is unmapped once every copy of
+		/// this is gone.
+		/// </summary>
+		std::shared_ptr<void> owner;
+	};
+
+	/// <summary>
+	/// One read in a batch: a range of a resource, and where to put it.
+	/// </summary>
+	struct ResourceRead
+	{
+		/// <summary>
+		/// The resource to read.
+		/// </summary>
+		const Resource* resource = nullptr;
+
+		/// <summary>
+		/// Where to start, from the start of the resource.
+		/// </summary>
+		size_t offset = 0;
+
+		/// <summary>
+		/// How many bytes to read.
+		/// </summary>
+		size_t length = 0;
+
+		/// <summary>
+		/// Where to put them, with room for at least length bytes.
+		/// </summary>
+		char* buffer = nullptr;
+
+		/// <summary>
+		/// Filled in with the number of bytes actually read.
+		/// </summary>
+		size_t bytes_read = 0;
+	};
 
 	/// <summary>
 	/// A file that can be opened and closed, and provides the application with
@@ -26,6 +84,18 @@ namespace loquat
 		/// <returns>The size, in bytes.</returns>
 		virtual size_t get_raw_resource_size(const Resource& resource) = 0;
 
+		/// <summary>
+		/// Fetch where a resource is stored in the file, used to read
+		/// resources in storage order when loading many at once. Files that
+		/// don't have a meaningful order return 0 for everything.
+		/// </summary>
+		/// <param name="resource">The resource we want the offset of.</param>
+		/// <returns>The offset of the resource, in bytes.</returns>
+		virtual size_t get_resource_offset(const Resource& resource)
+		{
+			return 0;
+		}
+
 		/// <summary>
 		/// Read the resource from the file.
 		/// </summary>
@@ -34,6 +104,54 @@ namespace loquat
 		/// <returns>The size of the loaded resource, in bytes.</returns>
 		virtual size_t load_resource(const Resource& resource, char* buffer) = 0;
 
+		/// <summary>
+		/// Read part of a resource from the file. Must be safe to call from
+		/// several threads at once.
+		/// 
+		/// By default this reads the whole resource and copies out the part
+		/// that was asked for, so files that can seek should override it.
+		/// </summary>
+		/// <param name="resource">The resource to read.</param>
+		/// <param name="offset">Where to start, from the start of the
+		/// resource.</param>
+		/// <param name="length">The most bytes to read.</param>
+		/// <param name="buffer">The buffer to load into, with room for at
+		/// least length bytes.</param>
+		/// <returns>The number of bytes read, which is less than the length
+		/// if the range runs past the end of the resource, and 0 if the
+		/// resource is not found.</returns>
+		virtual size_t load_range(const Resource& resource, size_t offset,
+			size_t length, char* buffer);
+
+		/// <summary>
+		/// Read many resources at once, and wait for all of them. Files on
+		/// fast storage should override this to keep many reads in flight.
+		/// By default each read goes through load_range in turn.
+		/// </summary>
+		/// <param name="reads">The reads to do. Each one's bytes_read is
+		/// filled in.</param>
+		virtual void load_batch(std::vector<ResourceRead>& reads);
+
+		/// <summary>
+		/// Open a stream to read a resource a piece at a time.
+		/// </summary>
+		/// <param name="resource">The resource to read.</param>
+		/// <returns>The stream, empty if the resource is not found.</returns>
+		virtual std::shared_ptr<ResourceStream> open_stream(
+			const Resource& resource);
+
+		/// <summary>
+		/// Map a resource into memory without copying it. Files that don't
+		/// support mapping, or can't map this particular resource, return an
+		/// empty mapping and the resource must be read with load_resource.
+		/// </summary>
+		/// <param name="resource">The resource to map.</param>
+		/// <returns>The mapping, with null data on failure.</returns>
+		virtual ResourceMapping map_resource(const Resource& resource)
+		{
+			return ResourceMapping();
+		}
+
 		/// <summary>
 		/// Calculates the number of resources that are in the file.
 		/// </summary>
@@ -49,6 +167,26 @@ namespace loquat
 		/// </returns>
 		virtual std::string get_resource_name(size_t index) = 0;
 
+		/// <summary>
+		/// Start watching the file for changes to resources, so that they can
+		/// be reloaded while running. Files that can't change, or can't tell
+		/// when they do, return false.
+		/// </summary>
+		/// <returns>Whether changes are being watched for.</returns>
+		virtual bool watch()
+		{
+			return false;
+		}
+
+		/// <summary>
+		/// Collect the resources that have been created, modified or removed
+		/// since the last time this was called. Never blocks.
+		/// </summary>
+		/// <param name="changed_names">Names of the resources that changed
+		/// are appended here, each at most once.</param>
+		virtual void poll_changes(std::vector<std::string>& changed_names)
+		{}
+
 		/// <summary>
 		/// Clean up.
 		/// </summary>
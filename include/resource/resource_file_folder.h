@@ -1,20 +1,28 @@
 #pragma once
 
-#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <mutex>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "resource/batch_file_reader.h"
 #include "resource/resource_file.h"
 
 namespace loquat
 {
 	/// <summary>
 	/// A resource file that loads from a regular folder.
+	///
+	/// The name, size and modification time of every file is kept in a
+	/// manifest next to the folder, so that opening the folder only has to
+	/// check the modification time of each directory rather than walking
+	/// every file. Size, name and count queries never touch the disk.
 	/// </summary>
 	class ResourceFileFolder : public ResourceFile
 	{
-	private:
+	protected:
 
 		/// <summary>
 		/// The name of the folder, including the path.
@@ -57,6 +65,36 @@ namespace loquat
 		/// <returns>The size of the loaded resource, in bytes.</returns>
 		virtual size_t load_resource(const Resource& resource, char* buffer);
 
+		/// <summary>
+		/// Read part of a resource from the file, seeking straight to it. If
+		/// the resource is not found, returns 0.
+		/// </summary>
+		/// <param name="resource">The resource to read.</param>
+		/// <param name="offset">Where to start, from the start of the
+		/// resource.</param>
+		/// <param name="length">The most bytes to read.</param>
+		/// <param name="buffer">The buffer to load into.</param>
+		/// <returns>The number of bytes read.</returns>
+		virtual size_t load_range(const Resource& resource, size_t offset,
+			size_t length, char* buffer);
+
+		/// <summary>
+		/// Open a stream to read a resource a piece at a time. The file stays
+		/// open for as long as the stream does.
+		/// </summary>
+		/// <param name="resource">The resource to read.</param>
+		/// <returns>The stream, empty if the resource is not found.</returns>
+		virtual std::shared_ptr<ResourceStream> open_stream(
+			const Resource& resource);
+
+		/// <summary>
+		/// Read many resources at once, with io_uring where the kernel has it
+		/// and a pool of threads otherwise.
+		/// </summary>
+		/// <param name="reads">The reads to do. Each one's bytes_read is
+		/// filled in.</param>
+		virtual void load_batch(std::vector<ResourceRead>& reads);
+
 		/// <summary>
 		/// Calculates the number of resources that are in the file.
 		/// </summary>
@@ -72,9 +110,183 @@ namespace loquat
 		/// </returns>
 		virtual std::string get_resource_name(size_t index);
 
+		/// <summary>
+		/// Start watching every directory in the folder for changes. Only
+		/// supported on Linux, using inotify.
+		/// </summary>
+		/// <returns>Whether changes are being watched for.</returns>
+		virtual bool watch();
+
+		/// <summary>
+		/// Whether watch has been called and succeeded.
+		/// </summary>
+		[[nodiscard]]
+		bool is_watching() const noexcept
+		{
+			return watch_descriptor >= 0;
+		}
+
+		/// <summary>
+		/// Collect the files that were written, moved or removed since the
+		/// last poll, and update the manifest to match.
+		/// </summary>
+		/// <param name="changed_names">Names of the files that changed are
+		/// appended here, each at most once.</param>
+		virtual void poll_changes(std::vector<std::string>& changed_names);
+
 	private:
-		std::vector<std::string> cached_file_names;
-		std::atomic_bool has_file_name_cache = false;
-		std::mutex cache_mutex;
+		/// <summary>
+		/// A file in the folder, as recorded in the manifest.
+		/// </summary>
+		struct ManifestEntry
+		{
+			/// <summary>
+			/// The name of the file, relative to the folder.
+			/// </summary>
+			std::string name;
+
+			/// <summary>
+			/// The size of the file, in bytes.
+			/// </summary>
+			uint64_t size;
+
+			/// <summary>
+			/// When the file was last modified, in file clock ticks.
+			/// </summary>
+			int64_t modified;
+		};
+
+		/// <summary>
+		/// A directory in the folder, as recorded in the manifest. Adding,
+		/// removing or renaming a file changes the modification time of the
+		/// directory it is in, which is how we tell the manifest is stale.
+		/// </summary>
+		struct ManifestDirectory
+		{
+			/// <summary>
+			/// The name of the directory, relative to the folder. Empty for
+			/// the folder itself.
+			/// </summary>
+			std::string name;
+
+			/// <summary>
+			/// When the directory was last modified, in file clock ticks.
+			/// </summary>
+			int64_t modified;
+		};
+
+		/// <summary>
+		/// Read the manifest from disk, replacing what we have in memory.
+		/// </summary>
+		/// <returns>Whether the manifest existed and was well formed.</returns>
+		bool read_manifest() noexcept;
+
+		/// <summary>
+		/// Check whether the manifest still matches the folder, by comparing
+		/// the modification time of every directory. Files overwritten in
+		/// place are found when they are loaded instead.
+		/// </summary>
+		/// <returns>Whether the manifest is current.</returns>
+		[[nodiscard]]
+		bool manifest_is_current() const noexcept;
+
+		/// <summary>
+		/// Walk the folder and record every directory and file in it.
+		/// </summary>
+		void scan_folder() noexcept;
+
+		/// <summary>
+		/// Write the manifest to disk. Failing to write it is not an error,
+		/// it just means the next open will have to scan the folder again.
+		/// </summary>
+		void write_manifest() noexcept;
+
+		/// <summary>
+		/// Rebuild the index from names to entries.
+		/// </summary>
+		void index_entries() noexcept;
+
+		/// <summary>
+		/// Update the entry for a file after it changed, adding it if it is
+		/// new or removing it if it is gone.
+		/// </summary>
+		/// <param name="name">The name of the file, relative to the folder.
+		/// </param>
+		void refresh_entry(const std::string& name) noexcept;
+
+		/// <summary>
+		/// Watch a directory, and every directory in it, for changes.
+		/// </summary>
+		/// <param name="name">The name of the directory, relative to the
+		/// folder. Empty for the folder itself.</param>
+		/// <param name="found_files">If not null, the names of the files
+		/// already in the directories are appended here.</param>
+		void add_watch(const std::string& name,
+			std::vector<std::string>* found_files) noexcept;
+
+		/// <summary>
+		/// Stop watching a directory that was deleted or moved out of the
+		/// folder, and every directory in it. Nothing is announced for the
+		/// files that went with it, so they are all reported as changed.
+		/// </summary>
+		/// <param name="name">The name of the directory, relative to the
+		/// folder.</param>
+		/// <param name="removed_files">The names of the files we knew were
+		/// in it are appended here.</param>
+		void remove_watch(const std::string& name,
+			std::vector<std::string>& removed_files) noexcept;
+
+		/// <summary>
+		/// The name of the manifest file, including the path.
+		/// </summary>
+		const std::string manifest_file_name;
+
+		/// <summary>
+		/// Every file in the folder, sorted by name.
+		/// </summary>
+		std::vector<ManifestEntry> entries;
+
+		/// <summary>
+		/// Every directory in the folder, including the folder itself.
+		/// </summary>
+		std::vector<ManifestDirectory> directories;
+
+		/// <summary>
+		/// Maps the name of a file to its index in the entries.
+		/// </summary>
+		std::unordered_map<std::string, size_t> entry_index;
+
+		/// <summary>
+		/// Whether a file was found to have changed since the manifest was
+		/// written, so it needs to be written again.
+		/// </summary>
+		bool manifest_dirty = false;
+
+		/// <summary>
+		/// Guards the entries, since loads may update them.
+		/// </summary>
+		std::mutex manifest_mutex;
+
+		/// <summary>
+		/// Reads batches of files, created the first time it is needed.
+		/// </summary>
+		BatchFileReader* batch_reader = nullptr;
+
+		/// <summary>
+		/// Makes sure the batch reader is only created once.
+		/// </summary>
+		std::once_flag batch_reader_created;
+
+		/// <summary>
+		/// The file descriptor we read change notifications from, or -1 if
+		/// we are not watching.
+		/// </summary>
+		int watch_descriptor = -1;
+
+		/// <summary>
+		/// Maps each watch to the name of the directory it is watching,
+		/// relative to the folder.
+		/// </summary>
+		std::unordered_map<int, std::string> watched_directories;
 	};
 }
\ No newline at end of file
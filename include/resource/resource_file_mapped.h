@@ -0,0 +1,55 @@
+#pragma once
+
+#include "resource/resource_file_folder.h"
+
+namespace loquat
+{
+	/// <summary>
+	/// A resource file that reads from a regular folder like
+	/// ResourceFileFolder, but memory maps resources instead of copying them.
+	///
+	/// Handles for resources that don't need processing point straight into
+	/// the mapping. They are charged to the cache for the whole mapping,
+	/// since every page of it can end up resident as it is read.
+	///
+	/// Once the folder is being watched nothing is mapped any more, and
+	/// resources are copied like ResourceFileFolder does. A file that is
+	/// written in place shows through a private mapping into every handle
+	/// that holds it, and one that is truncated makes reading the handle
+	/// crash, so live mappings can't be handed out for files that are
+	/// expected to change.
+	/// </summary>
+	class ResourceFileMapped : public ResourceFileFolder
+	{
+	public:
+		/// <summary>
+		/// Create a new resource file that maps files from a folder.
+		/// </summary>
+		/// <param name="resource_folder_name">The name of the folder to read
+		/// from, including path. Assumes it does not end in a separator,
+		/// and will apend one.</param>
+		ResourceFileMapped(const std::string resource_folder_name);
+
+		/// <summary>
+		/// Clean up.
+		/// </summary>
+		virtual ~ResourceFileMapped();
+
+		/// <summary>
+		/// Map a resource into memory. If the resource is not found or is
+		/// empty, or the folder is being watched, an empty mapping is
+		/// returned.
+		/// </summary>
+		/// <param name="resource">The resource to map.</param>
+		/// <returns>The mapping, with null data on failure.</returns>
+		virtual ResourceMapping map_resource(const Resource& resource);
+	};
+
+	/// <summary>
+	/// Map an entire file into memory, with private copy-on-write pages.
+	/// </summary>
+	/// <param name="path">The full path of the file.</param>
+	/// <returns>The mapping, with null data on failure.</returns>
+	[[nodiscard]]
+	ResourceMapping map_file(const std::string& path) noexcept;
+}
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "resource/resource_file.h"
+
+namespace loquat
+{
+	/// <summary>
+	/// The header at the very start of a resource pack.
+	///
+	/// A pack is laid out as the header, then the table of contents, then
+	/// the names of every resource, then the resource data. All values are
+	/// little endian.
+	/// </summary>
+	struct ResourcePackHeader
+	{
+		/// <summary>
+		/// Always "LQPK".
+		/// </summary>
+		char magic[4];
+
+		/// <summary>
+		/// The version of the pack format.
+		/// </summary>
+		uint32_t version;
+
+		/// <summary>
+		/// The number of resources in the pack.
+		/// </summary>
+		uint64_t entry_count;
+
+		/// <summary>
+		/// Where the table of contents starts, from the start of the pack.
+		/// </summary>
+		uint64_t toc_offset;
+
+		/// <summary>
+		/// Where the names start, from the start of the pack.
+		/// </summary>
+		uint64_t names_offset;
+
+		/// <summary>
+		/// The total size of all the names, in bytes.
+		/// </summary>
+		uint64_t names_size;
+	};
+
+	/// <summary>
+	/// One entry in the table of contents of a resource pack. Entries are
+	/// sorted by name hash, and then by name.
+	/// </summary>
+	struct ResourcePackEntry
+	{
+		/// <summary>
+		/// The hash of the resource name.
+		/// </summary>
+		uint64_t name_hash;
+
+		/// <summary>
+		/// Where the data starts, from the start of the pack. Always aligned
+		/// to RESOURCE_PACK_ALIGNMENT.
+		/// </summary>
+		uint64_t data_offset;
+
+		/// <summary>
+		/// The size of the data, in bytes.
+		/// </summary>
+		uint64_t size;
+
+		/// <summary>
+		/// Where the name starts, from the start of the names.
+		/// </summary>
+		uint32_t name_offset;
+
+		/// <summary>
+		/// The length of the name, in bytes, with no null terminator.
+		/// </summary>
+		uint32_t name_length;
+	};
+
+	/// <summary>
+	/// The version of the pack format that we read and write.
+	/// </summary>
+	constexpr uint32_t RESOURCE_PACK_VERSION = 1;
+
+	/// <summary>
+	/// The alignment of resource data within a pack, so that it can be read
+	/// with direct I/O or mapped a page at a time.
+	/// </summary>
+	constexpr uint64_t RESOURCE_PACK_ALIGNMENT = 4096;
+
+	/// <summary>
+	/// A resource file that reads from a single packed archive.
+	///
+	/// The archive is mapped into memory when it is opened, and the table of
+	/// contents is used in place, so looking up, sizing and enumerating
+	/// resources never touches the file system.
+	/// </summary>
+	class ResourceFilePack : public ResourceFile
+	{
+	private:
+		/// <summary>
+		/// The name of the pack, including the path.
+		/// </summary>
+		const std::string pack_file_name;
+
+		/// <summary>
+		/// The whole pack, mapped into memory.
+		/// </summary>
+		ResourceMapping pack;
+
+		/// <summary>
+		/// The table of contents, pointing into the mapped pack.
+		/// </summary>
+		const ResourcePackEntry* entries = nullptr;
+
+		/// <summary>
+		/// The number of entries in the table of contents.
+		/// </summary>
+		size_t entry_count = 0;
+
+		/// <summary>
+		/// The resource names, pointing into the mapped pack.
+		/// </summary>
+		const char* names = nullptr;
+
+		/// <summary>
+		/// Look up the entry for a resource.
+		/// </summary>
+		/// <param name="resource">The resource to find.</param>
+		/// <returns>The entry, or null if there is no such resource.
+		/// </returns>
+		[[nodiscard]]
+		const ResourcePackEntry* find(const Resource& resource) const noexcept;
+
+	public:
+		/// <summary>
+		/// Create a new resource file that reads from a pack.
+		/// </summary>
+		/// <param name="pack_file_name">The name of the pack, including
+		/// path.</param>
+		ResourceFilePack(const std::string pack_file_name);
+
+		/// <summary>
+		/// Clean up.
+		/// </summary>
+		virtual ~ResourceFilePack();
+
+		/// <summary>
+		/// Map the pack and validate the header and table of contents.
+		/// </summary>
+		/// <returns>Whether we opened the pack without error.</returns>
+		virtual bool open();
+
+		/// <summary>
+		/// Fetch the size of a resource based on the name. If the resource is
+		/// not found, returns 0.
+		/// </summary>
+		/// <param name="resource">The resource we want the size of.</param>
+		/// <returns>The size, in bytes.</returns>
+		virtual size_t get_raw_resource_size(const Resource& resource);
+
+		/// <summary>
+		/// Fetch where the resource data is stored in the pack.
+		/// </summary>
+		/// <param name="resource">The resource we want the offset of.</param>
+		/// <returns>The offset of the resource, in bytes.</returns>
+		virtual size_t get_resource_offset(const Resource& resource);
+
+		/// <summary>
+		/// Read the resource from the pack. If the resource is not found,
+		/// returns 0.
+		/// </summary>
+		/// <param name="resource">The resource to read.</param>
+		/// <param name="buffer">The pre-allocated buffer to load into.</param>
+		/// <returns>The size of the loaded resource, in bytes.</returns>
+		virtual size_t load_resource(const Resource& resource, char* buffer);
+
+		/// <summary>
+		/// Copy part of a resource out of the pack. If the resource is not
+		/// found, returns 0.
+		/// </summary>
+		/// <param name="resource">The resource to read.</param>
+		/// <param name="offset">Where to start, from the start of the
+		/// resource.</param>
+		/// <param name="length">The most bytes to read.</param>
+		/// <param name="buffer">The buffer to load into.</param>
+		/// <returns>The number of bytes read.</returns>
+		virtual size_t load_range(const Resource& resource, size_t offset,
+			size_t length, char* buffer);
+
+		/// <summary>
+		/// Hand out a view of the resource within the mapped pack.
+		/// </summary>
+		/// <param name="resource">The resource to map.</param>
+		/// <returns>The mapping, with null data if the resource is not
+		/// found.</returns>
+		virtual ResourceMapping map_resource(const Resource& resource);
+
+		/// <summary>
+		/// The number of resources in the pack.
+		/// </summary>
+		/// <returns>The number of resources in the pack.</returns>
+		virtual const size_t get_resource_count();
+
+		/// <summary>
+		/// Fetches the name of the n'th resource in the pack.
+		/// </summary>
+		/// <param name="index">The index of the resource.</param>
+		/// <returns>The name of the resource at the supplied index.
+		/// Empty if index is not in bounds.
+		/// </returns>
+		virtual std::string get_resource_name(size_t index);
+
+		/// <summary>
+		/// Build a pack out of every file in a folder, recursively.
+		/// </summary>
+		/// <param name="folder_name">The folder to pack.</param>
+		/// <param name="pack_file_name">The pack file to write.</param>
+		/// <returns>Whether the pack was written successfully.</returns>
+		static bool build(const std::string& folder_name,
+			const std::string& pack_file_name) noexcept;
+	};
+
+	/// <summary>
+	/// Hash a resource name the same way resource packs do. This is part of
+	/// the pack format, so it must never change.
+	/// </summary>
+	/// <param name="name">The name to hash.</param>
+	/// <returns>The 64 bit FNV-1a hash of the name.</returns>
+	[[nodiscard]]
+	constexpr uint64_t resource_pack_hash(std::string_view name) noexcept
+	{
+		uint64_t hash = 0xcbf29ce484222325ull;
+		for (const char c : name)
+		{
+			hash ^= static_cast<unsigned char>(c);
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "resource/resource_handle.h"
+
+namespace loquat
+{
+	/// <summary>
+	/// One resource in a resource graph.
+	/// </summary>
+	struct ResourceGraphNode
+	{
+		/// <summary>
+		/// The name of the resource.
+		/// </summary>
+		std::string name;
+
+		/// <summary>
+		/// The loaded resource, empty if it couldn't be loaded.
+		/// </summary>
+		std::shared_ptr<ResourceHandle> handle;
+
+		/// <summary>
+		/// The nodes for the resources this one depends on, as indices into
+		/// the graph's nodes.
+		/// </summary>
+		std::vector<size_t> dependencies;
+	};
+
+	/// <summary>
+	/// A set of resources along with everything they depend on, directly or
+	/// not, all loaded. Holding on to the graph keeps every resource in it
+	/// in memory, even if the cache evicts it.
+	/// </summary>
+	struct ResourceGraph
+	{
+		/// <summary>
+		/// Every resource in the graph. The roots come first, in the order
+		/// they were given, and then their dependencies, breadth first. A
+		/// resource appears once no matter how many others depend on it.
+		/// </summary>
+		std::vector<ResourceGraphNode> nodes;
+
+		/// <summary>
+		/// Whether every resource in the graph was loaded.
+		/// </summary>
+		[[nodiscard]]
+		bool is_complete() const noexcept
+		{
+			for (const ResourceGraphNode& node : nodes)
+			{
+				if (!node.handle)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+	};
+}
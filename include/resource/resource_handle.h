@@ -1,7 +1,10 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "resource/resource.h"
 
@@ -15,7 +18,10 @@ namespace loquat
 	/// </summary>
 	class ResourceHandle
 	{
+		friend class ARCEvictionPolicy;
+		friend class GDSFEvictionPolicy;
 		friend class ResourceCache;
+		friend class ResourceLRUList;
 
 	protected:
 		/// <summary>
@@ -33,16 +39,95 @@ namespace loquat
 		/// </summary>
 		size_t size;
 
+		/// <summary>
+		/// The number of bytes charged against the cache for this handle,
+		/// which is given back when the handle is destroyed.
+		/// </summary>
+		size_t charged_size;
+
+		/// <summary>
+		/// The size the buffer was allocated with, which the cache's buffer
+		/// pool needs back when it is freed. May be more than the size of
+		/// the data.
+		/// </summary>
+		size_t buffer_size;
+
+		/// <summary>
+		/// If the buffer points into a memory mapped file rather than memory
+		/// the cache allocated, this keeps the mapping alive. If it belongs
+		/// to another handle with the same contents, this keeps that handle
+		/// alive. Empty otherwise.
+		/// </summary>
+		std::shared_ptr<void> mapping;
+
+		/// <summary>
+		/// Whether the buffer is, or can be, shared with the handles of other
+		/// resources that have the same contents, in which case it can't be
+		/// written.
+		/// </summary>
+		std::atomic<bool> shared_buffer{ false };
+
 		/// <summary>
 		/// The optional extra data.
 		/// </summary>
 		std::shared_ptr<ResourceExtraData> extra;
 
+		/// <summary>
+		/// The resources this one refers to, as its loader listed them.
+		/// </summary>
+		std::vector<std::string> dependencies;
+
 		/// <summary>
 		/// The resource cache that was used to load this resource.
 		/// </summary>
 		ResourceCache* resource_cache;
 
+		/// <summary>
+		/// The next more recently used handle in the cache's LRU list, null if
+		/// this is the front or the handle is not in a list.
+		/// </summary>
+		ResourceHandle* lru_previous = nullptr;
+
+		/// <summary>
+		/// The next less recently used handle in the cache's LRU list, null if
+		/// this is the back or the handle is not in a list.
+		/// </summary>
+		ResourceHandle* lru_next = nullptr;
+
+		/// <summary>
+		/// How expensive the resource is to load again, as reported by the
+		/// loader that loaded it.
+		/// </summary>
+		double reload_cost = 1.0;
+
+		/// <summary>
+		/// How many times the handle has been pinned. Pinned handles are never
+		/// evicted. Guarded by the cache shard's mutex.
+		/// </summary>
+		size_t pin_count = 0;
+
+		/// <summary>
+		/// How many times the handle has been used while in the cache, for
+		/// eviction policies that care about frequency.
+		/// </summary>
+		size_t access_count = 0;
+
+		/// <summary>
+		/// The eviction policy's priority for the handle, if it has one.
+		/// </summary>
+		double eviction_priority = 0.0;
+
+		/// <summary>
+		/// Where the eviction policy keeps the handle, if it needs to know.
+		/// </summary>
+		size_t eviction_index = 0;
+
+		/// <summary>
+		/// Which of the eviction policy's lists the handle is in, if it has
+		/// more than one.
+		/// </summary>
+		uint8_t eviction_queue = 0;
+
 	public:
 
 		/// <summary>
@@ -75,6 +160,14 @@ namespace loquat
 		[[nodiscard]]
 		size_t get_size() const noexcept;
 
+		/// <summary>
+		/// Return how expensive this resource is to load again, as reported
+		/// by its loader.
+		/// </summary>
+		/// <returns>The reload cost.</returns>
+		[[nodiscard]]
+		double get_reload_cost() const noexcept;
+
 		/// <summary>
 		/// Return a const reference to the data. If this type of resource does
 		/// not use the raw data, this will be a nullptr.
@@ -85,7 +178,9 @@ namespace loquat
 
 		/// <summary>
 		/// Return a writeable reference to the data. If this type of resource does
-		/// not use the raw data, this will be a nullptr.
+		/// not use the raw data, this will be a nullptr. It is also a nullptr if
+		/// the data is shared with other resources that have the same contents,
+		/// see ResourceCache::set_deduplication.
 		/// </summary>
 		/// <returns>The raw data for this resource.</returns>
 		[[nodiscard]]
@@ -99,6 +194,15 @@ namespace loquat
 		[[nodiscard]]
 		std::shared_ptr<ResourceExtraData> get_extra() const noexcept;
 
+		/// <summary>
+		/// Return the names of the resources this one refers to, which the
+		/// cache prefetches when this is loaded. Empty if its loader doesn't
+		/// list dependencies.
+		/// </summary>
+		/// <returns>The names of the dependencies.</returns>
+		[[nodiscard]]
+		const std::vector<std::string>& get_dependencies() const noexcept;
+
 		/// <summary>
 		/// Set the extra data. The pointer must not be itself null, but may point
 		/// to null.
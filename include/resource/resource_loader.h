@@ -2,10 +2,12 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace loquat
 {
 	class ResourceHandle;
+	class ResourceStream;
 
 	/// <summary>
 	/// Used to load resources from file. There may be several resource loaders,
@@ -28,6 +30,40 @@ namespace loquat
 		/// <returns>Whether the raw data is dicarded after loading.</returns>
 		virtual bool discard_raw_buffer_after_load() = 0;
 
+		/// <summary>
+		/// List the other resources a resource refers to, like the textures
+		/// a material uses, by reading as much of the raw data as it takes,
+		/// usually just a header. The cache starts loading them in the
+		/// background as soon as the resource is loaded, so they are ready
+		/// or on their way by the time anyone asks for them.
+		/// 
+		/// Called before load_resource, on the same raw data. By default a
+		/// resource has no dependencies. Streamed resources are never asked.
+		/// </summary>
+		/// <param name="raw_buffer">The raw data.</param>
+		/// <param name="raw_size">The size of the raw data.</param>
+		/// <param name="dependencies">The names of the resources this one
+		/// refers to are appended here.</param>
+		virtual void get_dependencies(const char* raw_buffer, size_t raw_size,
+			std::vector<std::string>& dependencies);
+
+		/// <summary>
+		/// Names the loader and the version of what it produces, for the
+		/// cache's on-disk derived data cache. Loaded resources are saved
+		/// there keyed by a hash of the raw data and this string, and later
+		/// runs map the saved copy instead of loading the resource again.
+		/// Change the string whenever the loader's output changes, so old
+		/// copies are ignored.
+		/// 
+		/// Only loaders that discard the raw buffer are cached, and only
+		/// the loaded bytes are saved, so a loader that sets extra data on
+		/// the handle must not opt in. By default this is empty, which
+		/// opts out.
+		/// </summary>
+		/// <returns>The loader's name and output version, or empty.
+		/// </returns>
+		virtual std::string get_derived_data_version();
+
 		/// <summary>
 		/// Returns the size of the loaded resource, which might be different from
 		/// the size stored in the file.
@@ -38,6 +74,20 @@ namespace loquat
 		virtual size_t get_loaded_resource_size(char* raw_buffer,
 			size_t raw_size) = 0;
 
+		/// <summary>
+		/// Estimate how expensive it would be to load a resource again if it
+		/// were evicted, roughly in microseconds. Cost aware eviction policies
+		/// keep expensive resources around for longer.
+		/// 
+		/// By default this is a fixed overhead for each load, plus the time
+		/// to read the raw data. Loaders that do real work should add to it.
+		/// </summary>
+		/// <param name="raw_size">The size of the raw data.</param>
+		/// <param name="loaded_size">The size of the loaded resource.</param>
+		/// <returns>The estimated cost of loading the resource again.
+		/// </returns>
+		virtual double get_reload_cost(size_t raw_size, size_t loaded_size);
+
 		/// <summary>
 		/// Return the wildcard pattern that defines which resources the loader
 		/// is used for. For example, "*.ogg" is any ogg file, and "*" is any file
@@ -47,6 +97,18 @@ namespace loquat
 		/// </returns>
 		virtual std::string get_pattern() = 0;
 
+		/// <summary>
+		/// For loaders that stream, returns the size of the loaded resource.
+		/// This may read as much of the stream as it needs, like a header,
+		/// and should leave it where load_stream expects to start.
+		/// 
+		/// By default the loaded resource is the same size as the raw one.
+		/// </summary>
+		/// <param name="stream">The stream, at the start of the resource.
+		/// </param>
+		/// <returns>The size of the loaded resource.</returns>
+		virtual size_t get_streamed_resource_size(ResourceStream& stream);
+
 		/// <summary>
 		/// Load a resource.
 		/// </summary>
@@ -57,11 +119,44 @@ namespace loquat
 		virtual bool load_resource(char* raw_buffer, size_t raw_size,
 			std::shared_ptr<ResourceHandle> handle) = 0;
 
+		/// <summary>
+		/// For loaders that stream, load a resource by reading only the parts
+		/// of it that are needed, without the raw data ever being resident
+		/// all at once.
+		/// 
+		/// By default the whole stream is read into the handle's buffer.
+		/// </summary>
+		/// <param name="stream">The stream, where get_streamed_resource_size
+		/// left it.</param>
+		/// <param name="handle">The handle that we want to load.</param>
+		/// <returns>Whether we loaded the resource successfully.</returns>
+		virtual bool load_stream(ResourceStream& stream,
+			std::shared_ptr<ResourceHandle> handle);
+
+		/// <summary>
+		/// For loaders that stream, whether to load from the raw data instead
+		/// when the file can map it, since then the raw data costs nothing
+		/// until it is touched. Only files that can't map the resource are
+		/// streamed.
+		/// 
+		/// By default streaming loaders always stream.
+		/// </summary>
+		/// <returns>Whether to prefer a mapping over a stream.</returns>
+		virtual bool prefer_mapped_raw();
+
 		/// <summary>
 		/// Whether we can use the bits stored in the raw file, without any
 		/// processing.
 		/// </summary>
 		/// <returns>Whether we can use the raw data without processing.</returns>
 		virtual bool use_raw_file() = 0;
+
+		/// <summary>
+		/// Whether we load from a stream rather than from the raw data. If so,
+		/// the cache never reads the raw data itself, and calls
+		/// get_streamed_resource_size and load_stream instead.
+		/// </summary>
+		/// <returns>Whether we load from a stream.</returns>
+		virtual bool use_stream();
 	};
 }
\ No newline at end of file
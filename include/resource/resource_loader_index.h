@@ -0,0 +1,119 @@
+#pragma once
+
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "resource/resource.h"
+#include "resource/resource_loader.h"
+
+namespace loquat
+{
+	/// <summary>
+	/// Picks which resource loader to use for a resource, with the same
+	/// result as checking every loader's pattern in order, most recently
+	/// registered first, but without doing that for every load.
+	///
+	/// Patterns are compiled once when a loader is added. Patterns that are
+	/// just a star followed by a literal suffix, like "*.ogg", go in a table
+	/// keyed by extension, and anything else is kept in a short list of true
+	/// globs. The choice for each recently loaded resource name is also
+	/// remembered, so loading the same name again is a single hash lookup.
+	/// </summary>
+	class ResourceLoaderIndex
+	{
+	public:
+		/// <summary>
+		/// The most resource names we remember a choice for, so scenes that
+		/// touch millions of names once each don't keep them all around.
+		/// </summary>
+		static constexpr size_t MAX_CHOSEN = 16384;
+
+	private:
+		/// <summary>
+		/// A loader along with its compiled pattern.
+		/// </summary>
+		struct CompiledPattern
+		{
+			/// <summary>
+			/// The loader to use if the pattern matches.
+			/// </summary>
+			std::shared_ptr<ResourceLoader> loader;
+
+			/// <summary>
+			/// The original pattern, for globs.
+			/// </summary>
+			std::string pattern;
+
+			/// <summary>
+			/// For suffix patterns, everything after the star. Names have to
+			/// end with this to match.
+			/// </summary>
+			std::string suffix;
+
+			/// <summary>
+			/// Loaders registered later have higher priority.
+			/// </summary>
+			size_t priority;
+		};
+
+		/// <summary>
+		/// Suffix patterns, keyed by the extension at the end of the suffix,
+		/// each sorted from highest to lowest priority.
+		/// </summary>
+		std::unordered_map<std::string, std::vector<CompiledPattern>,
+			ResourceNameHash, std::equal_to<>> by_extension;
+
+		/// <summary>
+		/// Every pattern that is not a suffix pattern, sorted from highest to
+		/// lowest priority.
+		/// </summary>
+		std::vector<CompiledPattern> globs;
+
+		/// <summary>
+		/// The loader we picked for each resource name, forgotten all at once
+		/// whenever it reaches MAX_CHOSEN names.
+		/// </summary>
+		std::unordered_map<std::string, std::shared_ptr<ResourceLoader>,
+			ResourceNameHash, std::equal_to<>> chosen;
+
+		/// <summary>
+		/// The priority of the next loader to be added.
+		/// </summary>
+		size_t next_priority = 0;
+
+		/// <summary>
+		/// Guards everything above. Lookups only need shared access unless
+		/// they have to remember a new choice.
+		/// </summary>
+		mutable std::shared_mutex index_mutex;
+
+		/// <summary>
+		/// Find the matching loader with the highest priority, without
+		/// checking the remembered choices. The index mutex must be held.
+		/// </summary>
+		/// <param name="name">The resource name.</param>
+		/// <returns>The loader, or empty if nothing matches.</returns>
+		[[nodiscard]]
+		std::shared_ptr<ResourceLoader> match(const std::string& name) const
+			noexcept;
+
+	public:
+		/// <summary>
+		/// Add a loader, which takes priority over every loader added before
+		/// it. This forgets every remembered choice.
+		/// </summary>
+		/// <param name="loader">The loader to add.</param>
+		void add(std::shared_ptr<ResourceLoader> loader) noexcept;
+
+		/// <summary>
+		/// Find the loader to use for a resource.
+		/// </summary>
+		/// <param name="name">The resource name.</param>
+		/// <returns>The loader, or empty if nothing matches.</returns>
+		[[nodiscard]]
+		std::shared_ptr<ResourceLoader> find(const std::string& name) noexcept;
+	};
+}
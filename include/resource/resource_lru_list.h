@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+
+namespace loquat
+{
+	class ResourceHandle;
+
+	/// <summary>
+	/// An intrusive, doubly linked list of resource handles, ordered from most
+	/// recently used at the front to least recently used at the back.
+	///
+	/// The links are stored in the handles themselves, so inserting, touching
+	/// and removing a handle are all constant time and never allocate. A
+	/// handle may only be in one list at a time. The list does not own the
+	/// handles, the cache keeps them alive through its name index.
+	/// </summary>
+	class ResourceLRUList
+	{
+		/// <summary>
+		/// The most recently used handle, or null if the list is empty.
+		/// </summary>
+		ResourceHandle* head = nullptr;
+
+		/// <summary>
+		/// The least recently used handle, or null if the list is empty.
+		/// </summary>
+		ResourceHandle* tail = nullptr;
+
+		/// <summary>
+		/// The number of handles in the list.
+		/// </summary>
+		size_t count = 0;
+
+	public:
+		ResourceLRUList() noexcept = default;
+		ResourceLRUList(const ResourceLRUList&) = delete;
+		ResourceLRUList& operator=(const ResourceLRUList&) = delete;
+
+		/// <summary>
+		/// Insert a handle at the front of the list, as the most recently used
+		/// handle. The handle must not already be in a list.
+		/// </summary>
+		/// <param name="handle">The handle to insert.</param>
+		void push_front(ResourceHandle* handle) noexcept;
+
+		/// <summary>
+		/// Unlink a handle from the list. Does nothing if the handle is not in
+		/// the list.
+		/// </summary>
+		/// <param name="handle">The handle to remove.</param>
+		void remove(ResourceHandle* handle) noexcept;
+
+		/// <summary>
+		/// Move a handle that is already in the list to the front, marking it
+		/// as the most recently used.
+		/// </summary>
+		/// <param name="handle">The handle that was just used.</param>
+		void move_to_front(ResourceHandle* handle) noexcept;
+
+		/// <summary>
+		/// Check whether a handle is currently linked into this list.
+		/// </summary>
+		/// <param name="handle">The handle to check.</param>
+		/// <returns>Whether the handle is in the list.</returns>
+		[[nodiscard]]
+		bool contains(const ResourceHandle* handle) const noexcept;
+
+		/// <summary>
+		/// The most recently used handle.
+		/// </summary>
+		/// <returns>The front of the list, or null if it is empty.</returns>
+		[[nodiscard]]
+		ResourceHandle* front() const noexcept;
+
+		/// <summary>
+		/// The least recently used handle.
+		/// </summary>
+		/// <returns>The back of the list, or null if it is empty.</returns>
+		[[nodiscard]]
+		ResourceHandle* back() const noexcept;
+
+		/// <summary>
+		/// Whether there are no handles in the list.
+		/// </summary>
+		/// <returns>If the list is empty.</returns>
+		[[nodiscard]]
+		bool empty() const noexcept;
+
+		/// <summary>
+		/// The number of handles in the list.
+		/// </summary>
+		/// <returns>How many handles are linked into the list.</returns>
+		[[nodiscard]]
+		size_t size() const noexcept;
+	};
+}
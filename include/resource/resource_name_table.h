@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "resource/glob_pattern.h"
+
+namespace loquat
+{
+	class ResourceFile;
+	class ResourceNameTable;
+
+	/// <summary>
+	/// The names that matched a pattern. The names are views into the table
+	/// they were found in, which is kept alive for as long as this is.
+	/// </summary>
+	struct ResourceNameMatches
+	{
+		/// <summary>
+		/// The table the names point into.
+		/// </summary>
+		std::shared_ptr<const ResourceNameTable> table;
+
+		/// <summary>
+		/// The matching names, in the order the file lists them.
+		/// </summary>
+		std::vector<std::string_view> names;
+	};
+
+	/// <summary>
+	/// Every resource name in a file, laid out for matching patterns against
+	/// all of them quickly. Names are stored back to back in one block, once
+	/// as they are and once lowercased.
+	///
+	/// The first and last eight characters of each lowercased name are also
+	/// kept as words in arrays of their own. A pattern's literal prefix and
+	/// suffix are checked against those a block of names at a time, with
+	/// plain word compares the compiler can vectorize, and only the names
+	/// that pass are matched in full.
+	///
+	/// A table never changes once it is built, so it can be shared between
+	/// threads freely.
+	/// </summary>
+	class ResourceNameTable
+	{
+		/// <summary>
+		/// Every name, back to back.
+		/// </summary>
+		std::string names;
+
+		/// <summary>
+		/// Every name lowercased, at the same offsets.
+		/// </summary>
+		std::string lowered;
+
+		/// <summary>
+		/// Where each name starts, with one more entry for the end of the
+		/// last name.
+		/// </summary>
+		std::vector<uint32_t> offsets;
+
+		/// <summary>
+		/// The first eight characters of each lowercased name, padded with
+		/// zeros, as a little endian word.
+		/// </summary>
+		std::vector<uint64_t> heads;
+
+		/// <summary>
+		/// The last eight characters of each lowercased name, padded with
+		/// zeros at the front.
+		/// </summary>
+		std::vector<uint64_t> tails;
+
+		/// <summary>
+		/// Collect the names whose lowercased heads and tails could match a
+		/// pattern, then match those in full.
+		/// </summary>
+		/// <param name="pattern">The compiled pattern.</param>
+		/// <param name="lowered_prefix">The pattern's literal prefix,
+		/// lowercased.</param>
+		/// <param name="lowered_suffix">The pattern's literal suffix,
+		/// lowercased.</param>
+		/// <param name="ignore_case">Whether to match the lowercased names
+		/// instead of the names as they are.</param>
+		/// <param name="matches">Filled in with the indices of the matching
+		/// names.</param>
+		void filter(const GlobPattern& pattern,
+			std::string_view lowered_prefix, std::string_view lowered_suffix,
+			bool ignore_case, std::vector<uint32_t>& matches) const noexcept;
+
+	public:
+		/// <summary>
+		/// Read every name from a file.
+		/// </summary>
+		/// <param name="file">The file to list.</param>
+		explicit ResourceNameTable(ResourceFile& file) noexcept;
+
+		/// <summary>
+		/// The number of names.
+		/// </summary>
+		[[nodiscard]]
+		size_t size() const noexcept;
+
+		/// <summary>
+		/// A name as the file lists it.
+		/// </summary>
+		/// <param name="index">The index of the name.</param>
+		[[nodiscard]]
+		std::string_view get_name(const size_t index) const noexcept;
+
+		/// <summary>
+		/// A name, lowercased.
+		/// </summary>
+		/// <param name="index">The index of the name.</param>
+		[[nodiscard]]
+		std::string_view get_lowered_name(const size_t index) const noexcept;
+
+		/// <summary>
+		/// Find the names that match a pattern.
+		/// </summary>
+		/// <param name="pattern">The compiled pattern.</param>
+		/// <param name="ignore_case">Whether to match the lowercased names,
+		/// in which case the pattern should be lowercase too.</param>
+		/// <returns>The indices of the matching names, in order.</returns>
+		[[nodiscard]]
+		std::vector<uint32_t> match(const GlobPattern& pattern,
+			const bool ignore_case) const noexcept;
+	};
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+#include "resource/resource.h"
+
+namespace loquat
+{
+	class ResourceFile;
+
+	/// <summary>
+	/// Handed each chunk of a resource in turn, with the chunk data and its
+	/// size. Returning false stops reading.
+	/// </summary>
+	using ResourceChunkCallback = std::function<bool(const char*, size_t)>;
+
+	/// <summary>
+	/// Reads a resource a piece at a time, so large resources don't have to
+	/// be resident all at once. Reads can either move through the resource
+	/// in order, or jump straight to the parts that are needed, like one
+	/// tile of a grid or one level of a mip chain.
+	///
+	/// A stream is meant to be used by one thread at a time. A loader can
+	/// keep its stream in the handle's extra data to fetch more of the
+	/// resource later.
+	/// </summary>
+	class ResourceStream
+	{
+	protected:
+		/// <summary>
+		/// The file the resource is in.
+		/// </summary>
+		ResourceFile* file;
+
+		/// <summary>
+		/// The resource being read.
+		/// </summary>
+		Resource resource;
+
+		/// <summary>
+		/// The size of the resource, in bytes.
+		/// </summary>
+		size_t size;
+
+		/// <summary>
+		/// Where the next sequential read starts.
+		/// </summary>
+		size_t position = 0;
+
+		/// <summary>
+		/// Read part of the resource. By default this goes through
+		/// ResourceFile::load_range, but files can keep more state around to
+		/// make repeated reads cheaper.
+		/// </summary>
+		/// <param name="offset">Where to start, from the start of the
+		/// resource.</param>
+		/// <param name="length">How many bytes to read.</param>
+		/// <param name="buffer">Where to put them.</param>
+		/// <returns>The number of bytes read.</returns>
+		virtual size_t read_range(size_t offset, size_t length, char* buffer)
+			noexcept;
+
+	public:
+		/// <summary>
+		/// Create a stream over a resource. Should not be called directly,
+		/// use ResourceFile::open_stream.
+		/// </summary>
+		/// <param name="file">The file the resource is in.</param>
+		/// <param name="resource">The resource to read.</param>
+		/// <param name="size">The size of the resource, in bytes.</param>
+		ResourceStream(ResourceFile* file, const Resource& resource,
+			size_t size) noexcept;
+
+		/// <summary>
+		/// Clean up.
+		/// </summary>
+		virtual ~ResourceStream();
+
+		/// <summary>
+		/// Return the name of the resource being read.
+		/// </summary>
+		/// <returns>The name of the resource.</returns>
+		[[nodiscard]]
+		const std::string& get_name() const noexcept;
+
+		/// <summary>
+		/// Return the size of the whole resource.
+		/// </summary>
+		/// <returns>The size, in bytes.</returns>
+		[[nodiscard]]
+		size_t get_size() const noexcept;
+
+		/// <summary>
+		/// Return where the next sequential read starts.
+		/// </summary>
+		/// <returns>The offset from the start of the resource.</returns>
+		[[nodiscard]]
+		size_t tell() const noexcept;
+
+		/// <summary>
+		/// Whether every byte has been read sequentially.
+		/// </summary>
+		/// <returns>Whether we are at the end of the resource.</returns>
+		[[nodiscard]]
+		bool at_end() const noexcept;
+
+		/// <summary>
+		/// Move where the next sequential read starts.
+		/// </summary>
+		/// <param name="offset">The new offset, from the start of the
+		/// resource.</param>
+		/// <returns>Whether the offset was inside the resource.</returns>
+		bool seek(size_t offset) noexcept;
+
+		/// <summary>
+		/// Read the next part of the resource, and move past it.
+		/// </summary>
+		/// <param name="buffer">Where to put the data.</param>
+		/// <param name="length">The most bytes to read.</param>
+		/// <returns>The number of bytes read, which is only less than asked
+		/// for at the end of the resource or if reading failed.</returns>
+		size_t read(char* buffer, size_t length) noexcept;
+
+		/// <summary>
+		/// Read part of the resource, without moving where the next
+		/// sequential read starts.
+		/// </summary>
+		/// <param name="offset">Where to start, from the start of the
+		/// resource.</param>
+		/// <param name="length">The most bytes to read.</param>
+		/// <param name="buffer">Where to put the data.</param>
+		/// <returns>The number of bytes read.</returns>
+		size_t read_at(size_t offset, size_t length, char* buffer) noexcept;
+
+		/// <summary>
+		/// Read the rest of the resource in chunks, handing each one to a
+		/// callback. Only one chunk is ever held in memory.
+		/// </summary>
+		/// <param name="chunk_size">The most bytes in each chunk.</param>
+		/// <param name="callback">Called with each chunk, in order.</param>
+		/// <returns>Whether every chunk was read and accepted.</returns>
+		bool for_each_chunk(size_t chunk_size,
+			const ResourceChunkCallback& callback) noexcept;
+	};
+}
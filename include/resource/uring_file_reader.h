@@ -0,0 +1,197 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "resource/batch_file_reader.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace loquat
+{
+	/// <summary>
+	/// Reads a batch of files with io_uring, on Linux. The opens, reads and
+	/// closes for the whole batch go through one submission queue, so a
+	/// single thread keeps the device's queue full without blocking on any
+	/// one file. Each thread reading a batch drives a ring of its own.
+	///
+	/// Talks to the kernel directly rather than through liburing, since we
+	/// only need three operations.
+	/// </summary>
+	class UringFileReader : public BatchFileReader
+	{
+		/// <summary>
+		/// One io_uring instance, which only one thread drives at a time.
+		/// </summary>
+		struct Ring
+		{
+			/// <summary>
+			/// The ring's file descriptor.
+			/// </summary>
+			int ring = -1;
+
+			/// <summary>
+			/// The number of entries in the submission queue.
+			/// </summary>
+			uint32_t queue_depth = 0;
+
+			/// <summary>
+			/// The number of entries in the completion queue.
+			/// </summary>
+			uint32_t completion_depth = 0;
+
+			/// <summary>
+			/// The shared submission queue ring, and its size.
+			/// </summary>
+			void* submission_ring = nullptr;
+			size_t submission_ring_size = 0;
+
+			/// <summary>
+			/// The shared completion queue ring, and its size. Kernels with
+			/// a single mapping for both rings leave this the same as the
+			/// submission ring.
+			/// </summary>
+			void* completion_ring = nullptr;
+			size_t completion_ring_size = 0;
+
+			/// <summary>
+			/// The submission queue entries, and the size of their mapping.
+			/// </summary>
+			io_uring_sqe* submission_entries = nullptr;
+			size_t submission_entries_size = 0;
+
+			/// <summary>
+			/// Pointers into the submission ring.
+			/// </summary>
+			uint32_t* submission_head = nullptr;
+			uint32_t* submission_tail = nullptr;
+			uint32_t* submission_mask = nullptr;
+			uint32_t* submission_array = nullptr;
+
+			/// <summary>
+			/// Pointers into the completion ring.
+			/// </summary>
+			uint32_t* completion_head = nullptr;
+			uint32_t* completion_tail = nullptr;
+			uint32_t* completion_mask = nullptr;
+			io_uring_cqe* completions = nullptr;
+
+			/// <summary>
+			/// Unmap the queues and close the ring. Anything still in flight
+			/// is cancelled by the kernel.
+			/// </summary>
+			~Ring();
+
+			/// <summary>
+			/// Create the ring and map its queues.
+			/// </summary>
+			/// <param name="depth">The number of submission queue entries.
+			/// </param>
+			/// <returns>Whether the kernel gave us a usable ring.</returns>
+			[[nodiscard]]
+			bool setup(uint32_t depth) noexcept;
+
+			/// <summary>
+			/// Ask the kernel whether it supports every operation we use.
+			/// </summary>
+			/// <returns>Whether opens, reads and closes are supported.
+			/// </returns>
+			[[nodiscard]]
+			bool supports_operations() noexcept;
+
+			/// <summary>
+			/// Copy an entry into the submission queue, for the next call
+			/// into the kernel to pick up.
+			/// </summary>
+			/// <param name="entry">The entry to queue.</param>
+			/// <returns>Whether there was room in the queue.</returns>
+			[[nodiscard]]
+			bool queue_submission(const io_uring_sqe& entry) noexcept;
+
+			/// <summary>
+			/// Take back every entry queued since the last call into the
+			/// kernel, which it has not seen.
+			/// </summary>
+			/// <returns>The number of entries taken back.</returns>
+			[[nodiscard]]
+			uint32_t unqueue_submissions() noexcept;
+		};
+
+		/// <summary>
+		/// The number of submission queue entries each ring is created with.
+		/// </summary>
+		uint32_t queue_depth = 0;
+
+		/// <summary>
+		/// Rings no thread is using. A thread takes one for each batch and
+		/// puts it back afterwards, so every thread reading at the same time
+		/// has a ring of its own instead of waiting for another's batch.
+		/// </summary>
+		std::vector<Ring*> idle_rings;
+
+		/// <summary>
+		/// The number of rings created, idle or not.
+		/// </summary>
+		size_t ring_count = 0;
+
+		/// <summary>
+		/// Guards the idle rings and the ring count.
+		/// </summary>
+		std::mutex ring_mutex;
+
+		/// <summary>
+		/// Signalled when a ring is put back, for threads that could not
+		/// create a ring of their own.
+		/// </summary>
+		std::condition_variable ring_returned;
+
+		/// <summary>
+		/// Take an idle ring, or create one if there are none.
+		/// </summary>
+		/// <returns>A ring only the calling thread is using.</returns>
+		[[nodiscard]]
+		Ring* take_ring() noexcept;
+
+		/// <summary>
+		/// Put a ring back for another batch to use.
+		/// </summary>
+		/// <param name="ring">The ring, which has nothing in flight.</param>
+		void return_ring(Ring* ring) noexcept;
+
+		/// <summary>
+		/// Drop a ring that can't be used any more.
+		/// </summary>
+		/// <param name="ring">The ring.</param>
+		void discard_ring(Ring* ring) noexcept;
+
+	public:
+		/// <summary>
+		/// Create a reader with no ring. Use create instead, which checks
+		/// that io_uring is usable.
+		/// </summary>
+		UringFileReader() noexcept = default;
+
+		/// <summary>
+		/// Create a reader, if the kernel supports io_uring.
+		/// </summary>
+		/// <param name="queue_depth">The most operations in flight at once.
+		/// </param>
+		/// <returns>The reader allocated with alloc, or null if io_uring is
+		/// not available.</returns>
+		[[nodiscard]]
+		static UringFileReader* create(size_t queue_depth) noexcept;
+
+		/// <summary>
+		/// Close every ring.
+		/// </summary>
+		virtual ~UringFileReader();
+
+		virtual void read(std::vector<FileRead>& reads) noexcept;
+
+		[[nodiscard]]
+		virtual const char* get_name() const noexcept;
+	};
+}
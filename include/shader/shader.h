@@ -10,8 +10,12 @@
 
 namespace loquat
 {
+	class ResourceHandle;
+
 	/// <summary>
 	/// A single shader module, representing one file.
+	/// 
+	/// The module is rebuilt whenever the resource cache reloads the file.
 	/// </summary>
 	struct ShaderModule
 	{
@@ -22,7 +26,20 @@ namespace loquat
 		ShaderModule& operator=(ShaderModule&&) = delete;
 		~ShaderModule();
 
+		/// <summary>
+		/// Create the Vulkan module from compiled shader code, replacing the
+		/// existing one. Pipelines that were already created from the old
+		/// module are not affected.
+		/// </summary>
+		/// <param name="handle">The compiled shader code.</param>
+		/// <returns>Whether the module was created.</returns>
+		bool create(const std::shared_ptr<ResourceHandle>& handle) noexcept;
+
+		const std::string name;
 		VkShaderModule shader_module = nullptr;
+
+	private:
+		size_t subscription = 0;
 	};
 
 	/// <summary>
@@ -76,6 +93,12 @@ namespace loquat
 		Shader(Shader&&) = delete;
 		Shader& operator=(Shader&&) = delete;
 
+		/// <summary>
+		/// Point the stage create info at the current modules, after any of
+		/// them have been rebuilt.
+		/// </summary>
+		void refresh_modules() noexcept;
+
 		std::vector<std::shared_ptr<ShaderModule>> modules;
 		std::vector<VkPipelineShaderStageCreateInfo> create_info_list;
 	};
@@ -10,6 +10,8 @@
 #endif
 #include <iostream>
 
+#include "main/memory_tracking.h"
+
 static const char* ERROR_LOG_FILENAME = "log.txt";
 
 #ifdef _DEBUG
@@ -220,7 +222,10 @@ void LogManager::set_display_flags(std::string_view tag, unsigned char flags)
 	Tags::iterator result = tags.find(tag);
 	if (flags == FLAG_WRITE_NOWHERE)
 	{
-		tags.erase(result);
+		if (result != tags.end())
+		{
+			tags.erase(result);
+		}
 	}
 	else
 	{
@@ -390,7 +395,8 @@ namespace Logger
 	{
 		if (!log_manager)
 		{
-			log_manager = loquat::alloc<LogManager>();
+			log_manager = loquat::get_tagged_allocator(
+				loquat::MemoryTag::Logger).new_object<LogManager>();
 		}
 	}
 
@@ -398,7 +404,8 @@ namespace Logger
 	{
 		if (log_manager)
 		{
-			loquat::safe_delete(log_manager);
+			loquat::get_tagged_allocator(loquat::MemoryTag::Logger)
+				.delete_object(log_manager);
 			log_manager = nullptr;
 		}
 	}
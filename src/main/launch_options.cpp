@@ -0,0 +1,148 @@
+#include "main/launch_options.h"
+
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+#include "debug/logger.h"
+
+namespace loquat
+{
+	namespace
+	{
+		/// <summary>
+		/// Take the value that follows an option.
+		/// </summary>
+		/// <returns>The value, null if the option was last.</returns>
+		[[nodiscard]]
+		const char* take_value(int argc, char* argv[], int& i) noexcept
+		{
+			if (i + 1 >= argc)
+			{
+				LOG_WARNING(std::string(argv[i]) + " needs a value");
+				return nullptr;
+			}
+			return argv[++i];
+		}
+
+		/// <summary>
+		/// Take the size in megabytes that follows an option.
+		/// </summary>
+		/// <param name="megabytes">Set to the size if there is a valid one.
+		/// </param>
+		/// <returns>Whether a size above zero followed the option.</returns>
+		[[nodiscard]]
+		bool take_megabytes(int argc, char* argv[], int& i, size_t& megabytes)
+			noexcept
+		{
+			const char* option = argv[i];
+			const char* value = take_value(argc, argv, i);
+			char* end = nullptr;
+			const unsigned long long size = value != nullptr
+				&& *value >= '0' && *value <= '9'
+				? std::strtoull(value, &end, 10) : 0;
+			if (size == 0 || *end != '\0')
+			{
+				LOG_WARNING(std::string(option)
+					+ " needs a size in megabytes");
+				return false;
+			}
+			megabytes = static_cast<size_t>(size);
+			return true;
+		}
+
+		/// <summary>
+		/// Read an environment variable.
+		/// </summary>
+		/// <returns>The value, empty if it isn't set.</returns>
+		[[nodiscard]]
+		std::string get_environment(const char* name) noexcept
+		{
+			const char* value = std::getenv(name);
+			return value != nullptr ? std::string(value) : std::string();
+		}
+	}
+
+	[[nodiscard]]
+	std::string get_default_derived_data_directory() noexcept
+	{
+		std::filesystem::path cache_directory;
+#if defined(_LOQUAT_WIN32)
+		cache_directory = get_environment("LOCALAPPDATA");
+#else
+		cache_directory = get_environment("XDG_CACHE_HOME");
+		if (cache_directory.empty())
+		{
+			const std::string home = get_environment("HOME");
+			if (!home.empty())
+			{
+				cache_directory = std::filesystem::path(home) / ".cache";
+			}
+		}
+#endif
+		if (cache_directory.empty())
+		{
+			return std::string();
+		}
+		return (cache_directory / "loquat" / "derived").string();
+	}
+
+	[[nodiscard]]
+	bool parse_launch_options(int argc, char* argv[], LaunchOptions& options)
+		noexcept
+	{
+		bool understood = true;
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string_view argument = argv[i];
+			if (argument == "--watch")
+			{
+				options.watch_resources = true;
+			}
+			else if (argument == "--cache-stats")
+			{
+				const char* path = take_value(argc, argv, i);
+				understood &= path != nullptr;
+				if (path != nullptr)
+				{
+					options.cache_stats_path = path;
+				}
+			}
+			else if (argument == "--dedupe")
+			{
+				options.deduplicate_resources = true;
+			}
+			else if (argument == "--derived-cache")
+			{
+				options.use_derived_data = true;
+			}
+			else if (argument == "--derived-cache-dir")
+			{
+				const char* directory = take_value(argc, argv, i);
+				understood &= directory != nullptr;
+				if (directory != nullptr)
+				{
+					options.use_derived_data = true;
+					options.derived_data_directory = directory;
+				}
+			}
+			else if (argument == "--derived-cache-size")
+			{
+				understood &= take_megabytes(argc, argv, i,
+					options.derived_data_size_in_MB);
+			}
+			else if (argument == "--hard-limit")
+			{
+				understood &= take_megabytes(argc, argv, i,
+					options.resource_hard_limit_in_MB);
+			}
+			else
+			{
+				LOG_WARNING("Unknown option " + std::string(argument));
+				understood = false;
+			}
+		}
+		return understood;
+	}
+}
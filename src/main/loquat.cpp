@@ -1,32 +1,40 @@
 #include <filesystem>
+#include <thread>
 
 #define GLFW_INCLUDE_VULKAN
 #include "GLFW/glfw3.h"
 
 #include "debug/logger.h"
+#include "main/launch_options.h"
 #include "main/loquat.h"
+#include "main/memory_tracking.h"
 #include "main/vulkan_instance.h"
 #include "render/render.h"
-#include "resource/resource_file_folder.h"
+#include "resource/resource_file_mapped.h"
+#include "resource/resource_file_pack.h"
 #include "window/swap_chain.h"
 #include "window/window.h"
 
 namespace loquat
 {
-	Allocator* g_allocator = new Allocator();
+	Allocator* g_allocator = new Allocator(
+		&get_memory_resource(MemoryTag::General));
 	GlobalState* g_global_state = alloc<GlobalState>();
 	ResourceCache* g_resource_cache;
 
 	/// <summary>
 	/// The main method, called from any entrypoint.
 	/// </summary>
+	/// <param name="argc">The number of command line arguments.</param>
+	/// <param name="argv">The command line arguments.</param>
 	/// <returns></returns>
-	int main();
+	int main(int argc, char* argv[]);
 
 	/// <summary>
 	/// Setup the program and rendering information.
 	/// </summary>
-	void initialize() noexcept;
+	/// <param name="options">The options from the command line.</param>
+	void initialize(const LaunchOptions& options) noexcept;
 
 	/// <summary>
 	/// Load a scene from file.
@@ -51,14 +59,22 @@ namespace loquat
 
 int main(int argc, char* argv[])
 {
-	return loquat::main();
+	return loquat::main(argc, argv);
 }
 
 namespace loquat
 {
-	int main()
+	int main(int argc, char* argv[])
 	{
-		initialize();
+		Logger::init();
+		Logger::set_display_flags("Debug", FLAG_WRITE_TO_DEBUGGER);
+
+		LaunchOptions options;
+		if (!parse_launch_options(argc, argv, options))
+		{
+			LOG_WARNING("Some options were not understood and are ignored.");
+		}
+		initialize(options);
 
 		//TODO(ches) we probably want to have a dropdown or something to pick
 		load_scene();
@@ -67,6 +83,13 @@ namespace loquat
 		while (!g_global_state->should_close())
 		{
 			glfwPollEvents();
+
+			g_resource_cache->reload_changed();
+			if (g_global_state->pipeline->outdated)
+			{
+				recreate_pipeline();
+			}
+
 			//TODO(ches) we probably want to have a button to render
 			render_scene();
 		}
@@ -75,29 +98,69 @@ namespace loquat
 		return 0;
 	}
 
-	void initialize() noexcept
+	void initialize(const LaunchOptions& options) noexcept
 	{
-		Logger::init();
-		Logger::set_display_flags("Debug", FLAG_WRITE_TO_DEBUGGER);
-
 		glfwInit();
 		if (!glfwVulkanSupported())
 		{
 			LOG_FATAL("Vulkan is not supported on this system!");
 		}
 
-		std::filesystem::path resource_path{
-			std::filesystem::current_path().append("resources") };
-		std::filesystem::path full_resource_path =
-			std::filesystem::canonical(resource_path);
-		ResourceFileFolder* resource_folder =
-			alloc<ResourceFileFolder>(full_resource_path.string());
-		g_resource_cache = alloc<ResourceCache>(50, resource_folder);
+		//NOTE(ches) a pack is preferred when one has been built, since it
+		// avoids walking the resource folder entirely
+		ResourceFile* resource_file;
+		std::filesystem::path pack_path{
+			std::filesystem::current_path().append("resources.pack") };
+		if (std::filesystem::is_regular_file(pack_path))
+		{
+			resource_file = alloc<ResourceFilePack>(pack_path.string());
+		}
+		else
+		{
+			std::filesystem::path resource_path{
+				std::filesystem::current_path().append("resources") };
+			std::filesystem::path full_resource_path =
+				std::filesystem::canonical(resource_path);
+			resource_file =
+				alloc<ResourceFileMapped>(full_resource_path.string());
+		}
+		g_resource_cache = alloc<ResourceCache>(50, resource_file,
+			std::thread::hardware_concurrency(),
+			ResourceEvictionPolicyType::GDSF);
 
 		if (!g_resource_cache->init())
 		{
 			LOG_FATAL("Failed to initialize the resource cache. Is there enough memory?");
 		}
+		//NOTE(ches) watched resources are copied rather than mapped, so
+		// only watch when asked to
+		if (options.watch_resources)
+		{
+			g_resource_cache->watch_for_changes();
+		}
+		if (!options.cache_stats_path.empty())
+		{
+			g_resource_cache->dump_stats_on_exit(options.cache_stats_path);
+		}
+		if (options.use_derived_data)
+		{
+			const std::string directory =
+				options.derived_data_directory.empty()
+				? get_default_derived_data_directory()
+				: options.derived_data_directory;
+			if (directory.empty() || !g_resource_cache->use_derived_data_cache(
+				directory, options.derived_data_size_in_MB))
+			{
+				LOG_WARNING("Could not keep loader output in \"" + directory
+					+ "\", it will be loaded from scratch.");
+			}
+		}
+		g_resource_cache->set_deduplication(options.deduplicate_resources);
+		if (options.resource_hard_limit_in_MB > 0)
+		{
+			g_resource_cache->set_hard_limit(
+				options.resource_hard_limit_in_MB);
+		}
 
 		create_vulkan_instance();
 		create_vulkan_window();
@@ -131,7 +194,12 @@ namespace loquat
 		vkDeviceWaitIdle(g_global_state->device->logical_device);
 		render::teardown_UI();
 
+		//NOTE(ches) the pipeline and shaders unsubscribe from the cache as
+		// they are destroyed, so the cache has to go last. It writes its
+		// stats out as it is destroyed, if it was asked to.
 		safe_delete(g_global_state);
+		safe_delete(g_resource_cache);
+		g_resource_cache = nullptr;
 		glfwTerminate();
 		Logger::destroy();
 	}
@@ -0,0 +1,132 @@
+#include "main/memory_tracking.h"
+
+#include <array>
+#include <cstdio>
+
+#include "main/object_pool_resource.h"
+
+namespace loquat
+{
+	namespace
+	{
+		constexpr size_t TAG_COUNT = static_cast<size_t>(MemoryTag::Count);
+
+		constexpr std::array<const char*, TAG_COUNT> TAG_NAMES = {
+			"general",
+			"geometry",
+			"bvh",
+			"textures",
+			"film",
+			"resource cache",
+			"logger",
+		};
+
+		[[nodiscard]]
+		MemoryUsage usage_of(const TrackedMemoryResource& resource) noexcept
+		{
+			return MemoryUsage{ resource.get_name(),
+				resource.CurrentAllocatedBytes(),
+				resource.MaxAllocatedBytes(),
+				resource.get_allocation_count() };
+		}
+	}
+
+	[[nodiscard]]
+	const char* get_memory_tag_name(const MemoryTag tag) noexcept
+	{
+		return TAG_NAMES[static_cast<size_t>(tag)];
+	}
+
+	[[nodiscard]]
+	TrackedMemoryResource& get_root_memory_resource() noexcept
+	{
+		//NOTE(ches) never freed, since memory is given back through it
+		// right up until the program exits, after statics are destroyed
+		static TrackedMemoryResource* root =
+			new TrackedMemoryResource(std::pmr::new_delete_resource());
+		return *root;
+	}
+
+	[[nodiscard]]
+	TrackedMemoryResource& get_memory_resource(const MemoryTag tag) noexcept
+	{
+		static const std::array<TrackedMemoryResource*, TAG_COUNT> resources =
+			[]()
+			{
+				std::array<TrackedMemoryResource*, TAG_COUNT> created;
+				for (size_t i = 0; i < TAG_COUNT; ++i)
+				{
+					created[i] = new TrackedMemoryResource(TAG_NAMES[i],
+						&get_root_memory_resource());
+				}
+				return created;
+			}();
+		return *resources[static_cast<size_t>(tag)];
+	}
+
+	[[nodiscard]]
+	Allocator get_tagged_allocator(const MemoryTag tag) noexcept
+	{
+		return Allocator(&get_memory_resource(tag));
+	}
+
+	[[nodiscard]]
+	Allocator get_pooled_allocator(const MemoryTag tag) noexcept
+	{
+		//NOTE(ches) never freed, like the tagged resources they sit on,
+		// since scene objects can be freed right up until the program exits
+		static const std::array<ObjectPoolResource*, TAG_COUNT> pools =
+			[]()
+			{
+				std::array<ObjectPoolResource*, TAG_COUNT> created;
+				for (size_t i = 0; i < TAG_COUNT; ++i)
+				{
+					created[i] = new ObjectPoolResource(
+						&get_memory_resource(static_cast<MemoryTag>(i)));
+				}
+				return created;
+			}();
+		return Allocator(pools[static_cast<size_t>(tag)]);
+	}
+
+	[[nodiscard]]
+	MemoryReport memory_report() noexcept
+	{
+		MemoryReport report;
+		report.tags.reserve(TAG_COUNT);
+		for (size_t i = 0; i < TAG_COUNT; ++i)
+		{
+			report.tags.push_back(usage_of(
+				get_memory_resource(static_cast<MemoryTag>(i))));
+		}
+		report.total = usage_of(get_root_memory_resource());
+		report.total.name = "total";
+		return report;
+	}
+
+	[[nodiscard]]
+	std::string MemoryReport::to_string() const noexcept
+	{
+		constexpr double MB = 1024.0 * 1024.0;
+		char line[256];
+		std::string result;
+
+		auto append = [&](const MemoryUsage& usage)
+			{
+				snprintf(line, sizeof(line),
+					"%-16s %10.2f MB in use, %10.2f MB peak, "
+					"%12llu allocations\n", usage.name,
+					static_cast<double>(usage.current_bytes) / MB,
+					static_cast<double>(usage.peak_bytes) / MB,
+					static_cast<unsigned long long>(usage.allocations));
+				result += line;
+			};
+
+		for (const MemoryUsage& usage : tags)
+		{
+			append(usage);
+		}
+		append(total);
+		return result;
+	}
+}
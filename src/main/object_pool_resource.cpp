@@ -0,0 +1,321 @@
+#include "main/object_pool_resource.h"
+
+#include <new>
+#include <vector>
+
+namespace loquat
+{
+	namespace
+	{
+		/// <summary>
+		/// The bytes at the start of a slab kept for its header, a whole
+		/// cache line so the first object doesn't share one with it.
+		/// </summary>
+		constexpr size_t SLAB_HEADER_SIZE =
+			hardware_destructive_interference_size;
+
+		/// <summary>
+		/// The slot of a thread that didn't get one.
+		/// </summary>
+		constexpr size_t NO_SLOT = ObjectPoolResource::MAX_THREADS;
+
+		/// <summary>
+		/// The slots threads can take, shared by every pool, so a pool can
+		/// keep its caches in an array instead of looking them up.
+		/// </summary>
+		struct ThreadSlots
+		{
+			std::mutex mutex;
+
+			/// <summary>
+			/// Slots given back by threads that have exited.
+			/// </summary>
+			std::vector<size_t> released;
+
+			/// <summary>
+			/// The next slot that has never been taken.
+			/// </summary>
+			size_t next = 0;
+		};
+
+		[[nodiscard]]
+		ThreadSlots& get_thread_slots() noexcept
+		{
+			//NOTE(ches) never freed, since threads can exit after statics
+			// are destroyed
+			static ThreadSlots* slots = new ThreadSlots();
+			return *slots;
+		}
+
+		/// <summary>
+		/// A thread's slot, taken when the thread first allocates from any
+		/// pool and given back when it exits. The next thread to take the
+		/// slot carries on with the caches the last one left behind.
+		/// </summary>
+		struct ThreadSlot
+		{
+			size_t index = NO_SLOT;
+
+			ThreadSlot() noexcept
+			{
+				ThreadSlots& slots = get_thread_slots();
+				std::lock_guard<std::mutex> lock(slots.mutex);
+				if (!slots.released.empty())
+				{
+					index = slots.released.back();
+					slots.released.pop_back();
+				}
+				else if (slots.next < NO_SLOT)
+				{
+					index = slots.next++;
+				}
+			}
+
+			~ThreadSlot()
+			{
+				if (index != NO_SLOT)
+				{
+					ThreadSlots& slots = get_thread_slots();
+					std::lock_guard<std::mutex> lock(slots.mutex);
+					slots.released.push_back(index);
+				}
+			}
+		};
+
+		[[nodiscard]]
+		size_t get_thread_slot() noexcept
+		{
+			thread_local ThreadSlot slot;
+			return slot.index;
+		}
+
+		[[nodiscard]]
+		constexpr size_t class_size(const size_t size_class) noexcept
+		{
+			return (size_class + 1) * ObjectPoolResource::CLASS_GRANULARITY;
+		}
+	}
+
+	ObjectPoolResource::ObjectPoolResource(
+		std::pmr::memory_resource* upstream) noexcept
+		: upstream(upstream)
+	{
+	}
+
+	ObjectPoolResource::~ObjectPoolResource()
+	{
+		Slab* slab = slabs.load(std::memory_order_acquire);
+		while (slab)
+		{
+			Slab* next = slab->next;
+			upstream->deallocate(slab, SLAB_SIZE, SLAB_SIZE);
+			slab = next;
+		}
+
+		Allocator allocator(upstream);
+		for (std::atomic<ThreadCache*>& slot : caches)
+		{
+			if (ThreadCache* cache = slot.load(std::memory_order_acquire))
+			{
+				allocator.delete_object(cache);
+			}
+		}
+	}
+
+	[[nodiscard]]
+	ObjectPoolStats ObjectPoolResource::get_stats() const noexcept
+	{
+		ObjectPoolStats stats;
+		stats.slab_count = slab_count.load(std::memory_order_relaxed);
+		stats.slab_bytes = stats.slab_count * SLAB_SIZE;
+		stats.large_count = large_count.load(std::memory_order_relaxed);
+		stats.large_bytes = large_bytes.load(std::memory_order_relaxed);
+		stats.thread_count = thread_count.load(std::memory_order_relaxed);
+		stats.remote_frees =
+			overflow_cache.remote_frees.load(std::memory_order_relaxed);
+		for (const std::atomic<ThreadCache*>& slot : caches)
+		{
+			//NOTE(ches) a cache being created as we read can't have had
+			// anything sent back to it yet, so missing it is fine
+			if (const ThreadCache* cache =
+				slot.load(std::memory_order_acquire))
+			{
+				stats.remote_frees +=
+					cache->remote_frees.load(std::memory_order_relaxed);
+			}
+		}
+		return stats;
+	}
+
+	void* ObjectPoolResource::do_allocate(const size_t size,
+		const size_t alignment) noexcept
+	{
+		if (!is_pooled(size, alignment))
+		{
+			void* pointer = upstream->allocate(size, alignment);
+			if (pointer)
+			{
+				large_count.fetch_add(1, std::memory_order_relaxed);
+				large_bytes.fetch_add(size, std::memory_order_relaxed);
+			}
+			return pointer;
+		}
+
+		const size_t size_class = size == 0 ? 0
+			: (size - 1) / CLASS_GRANULARITY;
+		ThreadCache* cache = get_thread_cache();
+		if (!cache)
+		{
+			std::lock_guard<std::mutex> lock(overflow_mutex);
+			return allocate_from(overflow_cache, size_class);
+		}
+		return allocate_from(*cache, size_class);
+	}
+
+	void ObjectPoolResource::do_deallocate(void* pointer, const size_t size,
+		const size_t alignment) noexcept
+	{
+		if (!is_pooled(size, alignment))
+		{
+			upstream->deallocate(pointer, size, alignment);
+			large_count.fetch_sub(1, std::memory_order_relaxed);
+			large_bytes.fetch_sub(size, std::memory_order_relaxed);
+			return;
+		}
+
+		Slab* slab = get_slab(pointer);
+		ClassCache& owner = slab->owner->classes[slab->size_class];
+		FreeObject* object = static_cast<FreeObject*>(pointer);
+
+		//NOTE(ches) only look the cache up, a thread that frees without
+		// ever allocating has no need for one of its own
+		const size_t slot = get_thread_slot();
+		const ThreadCache* cache = slot == NO_SLOT ? &overflow_cache
+			: caches[slot].load(std::memory_order_relaxed);
+		if (slab->owner == cache)
+		{
+			if (slot == NO_SLOT)
+			{
+				std::lock_guard<std::mutex> lock(overflow_mutex);
+				object->next = owner.free_list;
+				owner.free_list = object;
+			}
+			else
+			{
+				object->next = owner.free_list;
+				owner.free_list = object;
+			}
+			return;
+		}
+
+		FreeObject* head = owner.remote_frees.load(std::memory_order_relaxed);
+		do
+		{
+			object->next = head;
+		} while (!owner.remote_frees.compare_exchange_weak(head, object,
+			std::memory_order_release, std::memory_order_relaxed));
+		slab->owner->remote_frees.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	bool ObjectPoolResource::do_is_equal(
+		const std::pmr::memory_resource& other) const noexcept
+	{
+		return this == &other;
+	}
+
+	[[nodiscard]]
+	ObjectPoolResource::ThreadCache* ObjectPoolResource::get_thread_cache()
+		noexcept
+	{
+		const size_t slot = get_thread_slot();
+		if (slot == NO_SLOT)
+		{
+			return nullptr;
+		}
+
+		ThreadCache* cache = caches[slot].load(std::memory_order_relaxed);
+		if (!cache)
+		{
+			cache = Allocator(upstream).new_object<ThreadCache>();
+			caches[slot].store(cache, std::memory_order_release);
+			thread_count.fetch_add(1, std::memory_order_relaxed);
+		}
+		return cache;
+	}
+
+	[[nodiscard]]
+	void* ObjectPoolResource::allocate_from(ThreadCache& cache,
+		const size_t size_class) noexcept
+	{
+		ClassCache& objects = cache.classes[size_class];
+		//NOTE(ches) check before taking the remote frees, so building a
+		// scene from scratch, where nothing has been freed, never writes to
+		// a shared cache line
+		if (!objects.free_list
+			&& objects.remote_frees.load(std::memory_order_relaxed))
+		{
+			objects.free_list = objects.remote_frees.exchange(nullptr,
+				std::memory_order_acquire);
+		}
+
+		if (FreeObject* object = objects.free_list)
+		{
+			objects.free_list = object->next;
+			return object;
+		}
+
+		if (objects.untouched == objects.untouched_end
+			&& !add_slab(cache, size_class))
+		{
+			return nullptr;
+		}
+		void* object = objects.untouched;
+		objects.untouched += class_size(size_class);
+		return object;
+	}
+
+	[[nodiscard]]
+	bool ObjectPoolResource::add_slab(ThreadCache& cache,
+		const size_t size_class) noexcept
+	{
+		void* memory = upstream->allocate(SLAB_SIZE, SLAB_SIZE);
+		if (!memory)
+		{
+			return false;
+		}
+
+		Slab* slab = new (memory) Slab();
+		slab->owner = &cache;
+		slab->size_class = static_cast<uint32_t>(size_class);
+		slab->next = slabs.load(std::memory_order_relaxed);
+		while (!slabs.compare_exchange_weak(slab->next, slab,
+			std::memory_order_release, std::memory_order_relaxed))
+		{
+		}
+		slab_count.fetch_add(1, std::memory_order_relaxed);
+
+		const size_t size = class_size(size_class);
+		const size_t capacity = (SLAB_SIZE - SLAB_HEADER_SIZE) / size;
+		ClassCache& objects = cache.classes[size_class];
+		objects.untouched = static_cast<char*>(memory) + SLAB_HEADER_SIZE;
+		objects.untouched_end = objects.untouched + capacity * size;
+		return true;
+	}
+
+	[[nodiscard]]
+	ObjectPoolResource::Slab* ObjectPoolResource::get_slab(void* pointer)
+		noexcept
+	{
+		return reinterpret_cast<Slab*>(reinterpret_cast<uintptr_t>(pointer)
+			& ~(uintptr_t{ SLAB_SIZE } - 1));
+	}
+
+	[[nodiscard]]
+	bool ObjectPoolResource::is_pooled(const size_t size,
+		const size_t alignment) noexcept
+	{
+		static_assert(sizeof(Slab) <= SLAB_HEADER_SIZE,
+			"the slab header must fit before the first object");
+		return size <= MAX_CLASS_SIZE && alignment <= CLASS_GRANULARITY;
+	}
+}
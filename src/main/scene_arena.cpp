@@ -0,0 +1,261 @@
+#include "main/scene_arena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#if defined(_LOQUAT_WIN32)
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "debug/logger.h"
+
+namespace loquat
+{
+	namespace
+	{
+		[[nodiscard]]
+		constexpr size_t round_up(const size_t size, const size_t alignment)
+			noexcept
+		{
+			return (size + alignment - 1) & ~(alignment - 1);
+		}
+
+		[[nodiscard]]
+		char* align_up(char* pointer, const size_t alignment) noexcept
+		{
+			const uintptr_t address = reinterpret_cast<uintptr_t>(pointer);
+			return pointer + (round_up(address, alignment) - address);
+		}
+	}
+
+	SceneArena::SceneArena(const MemoryTag tag, const size_t chunk_size)
+		noexcept
+		: tag(tag),
+		chunk_size(round_up(std::max(chunk_size, HUGE_PAGE_SIZE),
+			HUGE_PAGE_SIZE))
+	{
+	}
+
+	SceneArena::~SceneArena()
+	{
+		release();
+	}
+
+	[[nodiscard]]
+	bool SceneArena::seal() noexcept
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		sealed = true;
+		return set_writable(false);
+	}
+
+	[[nodiscard]]
+	bool SceneArena::unseal() noexcept
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		sealed = false;
+		return set_writable(true);
+	}
+
+	void SceneArena::release() noexcept
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		//NOTE(ches) read only pages can be unmapped as they are
+		for (const Chunk& chunk : chunks)
+		{
+			get_memory_resource(tag).untrack_external(chunk.size);
+#if defined(_LOQUAT_WIN32)
+			VirtualFree(chunk.pages, 0, MEM_RELEASE);
+#else
+			munmap(chunk.pages, chunk.size);
+#endif
+		}
+		chunks.clear();
+		cursor = nullptr;
+		end = nullptr;
+		used_bytes = 0;
+		sealed = false;
+	}
+
+	[[nodiscard]]
+	SceneArenaStats SceneArena::get_stats() const noexcept
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		SceneArenaStats stats;
+		stats.chunk_count = chunks.size();
+		stats.used_bytes = used_bytes;
+		stats.sealed = sealed;
+		for (const Chunk& chunk : chunks)
+		{
+			stats.mapped_bytes += chunk.size;
+			if (chunk.kind == PageKind::Huge)
+			{
+				stats.huge_page_bytes += chunk.size;
+			}
+			else if (chunk.kind == PageKind::Advised)
+			{
+				stats.advised_bytes += chunk.size;
+			}
+		}
+		return stats;
+	}
+
+	void* SceneArena::do_allocate(const size_t size, const size_t alignment)
+		noexcept
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (sealed)
+		{
+			LOG_ERROR("Allocating from a sealed scene arena.");
+			return nullptr;
+		}
+
+		if (cursor != nullptr)
+		{
+			char* pointer = align_up(cursor, alignment);
+			if (pointer <= end && size <= static_cast<size_t>(end - pointer))
+			{
+				used_bytes += static_cast<size_t>(pointer + size - cursor);
+				cursor = pointer + size;
+				return pointer;
+			}
+		}
+
+		//NOTE(ches) chunks start on a huge page, so only alignments past
+		// that need room to slide the allocation along
+		const size_t padding = alignment > HUGE_PAGE_SIZE ? alignment : 0;
+		if (size + padding > chunk_size / 4)
+		{
+			//NOTE(ches) big allocations get a chunk of their own, so the
+			// rest of the current chunk isn't thrown away for them
+			const Chunk* chunk =
+				add_chunk(round_up(size + padding, HUGE_PAGE_SIZE));
+			if (chunk == nullptr)
+			{
+				return nullptr;
+			}
+			char* pointer = align_up(chunk->pages, alignment);
+			used_bytes += static_cast<size_t>(pointer + size - chunk->pages);
+			return pointer;
+		}
+
+		const Chunk* chunk = add_chunk(chunk_size);
+		if (chunk == nullptr)
+		{
+			return nullptr;
+		}
+		char* pointer = align_up(chunk->pages, alignment);
+		used_bytes += static_cast<size_t>(pointer + size - chunk->pages);
+		cursor = pointer + size;
+		end = chunk->pages + chunk->size;
+		return pointer;
+	}
+
+	void SceneArena::do_deallocate(void*, size_t, size_t) noexcept
+	{
+		//NOTE(ches) nothing is freed on its own, everything goes at once
+		// when the arena is released
+	}
+
+	bool SceneArena::do_is_equal(const std::pmr::memory_resource& other) const
+		noexcept
+	{
+		return this == &other;
+	}
+
+	[[nodiscard]]
+	SceneArena::Chunk* SceneArena::add_chunk(const size_t size) noexcept
+	{
+		Chunk chunk;
+		chunk.size = size;
+#if defined(_LOQUAT_WIN32)
+		//NOTE(ches) large pages need the lock pages privilege, which most
+		// accounts don't have, and Windows has nothing like transparent huge
+		// pages to fall back on
+		const size_t large_page = GetLargePageMinimum();
+		if (large_page != 0 && size % large_page == 0)
+		{
+			chunk.pages = static_cast<char*>(VirtualAlloc(nullptr, size,
+				MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE));
+			chunk.kind = PageKind::Huge;
+		}
+		if (chunk.pages == nullptr)
+		{
+			chunk.pages = static_cast<char*>(VirtualAlloc(nullptr, size,
+				MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+			chunk.kind = PageKind::Ordinary;
+		}
+		if (chunk.pages == nullptr)
+		{
+			return nullptr;
+		}
+#else
+#if defined(MAP_HUGETLB)
+		//NOTE(ches) this only works when huge pages have been reserved up
+		// front, which is rare outside of dedicated render machines
+		void* huge = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (huge != MAP_FAILED)
+		{
+			chunk.pages = static_cast<char*>(huge);
+			chunk.kind = PageKind::Huge;
+		}
+#endif
+		if (chunk.pages == nullptr)
+		{
+			//NOTE(ches) map a huge page extra, so we can trim the chunk to
+			// start on a huge page boundary, since the system can only back
+			// whole aligned huge pages
+			void* pages = mmap(nullptr, size + HUGE_PAGE_SIZE,
+				PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (pages == MAP_FAILED)
+			{
+				return nullptr;
+			}
+			char* start = static_cast<char*>(pages);
+			char* aligned = align_up(start, HUGE_PAGE_SIZE);
+			const size_t before = static_cast<size_t>(aligned - start);
+			if (before > 0)
+			{
+				munmap(start, before);
+			}
+			if (HUGE_PAGE_SIZE - before > 0)
+			{
+				munmap(aligned + size, HUGE_PAGE_SIZE - before);
+			}
+			chunk.pages = aligned;
+			chunk.kind = PageKind::Ordinary;
+#if defined(MADV_HUGEPAGE)
+			if (madvise(aligned, size, MADV_HUGEPAGE) == 0)
+			{
+				chunk.kind = PageKind::Advised;
+			}
+#endif
+		}
+#endif
+		get_memory_resource(tag).track_external(size);
+		chunks.push_back(chunk);
+		return &chunks.back();
+	}
+
+	[[nodiscard]]
+	bool SceneArena::set_writable(const bool writable) noexcept
+	{
+		bool all_changed = true;
+		for (const Chunk& chunk : chunks)
+		{
+#if defined(_LOQUAT_WIN32)
+			DWORD old_protection;
+			all_changed &= VirtualProtect(chunk.pages, chunk.size,
+				writable ? PAGE_READWRITE : PAGE_READONLY,
+				&old_protection) != 0;
+#else
+			all_changed &= mprotect(chunk.pages, chunk.size,
+				writable ? PROT_READ | PROT_WRITE : PROT_READ) == 0;
+#endif
+		}
+		return all_changed;
+	}
+}
@@ -0,0 +1,72 @@
+#include "main/thread_pool.h"
+
+#include <algorithm>
+
+namespace loquat
+{
+	ThreadPool::ThreadPool(size_t thread_count) noexcept
+	{
+		if (thread_count == 0)
+		{
+			thread_count = std::max(1u, std::thread::hardware_concurrency());
+		}
+
+		workers.reserve(thread_count);
+		for (size_t i = 0; i < thread_count; ++i)
+		{
+			workers.emplace_back(&ThreadPool::work, this);
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::scoped_lock job_lock{ job_mutex };
+			stopping = true;
+		}
+		job_available.notify_all();
+
+		for (std::thread& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	void ThreadPool::enqueue(Job job) noexcept
+	{
+		{
+			std::scoped_lock job_lock{ job_mutex };
+			jobs.push_back(std::move(job));
+		}
+		job_available.notify_one();
+	}
+
+	[[nodiscard]]
+	size_t ThreadPool::size() const noexcept
+	{
+		return workers.size();
+	}
+
+	void ThreadPool::work() noexcept
+	{
+		while (true)
+		{
+			Job job;
+			{
+				std::unique_lock job_lock{ job_mutex };
+				job_available.wait(job_lock,
+					[this]() { return stopping || !jobs.empty(); });
+
+				//NOTE(ches) we drain the queue before stopping, since jobs
+				// may be holding promises that someone is waiting on
+				if (jobs.empty())
+				{
+					return;
+				}
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+			job();
+		}
+	}
+}
@@ -11,6 +11,40 @@
 
 namespace loquat
 {
+#if ENABLE_WIP_CODE
+	void ImageTileIntegrator::render()
+	{
+		const AABB2i pixel_bounds = camera.get_film().pixel_bounds();
+		const int samples_per_pixel =
+			sampler_prototype.get_samples_per_pixel();
+
+		//TODO(ches) split the image into tiles and render them on every
+		// thread, each with its own sampler
+		Sampler sampler = sampler_prototype.clone();
+		for (int y = pixel_bounds.min.y; y < pixel_bounds.max.y; ++y)
+		{
+			for (int x = pixel_bounds.min.x; x < pixel_bounds.max.x; ++x)
+			{
+				const Point2i pixel{ x, y };
+				for (int sample_index = 0; sample_index < samples_per_pixel;
+					++sample_index)
+				{
+					sampler.start_pixel_sample(pixel, sample_index);
+					run_pixel_sample(pixel, sample_index, sampler);
+				}
+			}
+		}
+	}
+#endif
+
+	void ImageTileIntegrator::run_pixel_sample(Point2i pixel,
+		int sample_index, Sampler sampler)
+	{
+		ScratchBuffer& scratch_buffer = get_thread_scratch_buffer();
+		evaulate_pixel_sample(pixel, sample_index, sampler, scratch_buffer);
+		scratch_buffer.reset();
+	}
+
 	[[nodiscard]]
 	SampledSpectrum RandomWalkIntegrator::light_incoming_random_walk(
 		RayDifferential ray,
@@ -197,12 +197,26 @@ namespace loquat
 		{
 			LOG_FATAL("Failed to create graphics pipeline");
 		}
+
+		//NOTE(ches) the modules subscribed first, so they have already been
+		// rebuilt by the time we hear about it
+		for (const auto& module : shader->modules)
+		{
+			shader_subscriptions.push_back(g_resource_cache->subscribe(
+				Resource{ module->name },
+				[this](std::shared_ptr<ResourceHandle>) { outdated = true; }));
+		}
 	}
 
 	Pipeline::~Pipeline()
 	{
 		const auto& device = g_global_state->device->logical_device;
 
+		for (const size_t subscription : shader_subscriptions)
+		{
+			g_resource_cache->unsubscribe(subscription);
+		}
+
 		destroy_frame_buffers();
 
 		vkDestroyPipeline(device, graphics_pipeline, nullptr);
@@ -281,6 +295,20 @@ namespace loquat
 		create_frame_buffers();
 	}
 
+	void recreate_pipeline() noexcept
+	{
+		vkDeviceWaitIdle(g_global_state->device->logical_device);
+
+		std::unique_ptr<Shader> shader =
+			std::move(g_global_state->pipeline->shader);
+		shader->refresh_modules();
+
+		safe_delete(g_global_state->pipeline);
+		g_global_state->pipeline = alloc<Pipeline>(std::move(shader));
+
+		create_frame_buffers();
+	}
+
 	void create_frame_buffers() noexcept
 	{
 		const auto& image_views =
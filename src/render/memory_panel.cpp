@@ -0,0 +1,78 @@
+#include "render/memory_panel.h"
+
+#include <cfloat>
+#include <cstdio>
+
+#include "imgui.h"
+
+#include "main/memory_tracking.h"
+
+namespace loquat::render
+{
+	namespace
+	{
+		constexpr float MB = 1024.0f * 1024.0f;
+
+		/// <summary>
+		/// Show one row of the memory table.
+		/// </summary>
+		/// <param name="usage">The usage to show.</param>
+		/// <param name="total">The bytes everything is using, to show the
+		/// row's share of.</param>
+		void draw_usage(const MemoryUsage& usage, const size_t total) noexcept
+		{
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(usage.name);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.2f", static_cast<float>(usage.current_bytes) / MB);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.2f", static_cast<float>(usage.peak_bytes) / MB);
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu",
+				static_cast<unsigned long long>(usage.allocations));
+			ImGui::TableNextColumn();
+			const float share = total == 0 ? 0.0f
+				: static_cast<float>(usage.current_bytes)
+				/ static_cast<float>(total);
+			char overlay[16];
+			snprintf(overlay, sizeof(overlay), "%.0f%%", share * 100.0f);
+			ImGui::ProgressBar(share, ImVec2(-FLT_MIN, 0.0f), overlay);
+		}
+	}
+
+	void draw_memory_panel(bool* open) noexcept
+	{
+		if (!ImGui::Begin("Memory", open))
+		{
+			ImGui::End();
+			return;
+		}
+
+		const MemoryReport report = memory_report();
+		if (ImGui::BeginTable("memory", 5, ImGuiTableFlags_RowBg
+			| ImGuiTableFlags_BordersInnerV))
+		{
+			ImGui::TableSetupColumn("Subsystem");
+			ImGui::TableSetupColumn("MB");
+			ImGui::TableSetupColumn("Peak MB");
+			ImGui::TableSetupColumn("Allocations");
+			ImGui::TableSetupColumn("Share");
+			ImGui::TableHeadersRow();
+			for (const MemoryUsage& usage : report.tags)
+			{
+				draw_usage(usage, report.total.current_bytes);
+			}
+			draw_usage(report.total, report.total.current_bytes);
+			ImGui::EndTable();
+		}
+
+		ImGui::Separator();
+		if (ImGui::Button("Copy report"))
+		{
+			ImGui::SetClipboardText(report.to_string().c_str());
+		}
+
+		ImGui::End();
+	}
+}
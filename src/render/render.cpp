@@ -5,6 +5,8 @@
 #include "imgui_impl_vulkan.h"
 
 #include "main/loquat.h"
+#include "render/memory_panel.h"
+#include "render/resource_cache_panel.h"
 #include "window/window.h"
 #include "window/window_state.h"
 
@@ -17,6 +19,16 @@ namespace loquat::render
 
 	constexpr ImVec4 RED = ImVec4(1.0f, 0.1f, 0.1f, 1.0f);
 
+	/// <summary>
+	/// Whether the resource cache stats window is open.
+	/// </summary>
+	bool show_resource_cache_panel = false;
+
+	/// <summary>
+	/// Whether the memory window is open.
+	/// </summary>
+	bool show_memory_panel = false;
+
 	void draw_UI() noexcept
 	{
 		ImGui_ImplVulkan_NewFrame();
@@ -36,6 +48,13 @@ namespace loquat::render
 
 				ImGui::EndMenu();
 			}
+			if (ImGui::BeginMenu("Debug"))
+			{
+				ImGui::MenuItem("Resource Cache", nullptr,
+					&show_resource_cache_panel);
+				ImGui::MenuItem("Memory", nullptr, &show_memory_panel);
+				ImGui::EndMenu();
+			}
 			ImGui::PushStyleColor(ImGuiCol_Text, RED);
 			if (ImGui::MenuItem("Exit"))
 			{
@@ -59,6 +78,14 @@ namespace loquat::render
 			}
 			ImGui::EndPopup();
 		}
+		if (show_resource_cache_panel)
+		{
+			draw_resource_cache_panel(&show_resource_cache_panel);
+		}
+		if (show_memory_panel)
+		{
+			draw_memory_panel(&show_memory_panel);
+		}
 		ImGui::ShowDemoWindow();
 
 		ImGui::Render();
@@ -0,0 +1,161 @@
+#include "render/resource_cache_panel.h"
+
+#include <array>
+#include <cfloat>
+#include <cstdint>
+#include <cstdio>
+
+#include "imgui.h"
+
+#include "resource/resource_cache.h"
+
+namespace loquat::render
+{
+	namespace
+	{
+		constexpr float MB = 1024.0f * 1024.0f;
+
+		/// <summary>
+		/// Show one latency histogram, with its summary on top.
+		/// </summary>
+		void draw_latency(const char* label, const LatencySummary& latency)
+			noexcept
+		{
+			ImGui::SeparatorText(label);
+			ImGui::Text("%llu samples, %.2f ms total",
+				static_cast<unsigned long long>(latency.count),
+				static_cast<double>(latency.total_ns) / 1.0e6);
+			ImGui::Text("mean %.1f us, p50 <= %.0f us, p99 <= %.0f us, "
+				"max %.1f us", latency.mean_us(), latency.percentile_us(0.5),
+				latency.percentile_us(0.99),
+				static_cast<double>(latency.max_ns) / 1.0e3);
+
+			std::array<float, LatencySummary::BUCKET_COUNT> buckets;
+			for (size_t i = 0; i < buckets.size(); ++i)
+			{
+				buckets[i] = static_cast<float>(latency.buckets[i]);
+			}
+			ImGui::PushID(label);
+			ImGui::PlotHistogram("##buckets", buckets.data(),
+				static_cast<int>(buckets.size()), 0,
+				"log2 microseconds", 0.0f, FLT_MAX, ImVec2(0.0f, 60.0f));
+			ImGui::PopID();
+		}
+	}
+
+	void draw_resource_cache_panel(bool* open) noexcept
+	{
+		if (!ImGui::Begin("Resource Cache", open))
+		{
+			ImGui::End();
+			return;
+		}
+
+		const ResourceCacheStats stats = g_resource_cache->get_stats();
+
+		ImGui::SeparatorText("Requests");
+		ImGui::Text("%.1f%% hit rate", stats.hit_rate() * 100.0);
+		ImGui::Text("%llu hits, %llu joined, %llu misses, %llu failed",
+			static_cast<unsigned long long>(stats.hits),
+			static_cast<unsigned long long>(stats.joined),
+			static_cast<unsigned long long>(stats.misses),
+			static_cast<unsigned long long>(stats.failed_loads));
+		ImGui::Text("%llu dependencies prefetched",
+			static_cast<unsigned long long>(stats.prefetched));
+		ImGui::Text("%.2f MB read, %.2f MB loaded",
+			static_cast<float>(stats.bytes_read) / MB,
+			static_cast<float>(stats.bytes_loaded) / MB);
+
+		ImGui::SeparatorText("Memory");
+		const float budget = static_cast<float>(stats.cache_size);
+		char overlay[64];
+		snprintf(overlay, sizeof(overlay), "%.1f / %.1f MB",
+			static_cast<float>(stats.allocated) / MB, budget / MB);
+		ImGui::ProgressBar(static_cast<float>(stats.allocated) / budget,
+			ImVec2(-FLT_MIN, 0.0f), overlay);
+		ImGui::Text("peak %.1f MB (%.0f%% of budget), hard limit %.1f MB",
+			static_cast<float>(stats.peak_allocated) / MB,
+			static_cast<float>(stats.peak_allocated) / budget * 100.0f,
+			static_cast<float>(stats.hard_limit) / MB);
+		ImGui::Text("%llu loads waited for memory, %llu timed out, "
+			"%llu went over budget",
+			static_cast<unsigned long long>(stats.backpressure_waits),
+			static_cast<unsigned long long>(stats.backpressure_timeouts),
+			static_cast<unsigned long long>(stats.over_budget_loads));
+		ImGui::Text("%.1f MB mapped for %.1f MB of buffers, "
+			"%.1f%% fragmentation",
+			static_cast<float>(stats.buffers.mapped_bytes) / MB,
+			static_cast<float>(stats.buffers.requested_bytes) / MB,
+			stats.buffers.fragmentation() * 100.0);
+		ImGui::Text("%zu slabs, %zu large buffers", stats.buffers.slab_count,
+			stats.buffers.large_count);
+		ImGui::Text("%llu evictions, %.2f MB evicted",
+			static_cast<unsigned long long>(stats.evictions),
+			static_cast<float>(stats.bytes_evicted) / MB);
+		ImGui::Text("%llu shared buffers, %.2f MB saved by deduplication",
+			static_cast<unsigned long long>(stats.deduplicated),
+			static_cast<float>(stats.bytes_deduplicated) / MB);
+
+		ImGui::SeparatorText("Derived data");
+		ImGui::Text("%llu hits, %llu misses, %llu stored",
+			static_cast<unsigned long long>(stats.derived_hits),
+			static_cast<unsigned long long>(stats.derived_misses),
+			static_cast<unsigned long long>(stats.derived_stores));
+		ImGui::Text("%.1f MB on disk",
+			static_cast<float>(stats.derived_disk_size) / MB);
+
+		//NOTE(ches) the report takes every shard lock, so it is only built
+		// while someone is looking at it
+		if (ImGui::CollapsingHeader("Pinned memory"))
+		{
+			const ResourcePinReport pins =
+				g_resource_cache->get_pin_report();
+			ImGui::Text("%.2f MB held in the cache, %.2f MB evicted but "
+				"still held", static_cast<float>(pins.cached_bytes) / MB,
+				static_cast<float>(pins.evicted_bytes) / MB);
+			if (ImGui::BeginTable("pins", 4, ImGuiTableFlags_RowBg
+				| ImGuiTableFlags_ScrollY, ImVec2(0.0f, 200.0f)))
+			{
+				ImGui::TableSetupColumn("Resource");
+				ImGui::TableSetupColumn("MB");
+				ImGui::TableSetupColumn("Holders");
+				ImGui::TableSetupColumn("State");
+				ImGui::TableHeadersRow();
+				for (const ResourcePin& pin : pins.pins)
+				{
+					ImGui::TableNextRow();
+					ImGui::TableNextColumn();
+					ImGui::TextUnformatted(pin.name.c_str());
+					ImGui::TableNextColumn();
+					ImGui::Text("%.2f", static_cast<float>(pin.size) / MB);
+					ImGui::TableNextColumn();
+					ImGui::Text("%ld", pin.holders);
+					ImGui::TableNextColumn();
+					ImGui::TextUnformatted(!pin.cached ? "evicted"
+						: pin.pin_count > 0 ? "pinned" : "cached");
+				}
+				ImGui::EndTable();
+			}
+			if (ImGui::Button("Copy pin report"))
+			{
+				ImGui::SetClipboardText(pins.to_string(SIZE_MAX).c_str());
+			}
+		}
+
+		draw_latency("File reads", stats.file_read);
+		draw_latency("Loaders", stats.loader);
+
+		ImGui::Separator();
+		if (ImGui::Button("Reset"))
+		{
+			g_resource_cache->reset_stats();
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Copy report"))
+		{
+			ImGui::SetClipboardText(stats.to_string().c_str());
+		}
+
+		ImGui::End();
+	}
+}
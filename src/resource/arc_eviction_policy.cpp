@@ -0,0 +1,180 @@
+#include "resource/arc_eviction_policy.h"
+
+#include <algorithm>
+
+#include "resource/resource_handle.h"
+
+namespace loquat
+{
+	namespace
+	{
+		/// <summary>
+		/// How far to move the recent list's target when a ghost is hit.
+		/// </summary>
+		/// <param name="size">The size of the resource that was hit.</param>
+		/// <param name="hit_ghost_bytes">The bytes of ghosts in the list the
+		/// resource was evicted from.</param>
+		/// <param name="other_ghost_bytes">The bytes of ghosts in the other
+		/// list.</param>
+		/// <param name="capacity">The most the target can move.</param>
+		/// <returns>The step, at least one byte.</returns>
+		[[nodiscard]]
+		size_t adaptation_step(const size_t size, const size_t hit_ghost_bytes,
+			const size_t other_ghost_bytes, const size_t capacity) noexcept
+		{
+			//NOTE(ches) the ratio is kept in floating point, whole number
+			// division would round anything under twice as many down to one
+			const double ratio = hit_ghost_bytes == 0 ? 1.0
+				: static_cast<double>(other_ghost_bytes)
+				/ static_cast<double>(hit_ghost_bytes);
+			const double step = static_cast<double>(std::max<size_t>(size, 1))
+				* std::max(1.0, ratio);
+			return std::max<size_t>(1, static_cast<size_t>(
+				std::min(step, static_cast<double>(capacity))));
+		}
+	}
+
+	ARCEvictionPolicy::ARCEvictionPolicy(size_t capacity) noexcept
+		: capacity{ capacity }
+	{}
+
+	void ARCEvictionPolicy::add_ghost(const ResourceHandle* handle,
+		Queue queue) noexcept
+	{
+		GhostList& list = queue == QUEUE_RECENT ? recent_ghosts
+			: frequent_ghosts;
+		list.push_front({ handle->resource.name, handle->charged_size, queue });
+		(queue == QUEUE_RECENT ? recent_ghost_bytes : frequent_ghost_bytes)
+			+= handle->charged_size;
+
+		//NOTE(ches) a name can only be a ghost once, the newest one wins
+		auto [entry, inserted] = ghosts.try_emplace(handle->resource.name,
+			list.begin());
+		if (!inserted)
+		{
+			remove_ghost(entry->second);
+			entry->second = list.begin();
+		}
+	}
+
+	void ARCEvictionPolicy::remove_ghost(GhostList::iterator ghost) noexcept
+	{
+		if (ghost->queue == QUEUE_RECENT)
+		{
+			recent_ghost_bytes -= ghost->size;
+			recent_ghosts.erase(ghost);
+		}
+		else
+		{
+			frequent_ghost_bytes -= ghost->size;
+			frequent_ghosts.erase(ghost);
+		}
+	}
+
+	void ARCEvictionPolicy::trim_ghosts() noexcept
+	{
+		while (!recent_ghosts.empty()
+			&& recent_bytes + recent_ghost_bytes > capacity)
+		{
+			auto oldest = std::prev(recent_ghosts.end());
+			ghosts.erase(oldest->name);
+			remove_ghost(oldest);
+		}
+
+		while (!frequent_ghosts.empty()
+			&& recent_bytes + frequent_bytes + recent_ghost_bytes
+			+ frequent_ghost_bytes > 2 * capacity)
+		{
+			auto oldest = std::prev(frequent_ghosts.end());
+			ghosts.erase(oldest->name);
+			remove_ghost(oldest);
+		}
+	}
+
+	void ARCEvictionPolicy::insert(ResourceHandle* handle) noexcept
+	{
+		const size_t size = handle->charged_size;
+
+		auto ghost = ghosts.find(handle->resource.name);
+		if (ghost == ghosts.end())
+		{
+			handle->eviction_queue = QUEUE_RECENT;
+			recent.push_front(handle);
+			recent_bytes += size;
+			trim_ghosts();
+			return;
+		}
+
+		//NOTE(ches) we evicted this too early, so give more room to the
+		// list it was evicted from. The step is larger when that list's
+		// ghosts are rare compared to the other list's
+		if (ghost->second->queue == QUEUE_RECENT)
+		{
+			const size_t step = adaptation_step(size, recent_ghost_bytes,
+				frequent_ghost_bytes, capacity);
+			recent_target = std::min(capacity, recent_target + step);
+		}
+		else
+		{
+			const size_t step = adaptation_step(size, frequent_ghost_bytes,
+				recent_ghost_bytes, capacity);
+			recent_target = recent_target > step ? recent_target - step : 0;
+		}
+		remove_ghost(ghost->second);
+		ghosts.erase(ghost);
+
+		handle->eviction_queue = QUEUE_FREQUENT;
+		frequent.push_front(handle);
+		frequent_bytes += size;
+		trim_ghosts();
+	}
+
+	void ARCEvictionPolicy::touch(ResourceHandle* handle) noexcept
+	{
+		if (handle->eviction_queue == QUEUE_RECENT)
+		{
+			recent.remove(handle);
+			recent_bytes -= handle->charged_size;
+			handle->eviction_queue = QUEUE_FREQUENT;
+			frequent.push_front(handle);
+			frequent_bytes += handle->charged_size;
+		}
+		else if (handle->eviction_queue == QUEUE_FREQUENT)
+		{
+			frequent.move_to_front(handle);
+		}
+	}
+
+	void ARCEvictionPolicy::remove(ResourceHandle* handle) noexcept
+	{
+		if (handle->eviction_queue == QUEUE_RECENT)
+		{
+			recent.remove(handle);
+			recent_bytes -= handle->charged_size;
+		}
+		else if (handle->eviction_queue == QUEUE_FREQUENT)
+		{
+			frequent.remove(handle);
+			frequent_bytes -= handle->charged_size;
+		}
+		handle->eviction_queue = QUEUE_NONE;
+	}
+
+	[[nodiscard]]
+	ResourceHandle* ARCEvictionPolicy::evict() noexcept
+	{
+		const bool from_recent = !recent.empty()
+			&& (recent_bytes > recent_target || frequent.empty());
+		ResourceHandle* victim = from_recent ? recent.back() : frequent.back();
+		if (victim == nullptr)
+		{
+			return nullptr;
+		}
+
+		const Queue queue = static_cast<Queue>(victim->eviction_queue);
+		remove(victim);
+		add_ghost(victim, queue);
+		trim_ghosts();
+		return victim;
+	}
+}
@@ -0,0 +1,23 @@
+#include "resource/batch_file_reader.h"
+
+#include "debug/logger.h"
+#include "main/memory_utils.h"
+#include "resource/pread_file_reader.h"
+#include "resource/uring_file_reader.h"
+
+namespace loquat
+{
+	[[nodiscard]]
+	BatchFileReader* make_batch_file_reader(size_t queue_depth,
+		size_t thread_count) noexcept
+	{
+		BatchFileReader* reader = UringFileReader::create(queue_depth);
+		if (reader == nullptr)
+		{
+			reader = alloc<PreadFileReader>(thread_count);
+		}
+		LOG_INFO(std::string("Reading resources in batches with ")
+			+ reader->get_name());
+		return reader;
+	}
+}
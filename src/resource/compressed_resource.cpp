@@ -0,0 +1,175 @@
+#include "resource/compressed_resource.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "resource/lz_codec.h"
+
+namespace loquat
+{
+	namespace
+	{
+		constexpr char COMPRESSED_MAGIC[4] = { 'L', 'Q', 'L', 'Z' };
+
+		/// <summary>
+		/// Set in a chunk size when the chunk is stored uncompressed.
+		/// </summary>
+		constexpr uint32_t CHUNK_STORED = 0x80000000u;
+
+		static_assert(sizeof(CompressedResourceHeader) == 24,
+			"The compressed header layout is part of the file format");
+	}
+
+	[[nodiscard]]
+	bool read_compressed_header(const char* raw_buffer, size_t raw_size,
+		CompressedResourceHeader& header) noexcept
+	{
+		if (raw_buffer == nullptr || raw_size < sizeof(header))
+		{
+			return false;
+		}
+		memcpy(&header, raw_buffer, sizeof(header));
+
+		if (memcmp(header.magic, COMPRESSED_MAGIC,
+			sizeof(COMPRESSED_MAGIC)) != 0
+			|| header.version != COMPRESSED_RESOURCE_VERSION
+			|| header.chunk_size == 0
+			|| header.chunk_size >= CHUNK_STORED)
+		{
+			return false;
+		}
+
+		const uint64_t expected_chunks =
+			(header.decoded_size + header.chunk_size - 1)
+			/ header.chunk_size;
+		return expected_chunks == header.chunk_count;
+	}
+
+	[[nodiscard]]
+	bool compressed_resource_size(const char* raw_buffer, size_t raw_size,
+		size_t& decoded_size) noexcept
+	{
+		CompressedResourceHeader header;
+		if (!read_compressed_header(raw_buffer, raw_size, header))
+		{
+			return false;
+		}
+		decoded_size = static_cast<size_t>(header.decoded_size);
+		return true;
+	}
+
+	bool compress_resource(const char* data, size_t size,
+		std::vector<char>& output, uint32_t chunk_size) noexcept
+	{
+		if (chunk_size == 0 || chunk_size >= CHUNK_STORED)
+		{
+			return false;
+		}
+
+		CompressedResourceHeader header{};
+		memcpy(header.magic, COMPRESSED_MAGIC, sizeof(COMPRESSED_MAGIC));
+		header.version = COMPRESSED_RESOURCE_VERSION;
+		header.decoded_size = size;
+		header.chunk_size = chunk_size;
+		header.chunk_count = static_cast<uint32_t>(
+			(size + chunk_size - 1) / chunk_size);
+
+		output.clear();
+		output.resize(sizeof(header));
+		memcpy(output.data(), &header, sizeof(header));
+
+		std::vector<char> block(lz_compress_bound(chunk_size));
+		for (size_t offset = 0; offset < size; offset += chunk_size)
+		{
+			const size_t chunk_length = std::min<size_t>(size - offset,
+				chunk_size);
+			const size_t compressed_size = lz_compress(data + offset,
+				chunk_length, block.data(), block.size());
+
+			//NOTE(ches) chunks that don't shrink are stored as is, so the
+			// worst case is only a few bytes per chunk bigger
+			const bool stored = compressed_size == 0
+				|| compressed_size >= chunk_length;
+			const char* chunk_data = stored ? data + offset : block.data();
+			const size_t stored_size = stored ? chunk_length
+				: compressed_size;
+			const uint32_t chunk_header = static_cast<uint32_t>(stored_size)
+				| (stored ? CHUNK_STORED : 0);
+
+			const size_t position = output.size();
+			output.resize(position + sizeof(chunk_header) + stored_size);
+			memcpy(output.data() + position, &chunk_header,
+				sizeof(chunk_header));
+			memcpy(output.data() + position + sizeof(chunk_header),
+				chunk_data, stored_size);
+		}
+		return true;
+	}
+
+	[[nodiscard]]
+	bool decompress_resource(const char* raw_buffer, size_t raw_size,
+		char* destination, size_t destination_size) noexcept
+	{
+		CompressedResourceHeader header;
+		if (!read_compressed_header(raw_buffer, raw_size, header)
+			|| header.decoded_size != destination_size)
+		{
+			return false;
+		}
+
+		const char* input = raw_buffer + sizeof(header);
+		const char* const input_end = raw_buffer + raw_size;
+		char* output = destination;
+		size_t remaining = destination_size;
+
+		for (uint32_t chunk = 0; chunk < header.chunk_count; ++chunk)
+		{
+			uint32_t chunk_header;
+			if (static_cast<size_t>(input_end - input) < sizeof(chunk_header))
+			{
+				return false;
+			}
+			memcpy(&chunk_header, input, sizeof(chunk_header));
+			input += sizeof(chunk_header);
+
+			const size_t stored_size =
+				compressed_chunk_stored_size(chunk_header);
+			const size_t decoded_size = std::min<size_t>(remaining,
+				header.chunk_size);
+			if (stored_size > static_cast<size_t>(input_end - input)
+				|| !decompress_chunk(chunk_header, input, output,
+					decoded_size))
+			{
+				return false;
+			}
+
+			input += stored_size;
+			output += decoded_size;
+			remaining -= decoded_size;
+		}
+		return remaining == 0;
+	}
+
+	[[nodiscard]]
+	size_t compressed_chunk_stored_size(uint32_t chunk_header) noexcept
+	{
+		return chunk_header & ~CHUNK_STORED;
+	}
+
+	[[nodiscard]]
+	bool decompress_chunk(uint32_t chunk_header, const char* input,
+		char* destination, size_t decoded_size) noexcept
+	{
+		const size_t stored_size = compressed_chunk_stored_size(chunk_header);
+		if ((chunk_header & CHUNK_STORED) != 0)
+		{
+			if (stored_size != decoded_size)
+			{
+				return false;
+			}
+			memcpy(destination, input, decoded_size);
+			return true;
+		}
+		return lz_decompress(input, stored_size, destination, decoded_size);
+	}
+}
@@ -0,0 +1,137 @@
+#include "resource/compressed_resource_loader.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "debug/logger.h"
+#include "resource/compressed_resource.h"
+#include "resource/resource_handle.h"
+#include "resource/resource_stream.h"
+
+namespace loquat
+{
+	bool CompressedResourceLoader::use_raw_file()
+	{
+		return false;
+	}
+
+	bool CompressedResourceLoader::use_stream()
+	{
+		return true;
+	}
+
+	bool CompressedResourceLoader::prefer_mapped_raw()
+	{
+		return true;
+	}
+
+	bool CompressedResourceLoader::discard_raw_buffer_after_load()
+	{
+		return true;
+	}
+
+	std::string CompressedResourceLoader::get_derived_data_version()
+	{
+		return "CompressedResourceLoader 1";
+	}
+
+	size_t CompressedResourceLoader::get_loaded_resource_size(
+		char* raw_buffer, size_t raw_size)
+	{
+		size_t decoded_size = 0;
+		if (!compressed_resource_size(raw_buffer, raw_size, decoded_size))
+		{
+			return 0;
+		}
+		return decoded_size;
+	}
+
+	bool CompressedResourceLoader::load_resource(char* raw_buffer,
+		size_t raw_size, std::shared_ptr<ResourceHandle> handle)
+	{
+		if (!decompress_resource(raw_buffer, raw_size,
+			handle->get_writeable_buffer(), handle->get_size()))
+		{
+			LOG_ERROR(handle->get_name() + " is not a valid compressed resource");
+			return false;
+		}
+		return true;
+	}
+
+	size_t CompressedResourceLoader::get_streamed_resource_size(
+		ResourceStream& stream)
+	{
+		char header_bytes[sizeof(CompressedResourceHeader)];
+		size_t decoded_size = 0;
+		if (stream.read(header_bytes, sizeof(header_bytes))
+			!= sizeof(header_bytes) || !compressed_resource_size(header_bytes,
+				sizeof(header_bytes), decoded_size))
+		{
+			return 0;
+		}
+		return decoded_size;
+	}
+
+	bool CompressedResourceLoader::load_stream(ResourceStream& stream,
+		std::shared_ptr<ResourceHandle> handle)
+	{
+		char header_bytes[sizeof(CompressedResourceHeader)];
+		CompressedResourceHeader header;
+		if (stream.read_at(0, sizeof(header_bytes), header_bytes)
+			!= sizeof(header_bytes) || !read_compressed_header(header_bytes,
+				sizeof(header_bytes), header)
+			|| header.decoded_size != handle->get_size())
+		{
+			LOG_ERROR(handle->get_name() + " is not a valid compressed resource");
+			return false;
+		}
+
+		//NOTE(ches) a chunk is only stored compressed if that made it
+		// smaller, so no chunk is ever bigger than the chunk size
+		std::vector<char> chunk(std::min<size_t>(header.chunk_size,
+			stream.get_size()));
+		char* output = handle->get_writeable_buffer();
+		size_t remaining = handle->get_size();
+		for (uint32_t i = 0; i < header.chunk_count; ++i)
+		{
+			uint32_t chunk_header;
+			if (stream.read(reinterpret_cast<char*>(&chunk_header),
+				sizeof(chunk_header)) != sizeof(chunk_header))
+			{
+				LOG_ERROR(handle->get_name() + " is truncated");
+				return false;
+			}
+
+			const size_t stored_size =
+				compressed_chunk_stored_size(chunk_header);
+			const size_t decoded_size = std::min<size_t>(remaining,
+				header.chunk_size);
+			if (stored_size > chunk.size()
+				|| stream.read(chunk.data(), stored_size) != stored_size
+				|| !decompress_chunk(chunk_header, chunk.data(), output,
+					decoded_size))
+			{
+				LOG_ERROR(handle->get_name()
+					+ " is not a valid compressed resource");
+				return false;
+			}
+			output += decoded_size;
+			remaining -= decoded_size;
+		}
+		return remaining == 0;
+	}
+
+	std::string CompressedResourceLoader::get_pattern()
+	{
+		return "*.lz";
+	}
+
+	double CompressedResourceLoader::get_reload_cost(size_t raw_size,
+		size_t loaded_size)
+	{
+		//NOTE(ches) decoding writes every output byte, at roughly half the
+		// speed we read
+		return ResourceLoader::get_reload_cost(raw_size, loaded_size)
+			+ static_cast<double>(loaded_size) / 500.0;
+	}
+}
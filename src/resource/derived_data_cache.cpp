@@ -0,0 +1,278 @@
+#include "resource/derived_data_cache.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+#include <vector>
+
+#include "debug/logger.h"
+#include "pbr/math/hash.h"
+#include "resource/resource_file_mapped.h"
+
+namespace loquat
+{
+	namespace fs = std::filesystem;
+
+	namespace
+	{
+		/// <summary>
+		/// Written at the start of every entry, so a file that was cut short
+		/// or belongs to another key is never mistaken for a match.
+		/// </summary>
+		struct DerivedDataHeader
+		{
+			char magic[8];
+			uint64_t raw_hash;
+			uint64_t raw_size;
+			uint64_t loader_hash;
+			uint64_t data_size;
+			uint64_t reserved[3];
+		};
+
+		//NOTE(ches) the data starts right after the header, so keeping it a
+		// multiple of 16 keeps the data as aligned as a pool buffer
+		static_assert(sizeof(DerivedDataHeader) == 64);
+
+		constexpr char MAGIC[8] = { 'L', 'Q', 'D', 'E', 'R', 'I', 'V', '1' };
+
+		constexpr const char* EXTENSION = ".derived";
+
+		/// <summary>
+		/// Seeds the hash of the loader version, so it doesn't hash alike
+		/// with raw data that happens to hold the same bytes.
+		/// </summary>
+		constexpr uint64_t LOADER_SEED = 0x64657269766564ull;
+
+		/// <summary>
+		/// When the folder goes over its limit, it is trimmed to this
+		/// fraction of it, so that the next few stores don't trim again.
+		/// </summary>
+		constexpr double TRIM_TARGET = 0.75;
+	}
+
+	DerivedDataCache::DerivedDataCache(const std::string directory,
+		const size_t size_in_MB) noexcept
+		: directory{ (fs::path(directory) / "").string() }
+		, max_size{ size_in_MB * 1024 * 1024 }
+		, disk_size{ 0 }
+		, next_temporary{ 0 }
+		, hits{ 0 }
+		, misses{ 0 }
+		, stores{ 0 }
+	{}
+
+	bool DerivedDataCache::open() noexcept
+	{
+		std::error_code error;
+		fs::create_directories(directory, error);
+		if (!fs::is_directory(directory, error))
+		{
+			LOG_WARNING("Could not open derived data cache " + directory);
+			return false;
+		}
+		trim();
+		return true;
+	}
+
+	[[nodiscard]]
+	DerivedDataKey DerivedDataCache::make_key(const uint64_t raw_hash,
+		const size_t raw_size, const std::string& version) noexcept
+	{
+		DerivedDataKey key;
+		key.raw_hash = raw_hash;
+		key.raw_size = raw_size;
+		key.loader_hash = murmur_hash_64A(
+			reinterpret_cast<const unsigned char*>(version.data()),
+			version.size(), LOADER_SEED);
+		return key;
+	}
+
+	[[nodiscard]]
+	std::string DerivedDataCache::path_for(const DerivedDataKey& key) const
+		noexcept
+	{
+		char name[64];
+		snprintf(name, sizeof(name), "%016" PRIx64 "%016" PRIx64 "%s",
+			key.loader_hash, key.raw_hash, EXTENSION);
+		return directory + name;
+	}
+
+	[[nodiscard]]
+	ResourceMapping DerivedDataCache::find(const DerivedDataKey& key) noexcept
+	{
+		const std::string path = path_for(key);
+		ResourceMapping mapping = map_file(path);
+
+		DerivedDataHeader header;
+		if (mapping.data == nullptr || mapping.size < sizeof(header))
+		{
+			misses.fetch_add(1, std::memory_order_relaxed);
+			return ResourceMapping();
+		}
+		memcpy(&header, mapping.data, sizeof(header));
+		if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+			|| header.raw_hash != key.raw_hash
+			|| header.raw_size != key.raw_size
+			|| header.loader_hash != key.loader_hash
+			|| header.data_size != mapping.size - sizeof(header))
+		{
+			misses.fetch_add(1, std::memory_order_relaxed);
+			return ResourceMapping();
+		}
+
+		//NOTE(ches) the modification time doubles as the last use, which
+		// is what trimming goes by
+		std::error_code error;
+		fs::last_write_time(path, fs::file_time_type::clock::now(), error);
+
+		mapping.data += sizeof(header);
+		mapping.size -= sizeof(header);
+		hits.fetch_add(1, std::memory_order_relaxed);
+		return mapping;
+	}
+
+	void DerivedDataCache::store(const DerivedDataKey& key, const char* data,
+		const size_t size) noexcept
+	{
+		DerivedDataHeader header{};
+		memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.raw_hash = key.raw_hash;
+		header.raw_size = key.raw_size;
+		header.loader_hash = key.loader_hash;
+		header.data_size = size;
+
+		const std::string path = path_for(key);
+		const std::string temporary = path + "."
+			+ std::to_string(next_temporary.fetch_add(1,
+				std::memory_order_relaxed)) + ".tmp";
+		{
+			std::ofstream out{ temporary, std::ios::binary | std::ios::trunc };
+			out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			out.write(data, static_cast<std::streamsize>(size));
+			if (!out)
+			{
+				out.close();
+				std::error_code error;
+				fs::remove(temporary, error);
+				LOG_WARNING("Could not write derived data " + temporary);
+				return;
+			}
+		}
+
+		std::error_code error;
+		fs::rename(temporary, path, error);
+		if (error)
+		{
+			fs::remove(temporary, error);
+			return;
+		}
+		stores.fetch_add(1, std::memory_order_relaxed);
+
+		if (disk_size.fetch_add(sizeof(header) + size,
+			std::memory_order_relaxed) + sizeof(header) + size > max_size)
+		{
+			trim();
+		}
+	}
+
+	void DerivedDataCache::trim() noexcept
+	{
+		//NOTE(ches) whoever is already trimming will get this store too
+		std::unique_lock trim_lock{ trim_mutex, std::try_to_lock };
+		if (!trim_lock.owns_lock())
+		{
+			return;
+		}
+
+		struct Entry
+		{
+			fs::file_time_type last_used;
+			size_t size;
+			fs::path path;
+		};
+		std::vector<Entry> entries;
+		size_t total = 0;
+
+		std::error_code error;
+		for (fs::directory_iterator it{ directory, error }, end;
+			!error && it != end; it.increment(error))
+		{
+			if (it->path().extension() != EXTENSION)
+			{
+				continue;
+			}
+			std::error_code entry_error;
+			const size_t size = static_cast<size_t>(
+				it->file_size(entry_error));
+			const fs::file_time_type last_used =
+				it->last_write_time(entry_error);
+			if (entry_error)
+			{
+				continue;
+			}
+			entries.push_back({ last_used, size, it->path() });
+			total += size;
+		}
+
+		if (total > max_size)
+		{
+			std::sort(entries.begin(), entries.end(),
+				[](const Entry& a, const Entry& b)
+				{
+					return a.last_used < b.last_used;
+				});
+			const size_t target =
+				static_cast<size_t>(static_cast<double>(max_size)
+					* TRIM_TARGET);
+			for (const Entry& entry : entries)
+			{
+				if (total <= target)
+				{
+					break;
+				}
+				//NOTE(ches) on Windows a file that is still mapped can't be
+				// deleted, so it just stays until a later trim
+				if (fs::remove(entry.path, error))
+				{
+					total -= entry.size;
+				}
+			}
+		}
+		disk_size.store(total, std::memory_order_relaxed);
+	}
+
+	[[nodiscard]]
+	uint64_t DerivedDataCache::get_hits() const noexcept
+	{
+		return hits.load(std::memory_order_relaxed);
+	}
+
+	[[nodiscard]]
+	uint64_t DerivedDataCache::get_misses() const noexcept
+	{
+		return misses.load(std::memory_order_relaxed);
+	}
+
+	[[nodiscard]]
+	uint64_t DerivedDataCache::get_stores() const noexcept
+	{
+		return stores.load(std::memory_order_relaxed);
+	}
+
+	[[nodiscard]]
+	size_t DerivedDataCache::get_disk_size() const noexcept
+	{
+		return disk_size.load(std::memory_order_relaxed);
+	}
+
+	void DerivedDataCache::reset_stats() noexcept
+	{
+		hits.store(0, std::memory_order_relaxed);
+		misses.store(0, std::memory_order_relaxed);
+		stores.store(0, std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,126 @@
+#include "resource/gdsf_eviction_policy.h"
+
+#include <algorithm>
+
+#include "debug/logger.h"
+#include "resource/resource_handle.h"
+
+namespace loquat
+{
+	void GDSFEvictionPolicy::update_priority(ResourceHandle* handle) const
+		noexcept
+	{
+		//NOTE(ches) mapped handles may not be charged for anything yet, but
+		// they still take up a slot
+		const double size = static_cast<double>(
+			std::max<size_t>(handle->charged_size, 1));
+		handle->eviction_priority = inflation
+			+ static_cast<double>(handle->access_count) * handle->reload_cost
+			/ size;
+	}
+
+	void GDSFEvictionPolicy::place(size_t index, ResourceHandle* handle)
+		noexcept
+	{
+		heap[index] = handle;
+		handle->eviction_index = index;
+	}
+
+	void GDSFEvictionPolicy::sift_up(size_t index) noexcept
+	{
+		ResourceHandle* handle = heap[index];
+		while (index > 0)
+		{
+			const size_t parent = (index - 1) / 2;
+			if (heap[parent]->eviction_priority <= handle->eviction_priority)
+			{
+				break;
+			}
+			place(index, heap[parent]);
+			index = parent;
+		}
+		place(index, handle);
+	}
+
+	void GDSFEvictionPolicy::sift_down(size_t index) noexcept
+	{
+		ResourceHandle* handle = heap[index];
+		const size_t count = heap.size();
+		while (true)
+		{
+			size_t child = index * 2 + 1;
+			if (child >= count)
+			{
+				break;
+			}
+			if (child + 1 < count && heap[child + 1]->eviction_priority
+				< heap[child]->eviction_priority)
+			{
+				++child;
+			}
+			if (handle->eviction_priority <= heap[child]->eviction_priority)
+			{
+				break;
+			}
+			place(index, heap[child]);
+			index = child;
+		}
+		place(index, handle);
+	}
+
+	void GDSFEvictionPolicy::insert(ResourceHandle* handle) noexcept
+	{
+		//NOTE(ches) handles are inserted again when they are unpinned or
+		// the policy changes, so only the load itself counts as a use
+		handle->access_count = std::max<size_t>(handle->access_count, 1);
+		update_priority(handle);
+		heap.push_back(handle);
+		sift_up(heap.size() - 1);
+	}
+
+	void GDSFEvictionPolicy::touch(ResourceHandle* handle) noexcept
+	{
+		LOG_ASSERT(handle->eviction_index < heap.size()
+			&& heap[handle->eviction_index] == handle
+			&& "Handle is not tracked by this policy");
+
+		//NOTE(ches) the inflation value only ever goes up, so the priority
+		// does too and the handle can only move down
+		++handle->access_count;
+		update_priority(handle);
+		sift_down(handle->eviction_index);
+	}
+
+	void GDSFEvictionPolicy::remove(ResourceHandle* handle) noexcept
+	{
+		const size_t index = handle->eviction_index;
+		if (index >= heap.size() || heap[index] != handle)
+		{
+			return;
+		}
+
+		ResourceHandle* last = heap.back();
+		heap.pop_back();
+		if (last == handle)
+		{
+			return;
+		}
+		place(index, last);
+		sift_up(index);
+		sift_down(last->eviction_index);
+	}
+
+	[[nodiscard]]
+	ResourceHandle* GDSFEvictionPolicy::evict() noexcept
+	{
+		if (heap.empty())
+		{
+			return nullptr;
+		}
+
+		ResourceHandle* victim = heap.front();
+		inflation = victim->eviction_priority;
+		remove(victim);
+		return victim;
+	}
+}
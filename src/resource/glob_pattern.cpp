@@ -0,0 +1,164 @@
+#include "resource/glob_pattern.h"
+
+namespace loquat
+{
+	void GlobPattern::compile() noexcept
+	{
+		pieces.clear();
+		min_length = 0;
+
+		const std::string_view text = pattern;
+		size_t start = 0;
+		while (true)
+		{
+			const size_t star = text.find('*', start);
+			Piece piece;
+			piece.text = text.substr(start, star == std::string_view::npos
+				? std::string_view::npos : star - start);
+			piece.has_any = piece.text.find('?') != std::string_view::npos;
+			min_length += piece.text.size();
+			pieces.push_back(piece);
+			if (star == std::string_view::npos)
+			{
+				break;
+			}
+
+			//NOTE(ches) a run of stars means the same as one
+			start = text.find_first_not_of('*', star);
+			if (start == std::string_view::npos)
+			{
+				pieces.push_back(Piece());
+				break;
+			}
+		}
+	}
+
+	GlobPattern::GlobPattern(std::string_view pattern) noexcept
+		: pattern{ pattern }
+	{
+		compile();
+	}
+
+	GlobPattern::GlobPattern(const GlobPattern& other) noexcept
+		: pattern{ other.pattern }
+	{
+		compile();
+	}
+
+	GlobPattern& GlobPattern::operator=(const GlobPattern& other) noexcept
+	{
+		if (this != &other)
+		{
+			pattern = other.pattern;
+			compile();
+		}
+		return *this;
+	}
+
+	[[nodiscard]]
+	bool GlobPattern::piece_matches(const Piece& piece, const char* text)
+		noexcept
+	{
+		if (!piece.has_any)
+		{
+			return piece.text.compare(0, piece.text.size(), text,
+				piece.text.size()) == 0;
+		}
+		for (size_t i = 0; i < piece.text.size(); ++i)
+		{
+			if (piece.text[i] == '?' ? text[i] == '.'
+				: piece.text[i] != text[i])
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	[[nodiscard]]
+	size_t GlobPattern::find_piece(const Piece& piece, std::string_view text)
+		noexcept
+	{
+		if (!piece.has_any)
+		{
+			return text.find(piece.text);
+		}
+		if (text.size() < piece.text.size())
+		{
+			return std::string_view::npos;
+		}
+		const size_t last = text.size() - piece.text.size();
+		for (size_t offset = 0; offset <= last; ++offset)
+		{
+			if (piece_matches(piece, text.data() + offset))
+			{
+				return offset;
+			}
+		}
+		return std::string_view::npos;
+	}
+
+	[[nodiscard]]
+	bool GlobPattern::matches(std::string_view name) const noexcept
+	{
+		if (name.size() < min_length)
+		{
+			return false;
+		}
+
+		const Piece& first = pieces.front();
+		if (pieces.size() == 1)
+		{
+			return name.size() == first.text.size()
+				&& piece_matches(first, name.data());
+		}
+
+		const Piece& last = pieces.back();
+		if (!piece_matches(first, name.data())
+			|| !piece_matches(last,
+				name.data() + name.size() - last.text.size()))
+		{
+			return false;
+		}
+
+		//NOTE(ches) taking the leftmost place for each middle piece leaves
+		// the most room for the rest, so if that fails nothing else works
+		std::string_view rest = name.substr(first.text.size(),
+			name.size() - first.text.size() - last.text.size());
+		for (size_t i = 1; i + 1 < pieces.size(); ++i)
+		{
+			const size_t found = find_piece(pieces[i], rest);
+			if (found == std::string_view::npos)
+			{
+				return false;
+			}
+			rest.remove_prefix(found + pieces[i].text.size());
+		}
+		return true;
+	}
+
+	[[nodiscard]]
+	std::string_view GlobPattern::get_prefix() const noexcept
+	{
+		const std::string_view first = pieces.front().text;
+		return first.substr(0, first.find('?'));
+	}
+
+	[[nodiscard]]
+	std::string_view GlobPattern::get_suffix() const noexcept
+	{
+		if (pieces.size() == 1)
+		{
+			return std::string_view();
+		}
+		const std::string_view last = pieces.back().text;
+		const size_t any = last.rfind('?');
+		return any == std::string_view::npos ? last : last.substr(any + 1);
+	}
+
+	[[nodiscard]]
+	bool GlobPattern::is_literal() const noexcept
+	{
+		return pieces.size() == 1 && !pieces.front().has_any;
+	}
+}
@@ -0,0 +1,30 @@
+#include "resource/lru_eviction_policy.h"
+
+namespace loquat
+{
+	void LRUEvictionPolicy::insert(ResourceHandle* handle) noexcept
+	{
+		lru_list.push_front(handle);
+	}
+
+	void LRUEvictionPolicy::touch(ResourceHandle* handle) noexcept
+	{
+		lru_list.move_to_front(handle);
+	}
+
+	void LRUEvictionPolicy::remove(ResourceHandle* handle) noexcept
+	{
+		lru_list.remove(handle);
+	}
+
+	[[nodiscard]]
+	ResourceHandle* LRUEvictionPolicy::evict() noexcept
+	{
+		ResourceHandle* victim = lru_list.back();
+		if (victim != nullptr)
+		{
+			lru_list.remove(victim);
+		}
+		return victim;
+	}
+}
@@ -0,0 +1,277 @@
+#include "resource/lz_codec.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace loquat
+{
+	namespace
+	{
+		/// <summary>
+		/// The shortest match worth encoding.
+		/// </summary>
+		constexpr size_t MIN_MATCH = 4;
+
+		/// <summary>
+		/// Matches stop this far from the end, so the block always ends
+		/// with literals.
+		/// </summary>
+		constexpr size_t LAST_LITERALS = 5;
+
+		/// <summary>
+		/// Matches don't start this close to the end.
+		/// </summary>
+		constexpr size_t MATCH_FIND_LIMIT = 12;
+
+		/// <summary>
+		/// The number of bits in the match finder's hash table index.
+		/// </summary>
+		constexpr uint32_t HASH_BITS = 14;
+
+		/// <summary>
+		/// The largest length that fits in half of a token.
+		/// </summary>
+		constexpr size_t TOKEN_LENGTH_MASK = 15;
+
+		[[nodiscard]]
+		inline uint32_t read_32(const uint8_t* data) noexcept
+		{
+			uint32_t value;
+			memcpy(&value, data, sizeof(value));
+			return value;
+		}
+
+		[[nodiscard]]
+		inline uint32_t hash_sequence(uint32_t sequence) noexcept
+		{
+			return (sequence * 2654435761u) >> (32 - HASH_BITS);
+		}
+
+		inline uint8_t* write_length(uint8_t* output, size_t length) noexcept
+		{
+			while (length >= 255)
+			{
+				*output++ = 255;
+				length -= 255;
+			}
+			*output++ = static_cast<uint8_t>(length);
+			return output;
+		}
+
+		[[nodiscard]]
+		inline bool read_length(const uint8_t*& input, const uint8_t* end,
+			size_t& length) noexcept
+		{
+			uint8_t next;
+			do
+			{
+				if (input >= end)
+				{
+					return false;
+				}
+				next = *input++;
+				length += next;
+			} while (next == 255);
+			return true;
+		}
+
+		uint8_t* write_sequence(uint8_t* output, const uint8_t* literals,
+			size_t literal_length, size_t offset, size_t match_length)
+			noexcept
+		{
+			uint8_t* token = output++;
+			const size_t encoded_match = match_length - MIN_MATCH;
+
+			*token = static_cast<uint8_t>(
+				(std::min(literal_length, TOKEN_LENGTH_MASK) << 4)
+				| std::min(encoded_match, TOKEN_LENGTH_MASK));
+
+			if (literal_length >= TOKEN_LENGTH_MASK)
+			{
+				output = write_length(output,
+					literal_length - TOKEN_LENGTH_MASK);
+			}
+			memcpy(output, literals, literal_length);
+			output += literal_length;
+
+			*output++ = static_cast<uint8_t>(offset & 0xff);
+			*output++ = static_cast<uint8_t>(offset >> 8);
+
+			if (encoded_match >= TOKEN_LENGTH_MASK)
+			{
+				output = write_length(output,
+					encoded_match - TOKEN_LENGTH_MASK);
+			}
+			return output;
+		}
+	}
+
+	[[nodiscard]]
+	size_t lz_compress(const char* source, size_t source_size,
+		char* destination, size_t capacity) noexcept
+	{
+		if (capacity < lz_compress_bound(source_size))
+		{
+			return 0;
+		}
+
+		const uint8_t* const start = reinterpret_cast<const uint8_t*>(source);
+		const uint8_t* const end = start + source_size;
+		const uint8_t* input = start;
+		const uint8_t* anchor = start;
+		uint8_t* output = reinterpret_cast<uint8_t*>(destination);
+
+		if (source_size >= MATCH_FIND_LIMIT)
+		{
+			//NOTE(ches) positions are relative to the start, so the zeroed
+			// table just points everything at the first byte, which the
+			// comparison below rejects if it doesn't actually match
+			std::vector<uint32_t> positions(size_t{ 1 } << HASH_BITS, 0);
+			const uint8_t* const match_limit = end - MATCH_FIND_LIMIT;
+			const uint8_t* const match_end_limit = end - LAST_LITERALS;
+
+			while (input < match_limit)
+			{
+				const uint32_t sequence = read_32(input);
+				const uint32_t hash = hash_sequence(sequence);
+				const uint8_t* candidate = start + positions[hash];
+				positions[hash] = static_cast<uint32_t>(input - start);
+
+				if (candidate >= input
+					|| static_cast<size_t>(input - candidate) > LZ_MAX_OFFSET
+					|| read_32(candidate) != sequence)
+				{
+					//NOTE(ches) step faster through data that isn't
+					// matching, since it is probably incompressible
+					const size_t step = 1 + ((input - anchor) >> 6);
+					if (step >= static_cast<size_t>(match_limit - input))
+					{
+						break;
+					}
+					input += step;
+					continue;
+				}
+
+				while (input > anchor && candidate > start
+					&& input[-1] == candidate[-1])
+				{
+					--input;
+					--candidate;
+				}
+
+				const uint8_t* match_end = input + MIN_MATCH;
+				const uint8_t* reference = candidate + MIN_MATCH;
+				while (match_end < match_end_limit && *match_end == *reference)
+				{
+					++match_end;
+					++reference;
+				}
+
+				output = write_sequence(output, anchor,
+					static_cast<size_t>(input - anchor),
+					static_cast<size_t>(input - candidate),
+					static_cast<size_t>(match_end - input));
+
+				input = match_end;
+				anchor = input;
+				if (input < match_limit)
+				{
+					positions[hash_sequence(read_32(input - 2))] =
+						static_cast<uint32_t>(input - 2 - start);
+				}
+			}
+		}
+
+		const size_t literal_length = static_cast<size_t>(end - anchor);
+		*output++ = static_cast<uint8_t>(
+			std::min(literal_length, TOKEN_LENGTH_MASK) << 4);
+		if (literal_length >= TOKEN_LENGTH_MASK)
+		{
+			output = write_length(output, literal_length - TOKEN_LENGTH_MASK);
+		}
+		memcpy(output, anchor, literal_length);
+		output += literal_length;
+
+		return static_cast<size_t>(
+			output - reinterpret_cast<uint8_t*>(destination));
+	}
+
+	[[nodiscard]]
+	bool lz_decompress(const char* source, size_t source_size,
+		char* destination, size_t destination_size) noexcept
+	{
+		const uint8_t* input = reinterpret_cast<const uint8_t*>(source);
+		const uint8_t* const input_end = input + source_size;
+		uint8_t* const start = reinterpret_cast<uint8_t*>(destination);
+		uint8_t* output = start;
+		uint8_t* const output_end = start + destination_size;
+
+		while (input < input_end)
+		{
+			const uint8_t token = *input++;
+
+			size_t literal_length = token >> 4;
+			if (literal_length == TOKEN_LENGTH_MASK
+				&& !read_length(input, input_end, literal_length))
+			{
+				return false;
+			}
+			if (literal_length > static_cast<size_t>(input_end - input)
+				|| literal_length > static_cast<size_t>(output_end - output))
+			{
+				return false;
+			}
+			memcpy(output, input, literal_length);
+			input += literal_length;
+			output += literal_length;
+
+			if (input == input_end)
+			{
+				return output == output_end;
+			}
+
+			if (input_end - input < 2)
+			{
+				return false;
+			}
+			const size_t offset = static_cast<size_t>(input[0])
+				| (static_cast<size_t>(input[1]) << 8);
+			input += 2;
+			if (offset == 0 || offset > static_cast<size_t>(output - start))
+			{
+				return false;
+			}
+
+			size_t match_length = token & TOKEN_LENGTH_MASK;
+			if (match_length == TOKEN_LENGTH_MASK
+				&& !read_length(input, input_end, match_length))
+			{
+				return false;
+			}
+			match_length += MIN_MATCH;
+			if (match_length > static_cast<size_t>(output_end - output))
+			{
+				return false;
+			}
+
+			const uint8_t* match = output - offset;
+			if (offset >= match_length)
+			{
+				memcpy(output, match, match_length);
+				output += match_length;
+			}
+			else
+			{
+				//NOTE(ches) overlapping matches repeat the last few bytes,
+				// so they have to be copied one at a time
+				for (size_t i = 0; i < match_length; ++i)
+				{
+					*output++ = *match++;
+				}
+			}
+		}
+		return false;
+	}
+}
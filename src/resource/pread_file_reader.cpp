@@ -0,0 +1,96 @@
+#include "resource/pread_file_reader.h"
+
+#include <cerrno>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+
+#if !defined(_LOQUAT_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace loquat
+{
+	PreadFileReader::PreadFileReader(size_t thread_count) noexcept
+		: pool{ thread_count }
+	{}
+
+	void PreadFileReader::read(std::vector<FileRead>& reads) noexcept
+	{
+		std::mutex done_mutex;
+		std::condition_variable all_done;
+		size_t remaining = reads.size();
+
+		for (FileRead& file_read : reads)
+		{
+			pool.enqueue([&file_read, &done_mutex, &all_done, &remaining]()
+				{
+					read_file_blocking(file_read);
+
+					std::scoped_lock done_lock{ done_mutex };
+					if (--remaining == 0)
+					{
+						all_done.notify_one();
+					}
+				});
+		}
+
+		std::unique_lock done_lock{ done_mutex };
+		all_done.wait(done_lock, [&remaining]() { return remaining == 0; });
+	}
+
+	[[nodiscard]]
+	const char* PreadFileReader::get_name() const noexcept
+	{
+		return "pread";
+	}
+
+#if defined(_LOQUAT_WIN32)
+
+	void read_file_blocking(FileRead& read) noexcept
+	{
+		read.bytes_read = 0;
+		std::ifstream file_bytes(read.path, std::ios_base::binary);
+		if (!file_bytes.is_open())
+		{
+			return;
+		}
+		file_bytes.seekg(static_cast<std::streamoff>(read.offset));
+		file_bytes.read(read.buffer, static_cast<std::streamsize>(read.length));
+		read.bytes_read = static_cast<size_t>(file_bytes.gcount());
+	}
+
+#else
+
+	void read_file_blocking(FileRead& read) noexcept
+	{
+		read.bytes_read = 0;
+		const int descriptor = open(read.path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (descriptor < 0)
+		{
+			return;
+		}
+
+		//NOTE(ches) reads can come back short, so keep going until the
+		// file runs out
+		while (read.bytes_read < read.length)
+		{
+			const ssize_t count = pread(descriptor,
+				read.buffer + read.bytes_read, read.length - read.bytes_read,
+				static_cast<off_t>(read.offset + read.bytes_read));
+			if (count < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (count <= 0)
+			{
+				break;
+			}
+			read.bytes_read += static_cast<size_t>(count);
+		}
+		close(descriptor);
+	}
+
+#endif
+}
@@ -0,0 +1,407 @@
+#include "resource/resource_buffer_pool.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <new>
+
+#if defined(_LOQUAT_WIN32)
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "debug/logger.h"
+#include "main/memory_tracking.h"
+
+namespace loquat
+{
+	namespace
+	{
+		/// <summary>
+		/// Large buffers are rounded up to whole pages of this size.
+		/// </summary>
+		constexpr size_t PAGE_SIZE = 4096;
+
+		/// <summary>
+		/// Round a large buffer up to whole pages.
+		/// </summary>
+		[[nodiscard]]
+		constexpr size_t page_rounded(const size_t size) noexcept
+		{
+			return (size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+		}
+
+		/// <summary>
+		/// Map fresh zeroed pages from the system.
+		/// </summary>
+		/// <param name="size">The number of bytes, a multiple of the page
+		/// size.</param>
+		/// <returns>The pages, null on failure.</returns>
+		[[nodiscard]]
+		void* map_pages(const size_t size) noexcept
+		{
+#if defined(_LOQUAT_WIN32)
+			void* pages = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT,
+				PAGE_READWRITE);
+#else
+			void* pages = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (pages == MAP_FAILED)
+			{
+				pages = nullptr;
+			}
+#endif
+			if (pages != nullptr)
+			{
+				get_memory_resource(MemoryTag::ResourceCache)
+					.track_external(size);
+			}
+			return pages;
+		}
+
+		/// <summary>
+		/// Give pages from map_pages or map_aligned back to the system.
+		/// </summary>
+		void unmap_pages(void* pages, const size_t size) noexcept
+		{
+			get_memory_resource(MemoryTag::ResourceCache)
+				.untrack_external(size);
+#if defined(_LOQUAT_WIN32)
+			(void)size;
+			VirtualFree(pages, 0, MEM_RELEASE);
+#else
+			munmap(pages, size);
+#endif
+		}
+
+		/// <summary>
+		/// Tell the system we don't need what is in some pages any more, so
+		/// it can take them back without us unmapping them. They read as
+		/// zero, or whatever was there, the next time they are touched.
+		/// </summary>
+		void discard_pages(void* pages, const size_t size) noexcept
+		{
+#if defined(_LOQUAT_WIN32)
+			VirtualAlloc(pages, size, MEM_RESET, PAGE_READWRITE);
+#else
+			madvise(pages, size, MADV_DONTNEED);
+#endif
+		}
+
+		/// <summary>
+		/// Map pages aligned to their own size.
+		/// </summary>
+		/// <param name="size">The number of bytes, a power of two.</param>
+		/// <returns>The pages, null on failure.</returns>
+		[[nodiscard]]
+		void* map_aligned(const size_t size) noexcept
+		{
+#if defined(_LOQUAT_WIN32)
+			//NOTE(ches) Windows can't release part of a reservation, so we
+			// find an aligned address in a bigger one, let it go, and try to
+			// map exactly there, which can race with other threads
+			for (int attempt = 0; attempt < 8; ++attempt)
+			{
+				void* probe = VirtualAlloc(nullptr, size * 2, MEM_RESERVE,
+					PAGE_NOACCESS);
+				if (probe == nullptr)
+				{
+					return nullptr;
+				}
+				const uintptr_t aligned =
+					(reinterpret_cast<uintptr_t>(probe) + size - 1)
+					& ~(uintptr_t{ size } - 1);
+				VirtualFree(probe, 0, MEM_RELEASE);
+				void* pages = VirtualAlloc(reinterpret_cast<void*>(aligned),
+					size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+				if (pages != nullptr)
+				{
+					get_memory_resource(MemoryTag::ResourceCache)
+						.track_external(size);
+					return pages;
+				}
+			}
+			return nullptr;
+#else
+			char* pages = static_cast<char*>(map_pages(size * 2));
+			if (pages == nullptr)
+			{
+				return nullptr;
+			}
+			const uintptr_t start = reinterpret_cast<uintptr_t>(pages);
+			const uintptr_t aligned = (start + size - 1)
+				& ~(uintptr_t{ size } - 1);
+			const size_t before = aligned - start;
+			if (before > 0)
+			{
+				munmap(pages, before);
+			}
+			munmap(reinterpret_cast<char*>(aligned) + size, size - before);
+			get_memory_resource(MemoryTag::ResourceCache)
+				.untrack_external(size);
+			return reinterpret_cast<void*>(aligned);
+#endif
+		}
+	}
+
+	ResourceBufferPool::~ResourceBufferPool()
+	{
+		for (size_t i = 0; i < CLASS_COUNT; ++i)
+		{
+			if (classes[i].spare != nullptr)
+			{
+				unmap_pages(classes[i].spare, slab_size(i));
+				classes[i].spare = nullptr;
+			}
+		}
+		LOG_ASSERT(requested_bytes.load() == 0
+			&& "Resource buffers outlived their pool");
+	}
+
+	[[nodiscard]]
+	size_t ResourceBufferPool::class_index(const size_t size) noexcept
+	{
+		if (size <= MIN_CLASS_SIZE)
+		{
+			return 0;
+		}
+
+		//NOTE(ches) each power of two is split into four steps, so the
+		// class is the power below the size plus however many steps it
+		// takes to reach it
+		const size_t power = std::bit_width(size - 1) - 1;
+		const size_t step = size_t{ 1 } << (power - 2);
+		const size_t steps = (size - (size_t{ 1 } << power) + step - 1) / step;
+		return (power - std::bit_width(MIN_CLASS_SIZE) + 1) * 4 + steps;
+	}
+
+	[[nodiscard]]
+	size_t ResourceBufferPool::class_size(const size_t index) noexcept
+	{
+		if (index == 0)
+		{
+			return MIN_CLASS_SIZE;
+		}
+		const size_t power = std::bit_width(MIN_CLASS_SIZE) - 1
+			+ (index - 1) / 4;
+		const size_t steps = (index - 1) % 4 + 1;
+		return (size_t{ 1 } << power) + steps * (size_t{ 1 } << (power - 2));
+	}
+
+	[[nodiscard]]
+	size_t ResourceBufferPool::rounded_size(const size_t size) noexcept
+	{
+		if (size <= MAX_CLASS_SIZE)
+		{
+			return class_size(class_index(size));
+		}
+		return page_rounded(size);
+	}
+
+	[[nodiscard]]
+	size_t ResourceBufferPool::slab_size(const size_t index) noexcept
+	{
+		return std::clamp(std::bit_ceil(class_size(index) * SLAB_BUFFER_COUNT),
+			MIN_SLAB_SIZE, MAX_SLAB_SIZE);
+	}
+
+	[[nodiscard]]
+	ResourceBufferPool::Slab* ResourceBufferPool::format_slab(void* pages,
+		const size_t index) noexcept
+	{
+		constexpr size_t header_size = (sizeof(Slab) + SLAB_ALIGNMENT - 1)
+			& ~(SLAB_ALIGNMENT - 1);
+		Slab* slab = new (pages) Slab();
+		slab->untouched = static_cast<char*>(pages) + header_size;
+		slab->capacity = static_cast<uint32_t>(
+			(slab_size(index) - header_size) / class_size(index));
+		return slab;
+	}
+
+	void ResourceBufferPool::link(SizeClass& size_class, Slab* slab) noexcept
+	{
+		slab->previous = nullptr;
+		slab->next = size_class.with_room;
+		if (size_class.with_room != nullptr)
+		{
+			size_class.with_room->previous = slab;
+		}
+		size_class.with_room = slab;
+		slab->listed = true;
+	}
+
+	void ResourceBufferPool::unlink(SizeClass& size_class, Slab* slab) noexcept
+	{
+		if (slab->previous != nullptr)
+		{
+			slab->previous->next = slab->next;
+		}
+		else
+		{
+			size_class.with_room = slab->next;
+		}
+		if (slab->next != nullptr)
+		{
+			slab->next->previous = slab->previous;
+		}
+		slab->previous = nullptr;
+		slab->next = nullptr;
+		slab->listed = false;
+	}
+
+	void* ResourceBufferPool::do_allocate(size_t size, size_t alignment)
+		noexcept
+	{
+		size = std::max<size_t>(size, 1);
+
+		if (size > MAX_CLASS_SIZE || alignment > SLAB_ALIGNMENT)
+		{
+			const size_t mapped_size = page_rounded(size);
+			void* pages = map_pages(mapped_size);
+			if (pages == nullptr)
+			{
+				return nullptr;
+			}
+			large_bytes.fetch_add(mapped_size, std::memory_order_relaxed);
+			large_count.fetch_add(1, std::memory_order_relaxed);
+			requested_bytes.fetch_add(size, std::memory_order_relaxed);
+			return pages;
+		}
+
+		const size_t index = class_index(size);
+		SizeClass& size_class = classes[index];
+		void* buffer;
+		{
+			std::scoped_lock class_lock{ size_class.mutex };
+			Slab* slab = size_class.with_room;
+			if (slab == nullptr)
+			{
+				slab = size_class.spare;
+				size_class.spare = nullptr;
+				if (slab == nullptr)
+				{
+					void* pages = map_aligned(slab_size(index));
+					if (pages == nullptr)
+					{
+						return nullptr;
+					}
+					slab = format_slab(pages, index);
+				}
+				size_class.slab_count.fetch_add(1, std::memory_order_relaxed);
+				link(size_class, slab);
+			}
+
+			if (slab->free_list != nullptr)
+			{
+				buffer = slab->free_list;
+				slab->free_list = *static_cast<void**>(buffer);
+			}
+			else
+			{
+				buffer = slab->untouched;
+				slab->untouched += class_size(index);
+			}
+
+			if (++slab->live == slab->capacity)
+			{
+				unlink(size_class, slab);
+			}
+			size_class.live.fetch_add(1, std::memory_order_relaxed);
+		}
+		requested_bytes.fetch_add(size, std::memory_order_relaxed);
+		return buffer;
+	}
+
+	void ResourceBufferPool::do_deallocate(void* pointer, size_t size,
+		size_t alignment) noexcept
+	{
+		if (pointer == nullptr)
+		{
+			return;
+		}
+		size = std::max<size_t>(size, 1);
+		requested_bytes.fetch_sub(size, std::memory_order_relaxed);
+
+		if (size > MAX_CLASS_SIZE || alignment > SLAB_ALIGNMENT)
+		{
+			const size_t mapped_size = page_rounded(size);
+			unmap_pages(pointer, mapped_size);
+			large_bytes.fetch_sub(mapped_size, std::memory_order_relaxed);
+			large_count.fetch_sub(1, std::memory_order_relaxed);
+			return;
+		}
+
+		const size_t index = class_index(size);
+		SizeClass& size_class = classes[index];
+		Slab* slab = reinterpret_cast<Slab*>(
+			reinterpret_cast<uintptr_t>(pointer) & ~(slab_size(index) - 1));
+		Slab* release = nullptr;
+		{
+			std::scoped_lock class_lock{ size_class.mutex };
+			*static_cast<void**>(pointer) = slab->free_list;
+			slab->free_list = pointer;
+			size_class.live.fetch_sub(1, std::memory_order_relaxed);
+
+			if (--slab->live == 0)
+			{
+				if (slab->listed)
+				{
+					unlink(size_class, slab);
+				}
+				size_class.slab_count.fetch_sub(1, std::memory_order_relaxed);
+				if (size_class.spare == nullptr)
+				{
+					//NOTE(ches) the spare starts over from scratch, so its
+					// free list doesn't have to be kept, and everything past
+					// the header can go back to the system
+					size_class.spare = format_slab(slab, index);
+					discard_pages(reinterpret_cast<char*>(slab) + PAGE_SIZE,
+						slab_size(index) - PAGE_SIZE);
+				}
+				else
+				{
+					release = slab;
+				}
+			}
+			else if (!slab->listed)
+			{
+				link(size_class, slab);
+			}
+		}
+
+		if (release != nullptr)
+		{
+			unmap_pages(release, slab_size(index));
+		}
+	}
+
+	bool ResourceBufferPool::do_is_equal(
+		const std::pmr::memory_resource& other) const noexcept
+	{
+		return this == &other;
+	}
+
+	[[nodiscard]]
+	ResourceBufferPoolStats ResourceBufferPool::get_stats() const noexcept
+	{
+		ResourceBufferPoolStats stats;
+		for (size_t i = 0; i < CLASS_COUNT; ++i)
+		{
+			const size_t slabs =
+				classes[i].slab_count.load(std::memory_order_relaxed);
+			stats.slab_count += slabs;
+			stats.mapped_bytes += slabs * slab_size(i);
+			stats.allocated_bytes +=
+				classes[i].live.load(std::memory_order_relaxed)
+				* class_size(i);
+		}
+		stats.large_count = large_count.load(std::memory_order_relaxed);
+		const size_t large = large_bytes.load(std::memory_order_relaxed);
+		stats.allocated_bytes += large;
+		stats.mapped_bytes += large;
+		stats.requested_bytes =
+			requested_bytes.load(std::memory_order_relaxed);
+		return stats;
+	}
+}
@@ -1,284 +1,1720 @@
 #include "resource/resource_cache.h"
 
 #include <algorithm>
+#include <bit>
 #include <cstring>
+#include <deque>
+#include <fstream>
 
 #include "debug/logger.h"
 #include "main/memory_utils.h"
+#include "pbr/math/hash.h"
+#include "resource/compressed_resource_loader.h"
 #include "resource/default_resource_loader.h"
 
 namespace loquat
 {
+	namespace
+	{
+		/// <summary>
+		/// The most queued loads an I/O thread reads as one batch.
+		/// </summary>
+		constexpr size_t MAX_READ_BATCH = 64;
+
+		/// <summary>
+		/// Add to a counter that only one thread changes at a time, but that
+		/// others may read. This skips the locked add a fetch_add would need.
+		/// </summary>
+		void bump(std::atomic<uint64_t>& counter, const uint64_t amount = 1)
+			noexcept
+		{
+			counter.store(counter.load(std::memory_order_relaxed) + amount,
+				std::memory_order_relaxed);
+		}
+
+		/// <summary>
+		/// Set on the cache's own I/O and compute threads, where a load can
+		/// wait for memory to be freed without stalling whoever asked for it.
+		/// </summary>
+		thread_local bool on_loader_thread = false;
+	}
+
+	[[nodiscard]]
+	ResourceCache::Shard& ResourceCache::shard_for(std::string_view name)
+		const noexcept
+	{
+		//NOTE(ches) the hash maps use the low bits to pick buckets, so we
+		// pick shards with the high bits to keep the two independent
+		const size_t hash = ResourceNameHash{}(name);
+		return shards[(hash >> (sizeof(size_t) * 4)) & (shard_count - 1)];
+	}
+
+	void ResourceCache::insert(Shard& shard,
+		std::shared_ptr<ResourceHandle> handle) noexcept
+	{
+		shard.eviction_policy->insert(handle.get());
+		shard.resources[handle->resource.name] = handle;
+	}
+
+	std::shared_ptr<ResourceHandle> ResourceCache::remove(Shard& shard,
+		ResourceHandleMap::iterator entry) noexcept
+	{
+		std::shared_ptr<ResourceHandle> handle = std::move(entry->second);
+		shard.resources.erase(entry);
+		if (handle->pin_count == 0)
+		{
+			shard.eviction_policy->remove(handle.get());
+		}
+		note_evicted_held(shard, handle);
+		return handle;
+	}
+
+	std::shared_ptr<ResourceHandle> ResourceCache::evict_one(Shard& shard)
+		noexcept
+	{
+		ResourceHandle* target = shard.eviction_policy->evict();
+		if (target == nullptr)
+		{
+			return std::shared_ptr<ResourceHandle>();
+		}
+
+		auto entry = shard.resources.find(target->resource.name);
+		LOG_ASSERT(entry != shard.resources.end()
+			&& "Evicted handle is not indexed");
+		std::shared_ptr<ResourceHandle> handle = std::move(entry->second);
+		shard.resources.erase(entry);
+		bump(shard.evictions);
+		bump(shard.bytes_evicted, handle->charged_size);
+		note_evicted_held(shard, handle);
+		return handle;
+	}
+
+	void ResourceCache::note_evicted_held(Shard& shard,
+		const std::shared_ptr<ResourceHandle>& handle) noexcept
+	{
+		//NOTE(ches) the caller has one reference, so anything more is
+		// someone outside the cache
+		if (handle.use_count() <= 1 || handle->charged_size == 0)
+		{
+			return;
+		}
+
+		shard.evicted_held.push_back(handle);
+		if (shard.evicted_held.size() >= shard.evicted_sweep_size)
+		{
+			std::erase_if(shard.evicted_held,
+				[](const std::weak_ptr<ResourceHandle>& held)
+				{
+					return held.expired();
+				});
+			shard.evicted_sweep_size = std::max<size_t>(64,
+				shard.evicted_held.size() * 2);
+		}
+	}
+
 	bool ResourceCache::make_room(size_t size) noexcept
 	{
-		if (size > cache_size)
+		if (size > hard_limit.load(std::memory_order_relaxed))
+		{
+			return false;
+		}
+
+		bool waited = false;
+		std::chrono::steady_clock::time_point deadline;
+
+		//NOTE(ches) this reserves the space as well, so two threads can't
+		// both claim the last free bytes
+		size_t current = allocated.load();
+		while (true)
+		{
+			if (current <= cache_size && size <= cache_size - current)
+			{
+				if (allocated.compare_exchange_weak(current, current + size))
+				{
+					note_allocated(current + size);
+					return true;
+				}
+				continue;
+			}
+
+			const uint64_t seen = memory_generation.load();
+			if (free_one_resource())
+			{
+				current = allocated.load();
+				continue;
+			}
+
+			//NOTE(ches) everything left is held outside the cache, so only
+			// its owners can give memory back
+			memory_pressure.store(true, std::memory_order_relaxed);
+			const auto timeout = std::chrono::steady_clock::duration(
+				backpressure_timeout.load(std::memory_order_relaxed));
+			if (on_loader_thread && timeout.count() > 0)
+			{
+				if (!waited)
+				{
+					waited = true;
+					deadline = std::chrono::steady_clock::now() + timeout;
+					backpressure_waits.fetch_add(1,
+						std::memory_order_relaxed);
+				}
+				if (wait_for_memory(seen, deadline))
+				{
+					current = allocated.load();
+					continue;
+				}
+				backpressure_timeouts.fetch_add(1, std::memory_order_relaxed);
+			}
+			return reserve_over_budget(size);
+		}
+	}
+
+	bool ResourceCache::reserve_over_budget(size_t size) noexcept
+	{
+		const size_t limit = hard_limit.load(std::memory_order_relaxed);
+		size_t current = allocated.load();
+		while (current <= limit && size <= limit - current)
+		{
+			if (allocated.compare_exchange_weak(current, current + size))
+			{
+				note_allocated(current + size);
+				if (current + size > cache_size)
+				{
+					over_budget_loads.fetch_add(1, std::memory_order_relaxed);
+				}
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool ResourceCache::wait_for_memory(const uint64_t seen,
+		const std::chrono::steady_clock::time_point deadline) noexcept
+	{
+		std::unique_lock budget_lock{ budget_mutex };
+		memory_waiters.fetch_add(1);
+		const bool changed = memory_freed.wait_until(budget_lock, deadline,
+			[this, seen]()
+			{
+				return memory_generation.load() != seen
+					|| stopping_loads.load();
+			});
+		memory_waiters.fetch_sub(1);
+		return changed && !stopping_loads.load();
+	}
+
+	void ResourceCache::wake_memory_waiters() noexcept
+	{
+		//NOTE(ches) a waiter registers before it checks the generation, so
+		// either it sees this bump or we see it waiting
+		memory_generation.fetch_add(1);
+		if (memory_waiters.load() > 0)
+		{
+			std::scoped_lock budget_lock{ budget_mutex };
+			memory_freed.notify_all();
+		}
+	}
+
+	void ResourceCache::notify_memory_available(size_t available) noexcept
+	{
+		//NOTE(ches) memory is freed wherever the last handle dies, which may
+		// be under a shard lock, so the callbacks can't run here
+		std::scoped_lock queue_lock{ queued_load_mutex };
+		if (stopping_loads || io_pool == nullptr)
+		{
+			return;
+		}
+		io_pool->enqueue([this, available]()
+			{
+				std::vector<MemoryAvailableCallback> callbacks;
+				{
+					std::scoped_lock subscription_lock{ subscription_mutex };
+					for (const MemorySubscription& subscription
+						: memory_subscriptions)
+					{
+						callbacks.push_back(subscription.callback);
+					}
+				}
+				for (MemoryAvailableCallback& callback : callbacks)
+				{
+					callback(available);
+				}
+			});
+	}
+
+	char* ResourceCache::allocate(size_t size) noexcept
+	{
+		const size_t charge = charge_for(size);
+		if (!make_room(charge))
+		{
+			return nullptr;
+		}
+
+		char* memory = static_cast<char*>(buffer_pool.allocate(size));
+		if (!memory)
+		{
+			allocated -= charge;
+		}
+		return memory;
+	}
+
+	[[nodiscard]]
+	size_t ResourceCache::charge_for(size_t size) noexcept
+	{
+		return ResourceBufferPool::rounded_size(size);
+	}
+
+	void ResourceCache::release_buffer(char* buffer, size_t size) noexcept
+	{
+		buffer_pool.deallocate(buffer, size);
+	}
+
+	void ResourceCache::free(std::shared_ptr<ResourceHandle> resource) noexcept
+	{
+		Shard& shard = shard_for(resource->resource.name);
+		std::shared_ptr<ResourceHandle> cache_reference;
+		{
+			std::scoped_lock shard_lock{ shard.mutex };
+			auto entry = shard.resources.find(resource->resource.name);
+			if (entry != shard.resources.end() && entry->second == resource)
+			{
+				cache_reference = remove(shard, entry);
+			}
+		}
+	}
+
+	std::shared_ptr<ResourceLoader> ResourceCache::find_loader(
+		const Resource& resource) noexcept
+	{
+		return resource_loaders.find(resource.name);
+	}
+
+	[[nodiscard]]
+	bool ResourceCache::map_raw(const Resource& resource, RawResource& raw)
+		noexcept
+	{
+		ResourceMapping mapping = file->map_resource(resource);
+		if (mapping.data == nullptr)
+		{
+			return false;
+		}
+		raw.buffer = mapping.data;
+		raw.size = mapping.size;
+		raw.allocation_size = mapping.size;
+		raw.mapping = std::move(mapping.owner);
+		bytes_read.fetch_add(raw.size, std::memory_order_relaxed);
+		return true;
+	}
+
+	[[nodiscard]]
+	bool ResourceCache::prepare_raw(const Resource& resource,
+		ResourceLoader& loader, RawResource& raw) noexcept
+	{
+		//NOTE(ches) mapped data can't have a null appended, and loaders that
+		// hold on to the raw buffer need memory they own, so those always
+		// get a copy
+		if (!loader.append_null() && (loader.use_raw_file()
+			|| loader.discard_raw_buffer_after_load())
+			&& map_raw(resource, raw))
+		{
+			return true;
+		}
+
+		raw.size = file->get_raw_resource_size(resource);
+
+		if (raw.size == 0)
+		{
+			LOG_WARNING("Resource " + resource.name + " not found");
+			return false;
+		}
+
+		raw.allocation_size = raw.size;
+		if (loader.append_null())
+		{
+			++raw.allocation_size;
+		}
+
+		raw.counted = loader.use_raw_file();
+		raw.buffer = raw.counted ? allocate(raw.allocation_size)
+			: static_cast<char*>(buffer_pool.allocate(raw.allocation_size));
+		if (raw.buffer == nullptr)
+		{
+			raw = RawResource();
+			return false;
+		}
+		memset(raw.buffer, 0, raw.allocation_size);
+		return true;
+	}
+
+	ResourceCache::RawResource ResourceCache::read_raw(
+		const Resource& resource, ResourceLoader& loader) noexcept
+	{
+		RawResource raw;
+		size_t read_size = 0;
+		for (int attempt = 0; attempt < 2 && read_size == 0; ++attempt)
+		{
+			if (!prepare_raw(resource, loader, raw))
+			{
+				return RawResource();
+			}
+			if (raw.mapping)
+			{
+				return raw;
+			}
+
+			{
+				ScopedLatency timer{ file_read_latency };
+				read_size = file->load_resource(resource, raw.buffer);
+			}
+			if (read_size == 0)
+			{
+				//NOTE(ches) a file that grew since it was sized won't fit,
+				// but the file knows its new size now, so try once more
+				const size_t sized = raw.size;
+				release_raw(raw);
+				if (file->get_raw_resource_size(resource) == sized)
+				{
+					return RawResource();
+				}
+			}
+		}
+		if (read_size == 0)
+		{
+			return RawResource();
+		}
+
+		//NOTE(ches) a file that shrank since it was sized reads short, and
+		// the rest of the buffer is left zeroed
+		raw.size = std::min(raw.size, read_size);
+		bytes_read.fetch_add(read_size, std::memory_order_relaxed);
+		return raw;
+	}
+
+	void ResourceCache::release_raw(RawResource& raw) noexcept
+	{
+		if (raw.mapping)
+		{
+			raw = RawResource();
+			return;
+		}
+
+		release_buffer(raw.buffer, raw.allocation_size);
+		if (raw.counted)
+		{
+			memory_has_been_freed(charge_for(raw.allocation_size));
+		}
+		raw = RawResource();
+	}
+
+	std::shared_ptr<ResourceHandle> ResourceCache::process_raw(
+		Resource& resource, ResourceLoader& loader, RawResource raw) noexcept
+	{
+		//NOTE(ches) the output is only saved once the raw buffer has gone,
+		// so loaders that keep pointing into it can't be cached
+		const std::string derived_version = derived_data != nullptr
+			&& !loader.use_raw_file() && loader.discard_raw_buffer_after_load()
+			? loader.get_derived_data_version() : std::string();
+
+		std::vector<std::string> dependencies;
+		loader.get_dependencies(raw.buffer, raw.size, dependencies);
+
+		ContentKey content_key{ 0, raw.size, &loader };
+		if (deduplicate || !derived_version.empty())
+		{
+			content_key.hash = murmur_hash_64A(
+				reinterpret_cast<const unsigned char*>(raw.buffer), raw.size,
+				0);
+		}
+
+		if (deduplicate)
+		{
+			std::shared_ptr<ResourceHandle> shared =
+				share_content(resource, content_key);
+			if (shared)
+			{
+				release_raw(raw);
+				shared->dependencies = std::move(dependencies);
+				return shared;
+			}
+		}
+
+		std::shared_ptr<ResourceHandle> handle = run_loader(resource, loader,
+			std::move(raw), content_key.hash, derived_version);
+		if (handle)
+		{
+			handle->dependencies = std::move(dependencies);
+		}
+		if (handle && deduplicate)
+		{
+			index_content(content_key, handle);
+		}
+		return handle;
+	}
+
+	std::shared_ptr<ResourceHandle> ResourceCache::run_loader(
+		Resource& resource, ResourceLoader& loader, RawResource raw,
+		const uint64_t content_hash, const std::string& derived_version)
+		noexcept
+	{
+		std::shared_ptr<ResourceHandle> handle;
+		const size_t raw_size = raw.size;
+
+		if (loader.use_raw_file() && raw.mapping)
+		{
+			//NOTE(ches) every page of the mapping faults in as it is read,
+			// so it is charged in full even if none of it is resident yet
+			if (!make_room(raw.size))
+			{
+				release_raw(raw);
+				return std::shared_ptr<ResourceHandle>();
+			}
+			handle = std::shared_ptr<ResourceHandle>(
+				alloc<ResourceHandle>(resource, raw.buffer, raw.size, this));
+			handle->charged_size = raw.size;
+			handle->mapping = std::move(raw.mapping);
+			handle->reload_cost = loader.get_reload_cost(raw_size, raw_size);
+			return handle;
+		}
+
+		if (loader.use_raw_file())
+		{
+			handle = std::shared_ptr<ResourceHandle>(
+				alloc<ResourceHandle>(resource, raw.buffer, raw.size, this));
+			handle->charged_size = charge_for(raw.allocation_size);
+			handle->buffer_size = raw.allocation_size;
+			handle->reload_cost = loader.get_reload_cost(raw_size, raw_size);
+			return handle;
+		}
+
+		DerivedDataKey derived_key;
+		if (!derived_version.empty())
+		{
+			derived_key = DerivedDataCache::make_key(content_hash, raw.size,
+				derived_version);
+			ResourceMapping derived = derived_data->find(derived_key);
+			if (derived.data != nullptr)
+			{
+				release_raw(raw);
+				if (!make_room(derived.size))
+				{
+					return std::shared_ptr<ResourceHandle>();
+				}
+				handle = std::shared_ptr<ResourceHandle>(alloc<ResourceHandle>(
+					resource, derived.data, derived.size, this));
+				handle->charged_size = derived.size;
+				handle->mapping = std::move(derived.owner);
+				//NOTE(ches) reloading only reads and hashes the raw data as
+				// long as the output stays on disk
+				handle->reload_cost = loader.ResourceLoader::get_reload_cost(
+					raw_size, derived.size);
+				return handle;
+			}
+		}
+
+		const size_t size = loader.get_loaded_resource_size(raw.buffer,
+			raw.size);
+		char* buffer = allocate(size);
+		if (buffer == nullptr)
+		{
+			release_raw(raw);
+			return std::shared_ptr<ResourceHandle>();
+		}
+		handle = std::shared_ptr<ResourceHandle>(
+			alloc<ResourceHandle>(resource, buffer, size, this));
+		handle->charged_size = charge_for(size);
+		handle->reload_cost = loader.get_reload_cost(raw_size, size);
+
+		bool success;
+		{
+			ScopedLatency timer{ loader_latency };
+			success = loader.load_resource(raw.buffer, raw.size, handle);
+		}
+
+		if (loader.discard_raw_buffer_after_load())
+		{
+			release_raw(raw);
+		}
+
+		if (!success)
+		{
+			return std::shared_ptr<ResourceHandle>();
+		}
+		if (!derived_version.empty() && size > 0)
+		{
+			derived_data->store(derived_key, buffer, size);
+		}
+		return handle;
+	}
+
+	[[nodiscard]]
+	std::shared_ptr<ResourceHandle> ResourceCache::share_content(
+		Resource& resource, const ContentKey& key) noexcept
+	{
+		std::shared_ptr<ResourceHandle> original;
+		{
+			std::scoped_lock content_lock{ content_mutex };
+			auto entry = content_index.find(key);
+			if (entry == content_index.end())
+			{
+				return std::shared_ptr<ResourceHandle>();
+			}
+			original = entry->second.lock();
+			if (!original)
+			{
+				content_index.erase(entry);
+				return std::shared_ptr<ResourceHandle>();
+			}
+		}
+
+		//NOTE(ches) extra data can depend on more than the contents, like
+		// the name, so resources with any are loaded on their own
+		if (original->extra)
+		{
+			return std::shared_ptr<ResourceHandle>();
+		}
+
+		//NOTE(ches) a 64 bit hash plus the size makes a false match far
+		// less likely than the disk handing us bad bytes, so we don't
+		// compare the contents
+		std::shared_ptr<ResourceHandle> handle(alloc<ResourceHandle>(
+			resource, original->buffer, original->size, this));
+		handle->charged_size = 0;
+		handle->reload_cost = original->reload_cost;
+		handle->shared_buffer.store(true, std::memory_order_relaxed);
+		deduplicated_loads.fetch_add(1, std::memory_order_relaxed);
+		deduplicated_bytes.fetch_add(original->charged_size,
+			std::memory_order_relaxed);
+		handle->mapping = std::move(original);
+		return handle;
+	}
+
+	void ResourceCache::index_content(const ContentKey& key,
+		const std::shared_ptr<ResourceHandle>& handle) noexcept
+	{
+		if (handle->extra)
+		{
+			return;
+		}
+
+		//NOTE(ches) marked before anyone else can find it, so nobody gets
+		// to write to a buffer another name is already reading
+		handle->shared_buffer.store(true, std::memory_order_relaxed);
+
+		std::scoped_lock content_lock{ content_mutex };
+		content_index[key] = handle;
+
+		//NOTE(ches) entries are only dropped when they are found dead, so
+		// every so often we sweep the ones nobody has asked for again
+		if (content_index.size() > content_sweep_size)
+		{
+			std::erase_if(content_index, [](const auto& entry)
+				{
+					return entry.second.expired();
+				});
+			content_sweep_size = std::max<size_t>(64,
+				content_index.size() * 2);
+		}
+	}
+
+	std::shared_ptr<ResourceHandle> ResourceCache::load_streamed(
+		Resource& resource, ResourceLoader& loader) noexcept
+	{
+		std::shared_ptr<ResourceStream> stream = file->open_stream(resource);
+		if (!stream)
+		{
+			LOG_WARNING("Resource " + resource.name + " not found");
+			return std::shared_ptr<ResourceHandle>();
+		}
+
+		const size_t size = loader.get_streamed_resource_size(*stream);
+		char* buffer = allocate(size);
+		if (buffer == nullptr)
+		{
+			return std::shared_ptr<ResourceHandle>();
+		}
+		std::shared_ptr<ResourceHandle> handle(
+			alloc<ResourceHandle>(resource, buffer, size, this));
+		handle->charged_size = charge_for(size);
+		handle->reload_cost = loader.get_reload_cost(stream->get_size(), size);
+
+		bool success;
+		{
+			ScopedLatency timer{ loader_latency };
+			success = loader.load_stream(*stream, handle);
+		}
+		bytes_read.fetch_add(stream->tell(), std::memory_order_relaxed);
+		if (!success)
+		{
+			LOG_ERROR("Could not stream " + resource.name);
+			return std::shared_ptr<ResourceHandle>();
+		}
+		return handle;
+	}
+
+	std::shared_ptr<ResourceHandle> ResourceCache::load(Resource* resource) noexcept
+	{
+		std::shared_ptr<ResourceLoader> loader = find_loader(*resource);
+
+		if (!loader)
+		{
+			LOG_ERROR("Default resource loader was not found!");
+			return std::shared_ptr<ResourceHandle>();
+		}
+
+		if (loader->use_stream())
+		{
+			RawResource raw;
+			if (!loader->prefer_mapped_raw() || !map_raw(*resource, raw))
+			{
+				return load_streamed(*resource, *loader);
+			}
+			return process_raw(*resource, *loader, std::move(raw));
+		}
+
+		RawResource raw = read_raw(*resource, *loader);
+		if (raw.buffer == nullptr)
+		{
+			return std::shared_ptr<ResourceHandle>();
+		}
+		return process_raw(*resource, *loader, raw);
+	}
+
+	ResourceCache::Lookup ResourceCache::lookup_or_claim(Shard& shard,
+		const Resource& resource) noexcept
+	{
+		Lookup lookup;
+		std::scoped_lock shard_lock{ shard.mutex };
+
+		auto result = shard.resources.find(resource.name);
+		if (result != shard.resources.end())
+		{
+			if (result->second->pin_count == 0)
+			{
+				shard.eviction_policy->touch(result->second.get());
+			}
+			bump(shard.hits);
+			lookup.handle = result->second;
+			return lookup;
+		}
+
+		auto in_flight = shard.pending.find(resource.name);
+		if (in_flight != shard.pending.end())
+		{
+			bump(shard.joined);
+			lookup.in_flight = in_flight->second;
+			return lookup;
+		}
+
+		bump(shard.misses);
+		lookup.claim = std::make_shared<ResourceHandlePromise>();
+		lookup.in_flight = lookup.claim->get_future().share();
+		shard.pending.emplace(resource.name, lookup.in_flight);
+		return lookup;
+	}
+
+	void ResourceCache::complete_load(Shard& shard, const Resource& resource,
+		std::shared_ptr<ResourceHandle> handle,
+		ResourceHandlePromise& promise) noexcept
+	{
+		{
+			std::scoped_lock shard_lock{ shard.mutex };
+			if (handle)
+			{
+				insert(shard, handle);
+				bump(shard.bytes_loaded, handle->get_size());
+			}
+			else
+			{
+				bump(shard.failed_loads);
+			}
+			shard.pending.erase(resource.name);
+		}
+		promise.set_value(handle);
+
+		if (handle)
+		{
+			for (const std::string& dependency : handle->dependencies)
+			{
+				prefetch(Resource{ dependency });
+			}
+		}
+	}
+
+	std::shared_ptr<ResourceHandle> ResourceCache::find(Resource* resource) noexcept
+	{
+		Shard& shard = shard_for(resource->name);
+		std::scoped_lock shard_lock{ shard.mutex };
+		auto result = shard.resources.find(resource->name);
+		if (result == shard.resources.end())
+		{
+			return std::shared_ptr<ResourceHandle>();
+		}
+		return result->second;
+	}
+
+	void ResourceCache::update(std::shared_ptr<ResourceHandle> handle) noexcept
+	{
+		Shard& shard = shard_for(handle->resource.name);
+		std::scoped_lock shard_lock{ shard.mutex };
+		auto entry = shard.resources.find(handle->resource.name);
+		if (entry != shard.resources.end() && entry->second == handle
+			&& handle->pin_count == 0)
+		{
+			shard.eviction_policy->touch(handle.get());
+		}
+	}
+
+	bool ResourceCache::free_one_resource() noexcept
+	{
+		for (size_t attempt = 0; attempt < shard_count; ++attempt)
+		{
+			const size_t index = eviction_cursor.fetch_add(1,
+				std::memory_order_relaxed) & (shard_count - 1);
+			Shard& shard = shards[index];
+
+			std::shared_ptr<ResourceHandle> evicted;
+			{
+				std::scoped_lock shard_lock{ shard.mutex };
+				evicted = evict_one(shard);
+			}
+			if (evicted)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void ResourceCache::memory_has_been_freed(size_t size) noexcept
+	{
+		const size_t remaining = allocated.fetch_sub(size) - size;
+		wake_memory_waiters();
+
+		//NOTE(ches) waiting for some headroom keeps subscribers from being
+		// told about every handle that dies while the cache is full
+		if (memory_pressure.load(std::memory_order_relaxed)
+			&& remaining <= cache_size - cache_size / 8
+			&& memory_pressure.exchange(false))
+		{
+			notify_memory_available(cache_size - remaining);
+		}
+	}
+
+	void ResourceCache::note_allocated(size_t total) noexcept
+	{
+		size_t peak = peak_allocated.load(std::memory_order_relaxed);
+		while (total > peak && !peak_allocated.compare_exchange_weak(peak,
+			total, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	ResourceCache::ResourceCache(const size_t size_in_MB, ResourceFile* file,
+		const size_t shard_count,
+		const ResourceEvictionPolicyType eviction_policy) noexcept
+		: shards{ std::make_unique<Shard[]>(
+			std::bit_ceil(std::max<size_t>(shard_count, 1))) }
+		, shard_count{ std::bit_ceil(std::max<size_t>(shard_count, 1)) }
+		, eviction_cursor{ 0 }
+		, file{ file }
+		, cache_size{ size_in_MB * 1024 * 1024 }
+		, allocated{ 0 }
+		, hard_limit{ size_in_MB * 1024 * 1024 }
+		, backpressure_timeout{ std::chrono::duration_cast<
+			std::chrono::steady_clock::duration>(
+				std::chrono::milliseconds(100)).count() }
+		, memory_generation{ 0 }
+		, memory_waiters{ 0 }
+		, memory_pressure{ false }
+		, backpressure_waits{ 0 }
+		, backpressure_timeouts{ 0 }
+		, over_budget_loads{ 0 }
+		, peak_allocated{ 0 }
+		, bytes_read{ 0 }
+		, derived_data{ nullptr }
+		, deduplicate{ false }
+		, content_sweep_size{ 64 }
+		, deduplicated_loads{ 0 }
+		, deduplicated_bytes{ 0 }
+		, io_pool{ nullptr }
+		, compute_pool{ nullptr }
+		, preload_depth{ 16 }
+	{
+		const size_t shard_capacity = cache_size / this->shard_count;
+		for (size_t i = 0; i < this->shard_count; ++i)
+		{
+			shards[i].eviction_policy = make_eviction_policy(eviction_policy,
+				shard_capacity);
+		}
+	}
+
+	ResourceCache::~ResourceCache()
+	{
+		{
+			std::scoped_lock queue_lock{ queued_load_mutex };
+			stopping_loads = true;
+		}
+		{
+			std::scoped_lock budget_lock{ budget_mutex };
+			memory_freed.notify_all();
+		}
+
+		//NOTE(ches) I/O jobs queue compute jobs, so that pool has to finish
+		// first
+		safe_delete(io_pool);
+		safe_delete(compute_pool);
+
+		if (!stats_dump_path.empty())
+		{
+			std::ofstream dump{ stats_dump_path };
+			if (dump)
+			{
+				dump << get_stats().to_string()
+					<< get_pin_report().to_string();
+			}
+			else
+			{
+				LOG_WARNING("Could not write resource cache stats to "
+					+ stats_dump_path);
+			}
+		}
+
+		flush();
+		for (size_t i = 0; i < shard_count; ++i)
+		{
+			//NOTE(ches) only pinned handles are left, and they have to go
+			// while the cache can still be told their memory was freed
+			shards[i].resources.clear();
+			safe_delete(shards[i].eviction_policy);
+		}
+		safe_delete(derived_data);
+		safe_delete(file);
+	}
+
+	bool ResourceCache::init(const size_t io_thread_count,
+		const size_t compute_thread_count) noexcept
+	{
+		if (file->open())
 		{
-			return false;
+			register_loader(std::shared_ptr<ResourceLoader>(
+				alloc<DefaultResourceLoader>()));
+			register_loader(std::shared_ptr<ResourceLoader>(
+				alloc<CompressedResourceLoader>()));
+			io_pool = alloc<ThreadPool>(io_thread_count);
+			compute_pool = alloc<ThreadPool>(compute_thread_count);
+			return true;
 		}
-		while (size > (cache_size - allocated))
+		return false;
+	}
+
+	void ResourceCache::register_loader(std::shared_ptr<ResourceLoader> loader) noexcept
+	{
+		resource_loaders.add(loader);
+	}
+
+	void ResourceCache::set_eviction_policy(
+		const ResourceEvictionPolicyType type) noexcept
+	{
+		set_eviction_policy([type](size_t capacity)
+			{
+				return make_eviction_policy(type, capacity);
+			});
+	}
+
+	void ResourceCache::set_eviction_policy(
+		const ResourceEvictionPolicyFactory& factory) noexcept
+	{
+		const size_t shard_capacity = cache_size / shard_count;
+		for (size_t i = 0; i < shard_count; ++i)
 		{
-			if (lru_list.empty())
+			Shard& shard = shards[i];
+			ResourceEvictionPolicy* replacement = factory(shard_capacity);
+
+			std::scoped_lock shard_lock{ shard.mutex };
+			while (ResourceHandle* handle = shard.eviction_policy->evict())
 			{
-				//NOTE(ches) We ran out of things that we could free
-				return false;
+				replacement->insert(handle);
 			}
-			free_one_resource();
+			safe_delete(shard.eviction_policy);
+			shard.eviction_policy = replacement;
 		}
-		return true;
 	}
 
-	char* ResourceCache::allocate(size_t size) noexcept
+	void ResourceCache::set_preload_depth(const size_t depth) noexcept
+	{
+		preload_depth = depth;
+	}
+
+	[[nodiscard]]
+	std::shared_ptr<ResourceHandle> ResourceCache::get_handle(Resource* resource) noexcept
 	{
-		if (!make_room(size))
+		Shard& shard = shard_for(resource->name);
+		Lookup lookup = lookup_or_claim(shard, *resource);
+		if (lookup.handle)
 		{
-			return nullptr;
+			return lookup.handle;
+		}
+		if (!lookup.claim)
+		{
+			return lookup.in_flight.get();
 		}
 
-		char* memory = alloc_array<char>(size);
-		if (memory)
+		//NOTE(ches) loading happens outside the lock so other resources in
+		// this shard stay available while we read the file
+		std::shared_ptr<ResourceHandle> handle = load(resource);
+		LOG_ASSERT(handle);
+
+		complete_load(shard, *resource, handle, *lookup.claim);
+		return handle;
+	}
+
+	[[nodiscard]]
+	ResourceHandleFuture ResourceCache::get_handle_async(Resource resource)
+		noexcept
+	{
+		Shard& shard = shard_for(resource.name);
+		Lookup lookup = lookup_or_claim(shard, resource);
+		if (lookup.handle)
 		{
-			allocated += size;
+			ResourceHandlePromise ready;
+			ready.set_value(lookup.handle);
+			return ready.get_future().share();
 		}
-		return memory;
+		if (!lookup.claim)
+		{
+			return lookup.in_flight;
+		}
+
+		queue_load(shard, std::move(resource), lookup.claim);
+		return lookup.in_flight;
 	}
 
-	void ResourceCache::free(std::shared_ptr<ResourceHandle> resource) noexcept
+	void ResourceCache::queue_load(Shard& shard, Resource resource,
+		std::shared_ptr<ResourceHandlePromise> claim) noexcept
 	{
-		lru_list.remove(resource);
-		resources.erase(resource->resource.name);
+		if (io_pool == nullptr || compute_pool == nullptr)
+		{
+			LOG_WARNING("Loading " + resource.name
+				+ " synchronously, the cache has no loader threads");
+			complete_load(shard, resource, load(&resource), *claim);
+			return;
+		}
+
+		{
+			std::unique_lock queue_lock{ queued_load_mutex };
+			if (stopping_loads)
+			{
+				queue_lock.unlock();
+				complete_load(shard, resource, nullptr, *claim);
+				return;
+			}
+			queued_loads.push_back({ &shard, std::move(resource),
+				std::move(claim) });
+
+			//NOTE(ches) whichever I/O thread gets here first takes
+			// everything queued so far as one batch, so a burst of requests
+			// turns into a single deep queue of reads. This stays under the
+			// lock so the pool can't be shut down underneath us.
+			io_pool->enqueue([this]() { load_queued(); });
+		}
 	}
 
-	std::shared_ptr<ResourceHandle> ResourceCache::load(Resource* resource) noexcept
+	void ResourceCache::prefetch(const Resource& resource) noexcept
 	{
-		std::shared_ptr<ResourceLoader> loader;
-		std::shared_ptr<ResourceHandle> handle;
+		//NOTE(ches) without threads a prefetch would just be a load that
+		// nobody waited for, and following dependencies would recurse
+		if (io_pool == nullptr || compute_pool == nullptr)
+		{
+			return;
+		}
+
+		Shard& shard = shard_for(resource.name);
+		std::shared_ptr<ResourceHandlePromise> claim;
+		{
+			std::scoped_lock shard_lock{ shard.mutex };
+			if (shard.resources.contains(resource.name)
+				|| shard.pending.contains(resource.name))
+			{
+				return;
+			}
+			bump(shard.prefetches);
+			claim = std::make_shared<ResourceHandlePromise>();
+			shard.pending.emplace(resource.name,
+				claim->get_future().share());
+		}
+		queue_load(shard, resource, std::move(claim));
+	}
 
-		for (ResourceLoaders::iterator it = resource_loaders.begin();
-			it != resource_loaders.end(); ++it)
+	[[nodiscard]]
+	ResourceGraph ResourceCache::load_graph(
+		const std::vector<Resource>& roots) noexcept
+	{
+		ResourceGraph graph;
+		std::vector<ResourceHandleFuture> futures;
+		std::unordered_map<std::string, size_t, ResourceNameHash,
+			std::equal_to<>> node_index;
+
+		auto add_node = [&](const std::string& name) -> size_t
+			{
+				auto [entry, added] = node_index.try_emplace(name,
+					graph.nodes.size());
+				if (added)
+				{
+					graph.nodes.push_back({ name, nullptr, {} });
+					futures.push_back(get_handle_async(Resource{ name }));
+				}
+				return entry->second;
+			};
+
+		for (const Resource& root : roots)
 		{
-			std::shared_ptr<ResourceLoader> temp = *it;
+			add_node(root.name);
+		}
 
-			if (wildcard_match(temp->get_pattern().c_str(),
-				resource->name.c_str()))
+		//NOTE(ches) nodes are waited on in the order they were found, and
+		// each one's dependencies are asked for as soon as it is in. Loading
+		// a node has already prefetched its dependencies, so by the time we
+		// ask, they are usually in flight or done.
+		for (size_t i = 0; i < graph.nodes.size(); ++i)
+		{
+			std::shared_ptr<ResourceHandle> handle = futures[i].get();
+			if (!handle)
 			{
-				loader = temp;
-				break;
+				continue;
 			}
+			for (const std::string& dependency : handle->dependencies)
+			{
+				const size_t index = add_node(dependency);
+				graph.nodes[i].dependencies.push_back(index);
+			}
+			graph.nodes[i].handle = std::move(handle);
 		}
+		return graph;
+	}
 
-		if (!loader)
+	void ResourceCache::load_queued() noexcept
+	{
+		on_loader_thread = true;
+		std::vector<QueuedLoad> loads;
 		{
-			LOG_ERROR("Default resource loader was not found!");
-			return handle;
+			std::scoped_lock queue_lock{ queued_load_mutex };
+			const size_t count = std::min(queued_loads.size(),
+				MAX_READ_BATCH);
+			loads.reserve(count);
+			for (size_t i = 0; i < count; ++i)
+			{
+				loads.push_back(std::move(queued_loads.front()));
+				queued_loads.pop_front();
+			}
+		}
+		if (loads.empty())
+		{
+			return;
 		}
 
-		size_t raw_size = file->get_raw_resource_size(*resource);
+		struct BatchEntry
+		{
+			QueuedLoad* load;
+			std::shared_ptr<ResourceLoader> loader;
+			RawResource raw;
+		};
+
+		std::vector<BatchEntry> entries;
+		std::vector<ResourceRead> reads;
+		entries.reserve(loads.size());
+		reads.reserve(loads.size());
 
-		if (raw_size == 0)
+		for (QueuedLoad& load : loads)
 		{
-			LOG_WARNING("Resource " + resource->name + " not found");
+			std::shared_ptr<ResourceLoader> loader =
+				find_loader(load.resource);
+			if (!loader)
+			{
+				LOG_ERROR("Default resource loader was not found!");
+				complete_load(*load.shard, load.resource, nullptr,
+					*load.claim);
+				continue;
+			}
 
-			return std::shared_ptr<ResourceHandle>();
+			//NOTE(ches) streaming loaders read as they go, so they stay on
+			// this thread rather than tying up a compute thread on the disk,
+			// unless they would rather have the file mapped
+			RawResource raw;
+			if (loader->use_stream() && (!loader->prefer_mapped_raw()
+				|| !map_raw(load.resource, raw)))
+			{
+				complete_load(*load.shard, load.resource,
+					load_streamed(load.resource, *loader), *load.claim);
+				continue;
+			}
+
+			if (!raw.mapping && !prepare_raw(load.resource, *loader, raw))
+			{
+				complete_load(*load.shard, load.resource, nullptr,
+					*load.claim);
+				continue;
+			}
+			if (!raw.mapping)
+			{
+				reads.push_back({ &load.resource, 0, raw.size, raw.buffer });
+			}
+			entries.push_back({ &load, std::move(loader), std::move(raw) });
 		}
 
-		size_t allocation_size = raw_size;
-		if (loader->append_null())
+		if (!reads.empty())
 		{
-			++allocation_size;
+			ScopedLatency timer{ file_read_latency };
+			file->load_batch(reads);
 		}
 
-		char* raw_buffer = loader->use_raw_file() ? allocate(allocation_size) 
-			: alloc_array<char>(allocation_size);
-		memset(raw_buffer, 0, allocation_size);
+		size_t next_read = 0;
+		for (BatchEntry& entry : entries)
+		{
+			QueuedLoad& load = *entry.load;
+			if (!entry.raw.mapping)
+			{
+				const ResourceRead& read = reads[next_read++];
+				bytes_read.fetch_add(read.bytes_read,
+					std::memory_order_relaxed);
+				if (read.bytes_read != read.length)
+				{
+					release_raw(entry.raw);
+					complete_load(*load.shard, load.resource, nullptr,
+						*load.claim);
+					continue;
+				}
+			}
+
+			//NOTE(ches) hand the CPU side work off, so this thread can go
+			// back to waiting on the disk
+			compute_pool->enqueue([this, shard = load.shard,
+				resource = std::move(load.resource), claim = load.claim,
+				loader = entry.loader, raw = entry.raw]() mutable
+				{
+					on_loader_thread = true;
+					std::shared_ptr<ResourceHandle> handle =
+						process_raw(resource, *loader, raw);
+					complete_load(*shard, resource, handle, *claim);
+				});
+		}
+	}
 
-		if (raw_buffer == nullptr
-			|| file->load_resource(*resource, raw_buffer) == 0)
+	int ResourceCache::preload(const std::string pattern,
+		ProgressCallback callback) noexcept
+	{
+		if (file == nullptr)
 		{
-			return std::shared_ptr<ResourceHandle>();
+			return 0;
 		}
 
-		char* buffer = nullptr;
-		size_t size = 0;
-		if (loader->use_raw_file())
+		struct PreloadEntry
 		{
-			buffer = raw_buffer;
-			handle = std::shared_ptr<ResourceHandle>(
-				alloc<ResourceHandle>(*resource, buffer, raw_size, this));
+			Resource resource;
+			size_t size;
+			size_t offset;
+		};
+
+		std::vector<PreloadEntry> entries;
+		size_t total_bytes = 0;
+		const std::shared_ptr<const ResourceNameTable> names =
+			get_name_table();
+		for (const uint32_t index : names->match(GlobPattern{ pattern },
+			false))
+		{
+			Resource resource(std::string(names->get_name(index)));
+			const size_t size = file->get_raw_resource_size(resource);
+			const size_t offset = file->get_resource_offset(resource);
+			total_bytes += size;
+			entries.push_back({ std::move(resource), size, offset });
 		}
-		else
+
+		//NOTE(ches) reading in file order keeps the disk streaming instead
+		// of seeking back and forth
+		std::stable_sort(entries.begin(), entries.end(),
+			[](const PreloadEntry& a, const PreloadEntry& b)
+			{
+				return a.offset < b.offset;
+			});
+
+		struct InFlight
+		{
+			ResourceHandleFuture future;
+			size_t size;
+		};
+
+		std::deque<InFlight> in_flight;
+		const size_t depth = std::max<size_t>(preload_depth, 1);
+		size_t next = 0;
+		size_t bytes_loaded = 0;
+		int loaded = 0;
+		bool cancel = false;
+
+		while (next < entries.size() || !in_flight.empty())
 		{
-			size = loader->get_loaded_resource_size(raw_buffer, raw_size);
-			buffer = allocate(size);
-			if (raw_buffer == nullptr || buffer == nullptr)
+			//NOTE(ches) topping up half the window at a time lets the reads
+			// go out as batches rather than one by one
+			const bool refill = in_flight.size() <= depth / 2;
+			while (refill && !cancel && next < entries.size()
+				&& in_flight.size() < depth)
 			{
-				return std::shared_ptr<ResourceHandle>();
+				PreloadEntry& entry = entries[next++];
+				in_flight.push_back({ get_handle_async(entry.resource),
+					entry.size });
 			}
-			handle = std::shared_ptr<ResourceHandle>(
-				alloc<ResourceHandle>(*resource, buffer, size, this));
 
-			bool success = loader->load_resource(raw_buffer, raw_size, handle);
+			if (in_flight.empty())
+			{
+				break;
+			}
 
-			if (loader->discard_raw_buffer_after_load())
+			InFlight oldest = std::move(in_flight.front());
+			in_flight.pop_front();
+			if (oldest.future.get())
 			{
-				safe_delete_array(raw_buffer);
+				++loaded;
 			}
+			bytes_loaded += oldest.size;
 
-			if (!success)
+			if (callback != nullptr && !cancel)
 			{
-				return std::shared_ptr<ResourceHandle>();
+				callback(bytes_loaded, total_bytes, cancel);
 			}
 		}
+		return loaded;
+	}
 
-		if (handle)
+	[[nodiscard]]
+	ResourceNameMatches ResourceCache::match(std::string_view pattern)
+		noexcept
+	{
+		ResourceNameMatches matches;
+		if (file == nullptr)
 		{
-			lru_list.push_front(handle);
-			resources[resource->name] = handle;
+			return matches;
 		}
 
-		LOG_ASSERT(loader && "Default resource loader was not found!");
-		return handle;
-	}
+		std::string lowered_pattern{ pattern };
+		std::transform(lowered_pattern.begin(), lowered_pattern.end(),
+			lowered_pattern.begin(),
+			[](unsigned char c) { return std::tolower(c); });
 
-	std::shared_ptr<ResourceHandle> ResourceCache::find(Resource* resource) noexcept
-	{
-		auto result = resources.find(resource->name);
-		if (result == resources.end())
+		matches.table = get_name_table();
+		const std::vector<uint32_t> indices =
+			matches.table->match(GlobPattern{ lowered_pattern }, true);
+		matches.names.reserve(indices.size());
+		for (const uint32_t index : indices)
 		{
-			return std::shared_ptr<ResourceHandle>();
+			matches.names.push_back(matches.table->get_lowered_name(index));
 		}
-		return result->second;
+		return matches;
 	}
 
-	void ResourceCache::update(std::shared_ptr<ResourceHandle> handle) noexcept
+	[[nodiscard]]
+	std::shared_ptr<const ResourceNameTable> ResourceCache::get_name_table()
+		noexcept
 	{
-		lru_list.remove(handle);
-		lru_list.push_front(handle);
+		//NOTE(ches) the count catches files that change without being
+		// watched, as long as something was added or removed
+		std::scoped_lock name_table_lock{ name_table_mutex };
+		if (!name_table || name_table->size() != file->get_resource_count())
+		{
+			name_table = std::make_shared<const ResourceNameTable>(*file);
+		}
+		return name_table;
 	}
 
-	void ResourceCache::free_one_resource() noexcept
+	std::shared_ptr<ResourceHandle> ResourceCache::pin(Resource* resource)
+		noexcept
 	{
-		auto target = lru_list.end();
-		--target;
+		std::shared_ptr<ResourceHandle> handle = get_handle(resource);
+		if (!handle)
+		{
+			return handle;
+		}
 
-		std::shared_ptr<ResourceHandle> handle = *target;
+		Shard& shard = shard_for(resource->name);
+		std::scoped_lock shard_lock{ shard.mutex };
+		auto entry = shard.resources.find(resource->name);
+		if (entry == shard.resources.end())
+		{
+			//NOTE(ches) it was evicted before we got the lock, but we still
+			// hold it and it is still charged against the cache, so it can
+			// just go back in, keeping any pins it already had
+			shard.resources.emplace(resource->name, handle);
+			++handle->pin_count;
+			return handle;
+		}
 
-		lru_list.pop_back();
-		resources.erase(handle->resource.name);
+		//NOTE(ches) if it was reloaded in the meantime, pin the new one
+		handle = entry->second;
+		if (handle->pin_count++ == 0)
+		{
+			shard.eviction_policy->remove(handle.get());
+		}
+		return handle;
 	}
 
-	void ResourceCache::memory_has_been_freed(size_t size) noexcept
+	void ResourceCache::unpin(const std::shared_ptr<ResourceHandle>& handle)
+		noexcept
 	{
-		allocated -= size;
-	}
+		Shard& shard = shard_for(handle->resource.name);
+		std::scoped_lock shard_lock{ shard.mutex };
 
-	ResourceCache::ResourceCache(const size_t size_in_MB, ResourceFile* file) noexcept
-		: cache_size{ size_in_MB * 1024 * 1024 }
-		, allocated{ 0 }
-		, file{ file }
-	{}
+		//NOTE(ches) pins move to the new handle when a resource is reloaded,
+		// so the handle we were given may not be the one that is pinned
+		auto entry = shard.resources.find(handle->resource.name);
+		const bool cached = entry != shard.resources.end();
+		ResourceHandle* pinned = cached && entry->second->pin_count > 0
+			? entry->second.get() : handle.get();
+		if (pinned->pin_count == 0)
+		{
+			LOG_WARNING(handle->resource.name + " was unpinned more times "
+				"than it was pinned");
+			return;
+		}
 
-	ResourceCache::~ResourceCache()
+		if (--pinned->pin_count == 0 && cached
+			&& entry->second.get() == pinned)
+		{
+			shard.eviction_policy->insert(pinned);
+			wake_memory_waiters();
+		}
+	}
+
+	void ResourceCache::flush() noexcept
 	{
-		while (!lru_list.empty())
+		for (size_t i = 0; i < shard_count; ++i)
 		{
-			free_one_resource();
+			Shard& shard = shards[i];
+			std::vector<std::shared_ptr<ResourceHandle>> evicted;
+			{
+				std::scoped_lock shard_lock{ shard.mutex };
+				auto entry = shard.resources.begin();
+				while (entry != shard.resources.end())
+				{
+					auto next = std::next(entry);
+					if (entry->second->pin_count == 0)
+					{
+						evicted.push_back(remove(shard, entry));
+					}
+					entry = next;
+				}
+			}
 		}
-		safe_delete(file);
 	}
 
-	bool ResourceCache::init() noexcept
+
+	bool ResourceCache::invalidate(const Resource& resource) noexcept
 	{
-		if (file->open())
+		Shard& shard = shard_for(resource.name);
+		std::shared_ptr<ResourceHandle> cache_reference;
 		{
-			register_loader(std::shared_ptr<ResourceLoader>(
-				alloc<DefaultResourceLoader>()));
-			return true;
+			std::scoped_lock shard_lock{ shard.mutex };
+			auto entry = shard.resources.find(resource.name);
+			if (entry == shard.resources.end())
+			{
+				return false;
+			}
+			cache_reference = remove(shard, entry);
 		}
-		return false;
+		return true;
 	}
 
-	void ResourceCache::register_loader(std::shared_ptr<ResourceLoader> loader) noexcept
+	bool ResourceCache::watch_for_changes() noexcept
 	{
-		resource_loaders.push_front(loader);
+		return file->watch();
 	}
 
 	[[nodiscard]]
-	std::shared_ptr<ResourceHandle> ResourceCache::get_handle(Resource* resource) noexcept
+	std::shared_ptr<ResourceStream> ResourceCache::open_stream(
+		const Resource& resource) noexcept
 	{
-		std::shared_ptr<ResourceHandle> handle = find(resource);
-		if (!handle)
-		{
-			handle = load(resource);
-			LOG_ASSERT(handle);
-		}
-		else
-		{
-			update(handle);
-		}
-		return handle;
+		return file->open_stream(resource);
 	}
 
-	int ResourceCache::preload(const std::string pattern,
-		ProgressCallback callback) noexcept
+	size_t ResourceCache::subscribe(const Resource& resource,
+		ResourceChangedCallback callback) noexcept
 	{
-		if (file == nullptr)
+		std::scoped_lock subscription_lock{ subscription_mutex };
+		const size_t id = next_subscription_id++;
+		subscriptions.push_back({ id, resource.name, std::move(callback) });
+		return id;
+	}
+
+	void ResourceCache::unsubscribe(const size_t subscription) noexcept
+	{
+		std::scoped_lock subscription_lock{ subscription_mutex };
+		std::erase_if(subscriptions,
+			[subscription](const Subscription& existing)
+			{
+				return existing.id == subscription;
+			});
+		std::erase_if(memory_subscriptions,
+			[subscription](const MemorySubscription& existing)
+			{
+				return existing.id == subscription;
+			});
+	}
+
+	size_t ResourceCache::subscribe_memory_available(
+		MemoryAvailableCallback callback) noexcept
+	{
+		std::scoped_lock subscription_lock{ subscription_mutex };
+		const size_t id = next_subscription_id++;
+		memory_subscriptions.push_back({ id, std::move(callback) });
+		return id;
+	}
+
+	size_t ResourceCache::reload_changed() noexcept
+	{
+		std::vector<std::string> changed_names;
+		file->poll_changes(changed_names);
+		if (!changed_names.empty())
 		{
-			return 0;
+			std::scoped_lock name_table_lock{ name_table_mutex };
+			name_table.reset();
 		}
-		const size_t file_count = file->get_resource_count();
-		int loaded = 0;
-		bool cancel = false;
-		for (size_t i = 0; i < file_count; ++i)
+
+		size_t reloaded = 0;
+		for (const std::string& name : changed_names)
 		{
-			Resource resource(file->get_resource_name(i));
+			Resource resource{ name };
+			Shard& shard = shard_for(resource.name);
+			std::shared_ptr<ResourceHandle> previous;
+			{
+				std::scoped_lock shard_lock{ shard.mutex };
+				auto entry = shard.resources.find(resource.name);
+				if (entry != shard.resources.end())
+				{
+					previous = remove(shard, entry);
+				}
+			}
+			const bool was_cached = static_cast<bool>(previous);
 
-			if (wildcard_match(pattern.c_str(), resource.name.c_str()))
+			//NOTE(ches) callbacks are copied out, so they can subscribe and
+			// unsubscribe without deadlocking
+			std::vector<ResourceChangedCallback> callbacks;
 			{
-				std::shared_ptr<ResourceHandle> handle = get_handle(&resource);
-				++loaded;
+				std::scoped_lock subscription_lock{ subscription_mutex };
+				for (const Subscription& subscription : subscriptions)
+				{
+					if (subscription.name == resource.name)
+					{
+						callbacks.push_back(subscription.callback);
+					}
+				}
+			}
+
+			if (!was_cached && callbacks.empty())
+			{
+				continue;
 			}
 
-			if (callback != nullptr)
+			std::shared_ptr<ResourceHandle> handle = get_handle(&resource);
+			if (!handle)
 			{
-				callback(static_cast<int>(i * 100 / file_count), cancel);
+				LOG_WARNING("Could not reload " + resource.name);
+				continue;
+			}
+			++reloaded;
+
+			if (was_cached && previous->pin_count > 0)
+			{
+				std::scoped_lock shard_lock{ shard.mutex };
+				auto entry = shard.resources.find(resource.name);
+				if (entry != shard.resources.end() && entry->second == handle)
+				{
+					if (handle->pin_count == 0)
+					{
+						shard.eviction_policy->remove(handle.get());
+					}
+					handle->pin_count += previous->pin_count;
+					previous->pin_count = 0;
+				}
+			}
+
+			for (ResourceChangedCallback& callback : callbacks)
+			{
+				callback(handle);
 			}
 		}
-		return loaded;
+		return reloaded;
 	}
 
 	[[nodiscard]]
-	std::vector<std::string> ResourceCache::match(std::string_view pattern) noexcept
+	ResourceCacheStats ResourceCache::get_stats() const noexcept
 	{
-		std::vector<std::string> matching_names;
-		if (file == nullptr)
+		ResourceCacheStats stats;
+		for (size_t i = 0; i < shard_count; ++i)
 		{
-			return matching_names;
+			const Shard& shard = shards[i];
+			stats.hits += shard.hits.load(std::memory_order_relaxed);
+			stats.misses += shard.misses.load(std::memory_order_relaxed);
+			stats.joined += shard.joined.load(std::memory_order_relaxed);
+			stats.failed_loads +=
+				shard.failed_loads.load(std::memory_order_relaxed);
+			stats.bytes_loaded +=
+				shard.bytes_loaded.load(std::memory_order_relaxed);
+			stats.evictions += shard.evictions.load(std::memory_order_relaxed);
+			stats.bytes_evicted +=
+				shard.bytes_evicted.load(std::memory_order_relaxed);
+			stats.prefetched +=
+				shard.prefetches.load(std::memory_order_relaxed);
 		}
+		stats.bytes_read = bytes_read.load(std::memory_order_relaxed);
+		stats.allocated = allocated.load(std::memory_order_relaxed);
+		stats.peak_allocated = std::max(stats.allocated,
+			peak_allocated.load(std::memory_order_relaxed));
+		stats.cache_size = cache_size;
+		stats.hard_limit = hard_limit.load(std::memory_order_relaxed);
+		stats.backpressure_waits =
+			backpressure_waits.load(std::memory_order_relaxed);
+		stats.backpressure_timeouts =
+			backpressure_timeouts.load(std::memory_order_relaxed);
+		stats.over_budget_loads =
+			over_budget_loads.load(std::memory_order_relaxed);
+		stats.file_read = file_read_latency.summary();
+		stats.loader = loader_latency.summary();
+		stats.buffers = buffer_pool.get_stats();
+		stats.deduplicated = deduplicated_loads.load(std::memory_order_relaxed);
+		stats.bytes_deduplicated =
+			deduplicated_bytes.load(std::memory_order_relaxed);
+		if (derived_data != nullptr)
+		{
+			stats.derived_hits = derived_data->get_hits();
+			stats.derived_misses = derived_data->get_misses();
+			stats.derived_stores = derived_data->get_stores();
+			stats.derived_disk_size = derived_data->get_disk_size();
+		}
+		return stats;
+	}
+
+	void ResourceCache::reset_stats() noexcept
+	{
+		for (size_t i = 0; i < shard_count; ++i)
+		{
+			//NOTE(ches) the counters are bumped without a locked add, so
+			// zeroing them has to wait for the shard like any other writer
+			Shard& shard = shards[i];
+			std::scoped_lock shard_lock{ shard.mutex };
+			shard.hits.store(0, std::memory_order_relaxed);
+			shard.misses.store(0, std::memory_order_relaxed);
+			shard.joined.store(0, std::memory_order_relaxed);
+			shard.failed_loads.store(0, std::memory_order_relaxed);
+			shard.bytes_loaded.store(0, std::memory_order_relaxed);
+			shard.evictions.store(0, std::memory_order_relaxed);
+			shard.bytes_evicted.store(0, std::memory_order_relaxed);
+			shard.prefetches.store(0, std::memory_order_relaxed);
+		}
+		bytes_read.store(0, std::memory_order_relaxed);
+		peak_allocated.store(allocated.load(std::memory_order_relaxed),
+			std::memory_order_relaxed);
+		file_read_latency.reset();
+		loader_latency.reset();
+		deduplicated_loads.store(0, std::memory_order_relaxed);
+		deduplicated_bytes.store(0, std::memory_order_relaxed);
+		backpressure_waits.store(0, std::memory_order_relaxed);
+		backpressure_timeouts.store(0, std::memory_order_relaxed);
+		over_budget_loads.store(0, std::memory_order_relaxed);
+		if (derived_data != nullptr)
+		{
+			derived_data->reset_stats();
+		}
+	}
 
-		size_t file_count = file->get_resource_count();
-		for (size_t i = 0; i < file_count; ++i)
+	[[nodiscard]]
+	ResourcePinReport ResourceCache::get_pin_report() const noexcept
+	{
+		ResourcePinReport report;
+		for (size_t i = 0; i < shard_count; ++i)
 		{
-			std::string name = file->get_resource_name(i);
-			std::transform(name.begin(), name.end(), name.begin(),
-                           [](unsigned char c){ return std::tolower(c); });
-			if (wildcard_match(pattern.data(), name.c_str()))
+			Shard& shard = shards[i];
+			std::scoped_lock shard_lock{ shard.mutex };
+			for (const auto& [name, handle] : shard.resources)
 			{
-				matching_names.push_back(name);
+				//NOTE(ches) the map holds one reference itself
+				const long holders = handle.use_count() - 1;
+				if (handle->charged_size == 0
+					|| (holders == 0 && handle->pin_count == 0))
+				{
+					continue;
+				}
+				report.pins.push_back({ handle->resource.name,
+					handle->charged_size, holders, handle->pin_count, true });
+				report.cached_bytes += handle->charged_size;
+			}
+			for (const std::weak_ptr<ResourceHandle>& held
+				: shard.evicted_held)
+			{
+				//NOTE(ches) pinning an evicted handle puts it back, and then
+				// it is already listed
+				std::shared_ptr<ResourceHandle> handle = held.lock();
+				if (!handle)
+				{
+					continue;
+				}
+				auto cached = shard.resources.find(handle->resource.name);
+				if (cached != shard.resources.end() && cached->second == handle)
+				{
+					continue;
+				}
+				report.pins.push_back({ handle->resource.name,
+					handle->charged_size, handle.use_count() - 1,
+					handle->pin_count, false });
+				report.evicted_bytes += handle->charged_size;
 			}
 		}
-		return matching_names;
+
+		std::sort(report.pins.begin(), report.pins.end(),
+			[](const ResourcePin& a, const ResourcePin& b)
+			{
+				return a.size > b.size;
+			});
+		return report;
 	}
 
-	void ResourceCache::flush() noexcept
+	void ResourceCache::set_hard_limit(const size_t size_in_MB) noexcept
+	{
+		hard_limit.store(std::max(cache_size, size_in_MB * 1024 * 1024),
+			std::memory_order_relaxed);
+	}
+
+	void ResourceCache::set_backpressure_timeout(
+		const std::chrono::milliseconds timeout) noexcept
+	{
+		backpressure_timeout.store(std::chrono::duration_cast<
+			std::chrono::steady_clock::duration>(timeout).count(),
+			std::memory_order_relaxed);
+	}
+
+	void ResourceCache::dump_stats_on_exit(std::string path) noexcept
+	{
+		stats_dump_path = std::move(path);
+	}
+
+	bool ResourceCache::use_derived_data_cache(const std::string directory,
+		const size_t size_in_MB) noexcept
 	{
-		while (!lru_list.empty())
+		safe_delete(derived_data);
+		derived_data = alloc<DerivedDataCache>(directory, size_in_MB);
+		if (!derived_data->open())
 		{
-			std::shared_ptr<ResourceHandle> handle = *(lru_list.begin());
-			free(handle);
-			lru_list.pop_front();
+			safe_delete(derived_data);
+			derived_data = nullptr;
+			return false;
 		}
+		return true;
 	}
 
+	void ResourceCache::set_deduplication(const bool enable) noexcept
+	{
+		deduplicate = enable;
+		if (!enable)
+		{
+			std::scoped_lock content_lock{ content_mutex };
+			content_index.clear();
+		}
+	}
 
 	/// <summary>
 	/// The following function was found on
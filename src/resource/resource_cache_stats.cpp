@@ -0,0 +1,241 @@
+#include "resource/resource_cache_stats.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+
+namespace loquat
+{
+	namespace
+	{
+		/// <summary>
+		/// Format one histogram as a line of the report.
+		/// </summary>
+		[[nodiscard]]
+		std::string format_latency(const char* label,
+			const LatencySummary& latency) noexcept
+		{
+			char line[256];
+			snprintf(line, sizeof(line),
+				"%-12s %10llu samples, %10.3f ms total, mean %9.1f us, "
+				"p50 <= %8.0f us, p99 <= %8.0f us, max %9.1f us\n",
+				label, static_cast<unsigned long long>(latency.count),
+				static_cast<double>(latency.total_ns) / 1.0e6,
+				latency.mean_us(), latency.percentile_us(0.5),
+				latency.percentile_us(0.99),
+				static_cast<double>(latency.max_ns) / 1.0e3);
+			return line;
+		}
+	}
+
+	[[nodiscard]]
+	uint64_t LatencySummary::bucket_limit_us(const size_t bucket) noexcept
+	{
+		if (bucket + 1 >= BUCKET_COUNT)
+		{
+			return 0;
+		}
+		return uint64_t{ 1 } << bucket;
+	}
+
+	[[nodiscard]]
+	double LatencySummary::mean_us() const noexcept
+	{
+		if (count == 0)
+		{
+			return 0.0;
+		}
+		return static_cast<double>(total_ns) / 1.0e3
+			/ static_cast<double>(count);
+	}
+
+	[[nodiscard]]
+	double LatencySummary::percentile_us(const double fraction) const noexcept
+	{
+		if (count == 0)
+		{
+			return 0.0;
+		}
+
+		const double target = fraction * static_cast<double>(count);
+		uint64_t seen = 0;
+		for (size_t bucket = 0; bucket + 1 < BUCKET_COUNT; ++bucket)
+		{
+			seen += buckets[bucket];
+			if (static_cast<double>(seen) >= target)
+			{
+				return static_cast<double>(bucket_limit_us(bucket));
+			}
+		}
+		return static_cast<double>(max_ns) / 1.0e3;
+	}
+
+	void LatencyHistogram::record(
+		const std::chrono::steady_clock::duration elapsed) noexcept
+	{
+		const uint64_t ns = static_cast<uint64_t>(std::max<int64_t>(
+			std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+			.count(), 0));
+		const uint64_t us = ns / 1000;
+		const size_t bucket = std::min<size_t>(std::bit_width(us),
+			LatencySummary::BUCKET_COUNT - 1);
+
+		buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+		count.fetch_add(1, std::memory_order_relaxed);
+		total_ns.fetch_add(ns, std::memory_order_relaxed);
+
+		uint64_t slowest = max_ns.load(std::memory_order_relaxed);
+		while (ns > slowest && !max_ns.compare_exchange_weak(slowest, ns,
+			std::memory_order_relaxed))
+		{
+		}
+	}
+
+	[[nodiscard]]
+	LatencySummary LatencyHistogram::summary() const noexcept
+	{
+		LatencySummary result;
+		for (size_t i = 0; i < LatencySummary::BUCKET_COUNT; ++i)
+		{
+			result.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+		}
+		result.count = count.load(std::memory_order_relaxed);
+		result.total_ns = total_ns.load(std::memory_order_relaxed);
+		result.max_ns = max_ns.load(std::memory_order_relaxed);
+		return result;
+	}
+
+	void LatencyHistogram::reset() noexcept
+	{
+		for (std::atomic<uint64_t>& bucket : buckets)
+		{
+			bucket.store(0, std::memory_order_relaxed);
+		}
+		count.store(0, std::memory_order_relaxed);
+		total_ns.store(0, std::memory_order_relaxed);
+		max_ns.store(0, std::memory_order_relaxed);
+	}
+
+	[[nodiscard]]
+	double ResourceCacheStats::hit_rate() const noexcept
+	{
+		const uint64_t requests = hits + joined + misses;
+		if (requests == 0)
+		{
+			return 0.0;
+		}
+		return static_cast<double>(hits + joined)
+			/ static_cast<double>(requests);
+	}
+
+	[[nodiscard]]
+	std::string ResourceCacheStats::to_string() const noexcept
+	{
+		constexpr double MB = 1024.0 * 1024.0;
+		char line[256];
+		std::string report;
+
+		snprintf(line, sizeof(line),
+			"requests     %10llu hits, %10llu joined, %10llu misses "
+			"(%.1f%% hit rate)\n",
+			static_cast<unsigned long long>(hits),
+			static_cast<unsigned long long>(joined),
+			static_cast<unsigned long long>(misses), hit_rate() * 100.0);
+		report += line;
+
+		snprintf(line, sizeof(line),
+			"loads        %10llu failed, %10llu prefetched, %10.2f MB read, "
+			"%10.2f MB loaded\n",
+			static_cast<unsigned long long>(failed_loads),
+			static_cast<unsigned long long>(prefetched),
+			static_cast<double>(bytes_read) / MB,
+			static_cast<double>(bytes_loaded) / MB);
+		report += line;
+
+		snprintf(line, sizeof(line),
+			"evictions    %10llu, %10.2f MB\n",
+			static_cast<unsigned long long>(evictions),
+			static_cast<double>(bytes_evicted) / MB);
+		report += line;
+
+		snprintf(line, sizeof(line),
+			"memory       %10.2f MB in use, %10.2f MB peak, %10.2f MB budget, "
+			"%10.2f MB hard limit\n",
+			static_cast<double>(allocated) / MB,
+			static_cast<double>(peak_allocated) / MB,
+			static_cast<double>(cache_size) / MB,
+			static_cast<double>(hard_limit) / MB);
+		report += line;
+
+		snprintf(line, sizeof(line),
+			"backpressure %10llu waits, %10llu timeouts, %10llu over budget\n",
+			static_cast<unsigned long long>(backpressure_waits),
+			static_cast<unsigned long long>(backpressure_timeouts),
+			static_cast<unsigned long long>(over_budget_loads));
+		report += line;
+
+		snprintf(line, sizeof(line),
+			"buffers      %10.2f MB requested, %10.2f MB rounded, "
+			"%10.2f MB mapped (%.1f%% fragmentation), %zu slabs, %zu large\n",
+			static_cast<double>(buffers.requested_bytes) / MB,
+			static_cast<double>(buffers.allocated_bytes) / MB,
+			static_cast<double>(buffers.mapped_bytes) / MB,
+			buffers.fragmentation() * 100.0, buffers.slab_count,
+			buffers.large_count);
+		report += line;
+
+		snprintf(line, sizeof(line),
+			"dedupe       %10llu shared, %10.2f MB saved\n",
+			static_cast<unsigned long long>(deduplicated),
+			static_cast<double>(bytes_deduplicated) / MB);
+		report += line;
+
+		snprintf(line, sizeof(line),
+			"derived      %10llu hits, %10llu misses, %10llu stored, "
+			"%10.2f MB on disk\n",
+			static_cast<unsigned long long>(derived_hits),
+			static_cast<unsigned long long>(derived_misses),
+			static_cast<unsigned long long>(derived_stores),
+			static_cast<double>(derived_disk_size) / MB);
+		report += line;
+
+		report += format_latency("file read", file_read);
+		report += format_latency("loader", loader);
+		return report;
+	}
+
+	[[nodiscard]]
+	std::string ResourcePinReport::to_string(const size_t max_pins) const
+		noexcept
+	{
+		constexpr double MB = 1024.0 * 1024.0;
+		char line[512];
+		std::string report;
+
+		snprintf(line, sizeof(line),
+			"pinned       %10zu resources, %10.2f MB cached, "
+			"%10.2f MB evicted\n", pins.size(),
+			static_cast<double>(cached_bytes) / MB,
+			static_cast<double>(evicted_bytes) / MB);
+		report += line;
+
+		const size_t count = std::min(pins.size(), max_pins);
+		for (size_t i = 0; i < count; ++i)
+		{
+			const ResourcePin& pin = pins[i];
+			snprintf(line, sizeof(line),
+				"  %10.2f MB %5ld holders %5zu pins %-7s %s\n",
+				static_cast<double>(pin.size) / MB, pin.holders,
+				pin.pin_count, pin.cached ? "cached" : "evicted",
+				pin.name.c_str());
+			report += line;
+		}
+		if (count < pins.size())
+		{
+			snprintf(line, sizeof(line), "  ... and %zu more\n",
+				pins.size() - count);
+			report += line;
+		}
+		return report;
+	}
+}
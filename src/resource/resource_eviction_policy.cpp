@@ -0,0 +1,25 @@
+#include "resource/resource_eviction_policy.h"
+
+#include "main/memory_utils.h"
+#include "resource/arc_eviction_policy.h"
+#include "resource/gdsf_eviction_policy.h"
+#include "resource/lru_eviction_policy.h"
+
+namespace loquat
+{
+	[[nodiscard]]
+	ResourceEvictionPolicy* make_eviction_policy(
+		ResourceEvictionPolicyType type, size_t capacity) noexcept
+	{
+		switch (type)
+		{
+		case ResourceEvictionPolicyType::ARC:
+			return alloc<ARCEvictionPolicy>(capacity);
+		case ResourceEvictionPolicyType::GDSF:
+			return alloc<GDSFEvictionPolicy>();
+		case ResourceEvictionPolicyType::LRU:
+		default:
+			return alloc<LRUEvictionPolicy>();
+		}
+	}
+}
@@ -0,0 +1,50 @@
+#include "resource/resource_file.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "main/memory_utils.h"
+
+namespace loquat
+{
+	size_t ResourceFile::load_range(const Resource& resource, size_t offset,
+		size_t length, char* buffer)
+	{
+		const size_t size = get_raw_resource_size(resource);
+		if (buffer == nullptr || size == 0 || offset >= size)
+		{
+			return 0;
+		}
+
+		char* whole = static_cast<char*>(g_allocator->allocate_bytes(size));
+		size_t count = 0;
+		if (load_resource(resource, whole) == size)
+		{
+			count = std::min(length, size - offset);
+			memcpy(buffer, whole + offset, count);
+		}
+		g_allocator->deallocate_bytes(whole, size);
+		return count;
+	}
+
+	void ResourceFile::load_batch(std::vector<ResourceRead>& reads)
+	{
+		for (ResourceRead& read : reads)
+		{
+			read.bytes_read = load_range(*read.resource, read.offset,
+				read.length, read.buffer);
+		}
+	}
+
+	std::shared_ptr<ResourceStream> ResourceFile::open_stream(
+		const Resource& resource)
+	{
+		const size_t size = get_raw_resource_size(resource);
+		if (size == 0)
+		{
+			return std::shared_ptr<ResourceStream>();
+		}
+		return std::shared_ptr<ResourceStream>(
+			alloc<ResourceStream>(this, resource, size));
+	}
+}
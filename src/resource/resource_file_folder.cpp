@@ -2,25 +2,175 @@
 
 #include <algorithm>
 #include <climits>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
 
 #include "debug/logger.h"
+#include "main/memory_utils.h"
 #include "resource/resource.h"
 
 namespace loquat
 {
 	namespace fs = std::filesystem;
 
+	namespace
+	{
+		constexpr char MANIFEST_MAGIC[4] = { 'L', 'Q', 'M', 'F' };
+		constexpr uint32_t MANIFEST_VERSION = 1;
+
+		/// <summary>
+		/// The most reads a batch keeps in flight at once.
+		/// </summary>
+		constexpr size_t BATCH_QUEUE_DEPTH = 64;
+
+		/// <summary>
+		/// The number of threads reading batches when io_uring isn't
+		/// available.
+		/// </summary>
+		constexpr size_t BATCH_THREAD_COUNT = 8;
+
+		[[nodiscard]]
+		int64_t modified_time(const fs::path& path) noexcept
+		{
+			std::error_code error;
+			const fs::file_time_type time = fs::last_write_time(path, error);
+			return error ? 0 : static_cast<int64_t>(
+				time.time_since_epoch().count());
+		}
+
+		template <typename T>
+		void write_value(std::ostream& stream, const T& value)
+		{
+			stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+		}
+
+		void write_string(std::ostream& stream, const std::string& value)
+		{
+			write_value(stream, static_cast<uint32_t>(value.size()));
+			stream.write(value.data(), value.size());
+		}
+
+		/// <summary>
+		/// Reads values out of a manifest that has been loaded into memory,
+		/// failing instead of reading past the end.
+		/// </summary>
+		struct ManifestReader
+		{
+			const char* position;
+			const char* end;
+
+			template <typename T>
+			[[nodiscard]]
+			bool read(T& value) noexcept
+			{
+				if (static_cast<size_t>(end - position) < sizeof(value))
+				{
+					return false;
+				}
+				memcpy(&value, position, sizeof(value));
+				position += sizeof(value);
+				return true;
+			}
+
+			[[nodiscard]]
+			bool read(std::string& value) noexcept
+			{
+				uint32_t length;
+				if (!read(length)
+					|| static_cast<size_t>(end - position) < length)
+				{
+					return false;
+				}
+				value.assign(position, length);
+				position += length;
+				return true;
+			}
+		};
+
+		/// <summary>
+		/// Read part of an open file.
+		/// </summary>
+		[[nodiscard]]
+		size_t read_file_range(std::ifstream& file_bytes, size_t offset,
+			size_t length, char* buffer) noexcept
+		{
+			file_bytes.clear();
+			file_bytes.seekg(static_cast<std::streamoff>(offset));
+			file_bytes.read(buffer, static_cast<std::streamsize>(length));
+			return static_cast<size_t>(file_bytes.gcount());
+		}
+
+		/// <summary>
+		/// Streams a file in the folder, keeping it open between reads.
+		/// </summary>
+		class FolderResourceStream : public ResourceStream
+		{
+			std::ifstream file_bytes;
+
+		protected:
+			virtual size_t read_range(size_t offset, size_t length,
+				char* buffer) noexcept
+			{
+				return read_file_range(file_bytes, offset, length, buffer);
+			}
+
+		public:
+			FolderResourceStream(ResourceFile* file, const Resource& resource,
+				size_t size, const std::string& full_path) noexcept
+				: ResourceStream(file, resource, size)
+				, file_bytes(full_path, std::ios_base::binary)
+			{}
+
+			[[nodiscard]]
+			bool is_open() const noexcept
+			{
+				return file_bytes.is_open();
+			}
+		};
+	}
+
 	ResourceFileFolder::ResourceFileFolder(
 		const std::string resource_folder_name)
 		: resource_folder_name{ resource_folder_name + '/' }
+		, manifest_file_name{ resource_folder_name + ".manifest" }
 	{
 		LOG_INFO("Opening the resource folder " + resource_folder_name);
 	}
 
-	ResourceFileFolder::~ResourceFileFolder() = default;
+	ResourceFileFolder::~ResourceFileFolder()
+	{
+		if (watch_descriptor >= 0)
+		{
+			//NOTE(ches) we saw every change while watching, so once the last
+			// of them are applied the directory times can be brought up to
+			// date and the manifest will be current on the next open
+			std::vector<std::string> ignored;
+			poll_changes(ignored);
+			for (ManifestDirectory& directory : directories)
+			{
+				directory.modified = modified_time(
+					resource_folder_name + directory.name);
+			}
+			manifest_dirty = true;
+#if defined(__linux__)
+			::close(watch_descriptor);
+#endif
+		}
+
+		if (manifest_dirty)
+		{
+			write_manifest();
+		}
+		safe_delete(batch_reader);
+	}
 
 	bool ResourceFileFolder::open()
 	{
@@ -29,11 +179,212 @@ namespace loquat
 			LOG_ERROR("Resource folder does not exist!");
 			return false;
 		}
+
+		std::scoped_lock manifest_lock{ manifest_mutex };
+		if (!read_manifest() || !manifest_is_current())
+		{
+			LOG_INFO("Resource manifest is missing or stale, scanning "
+				+ resource_folder_name);
+			scan_folder();
+			write_manifest();
+		}
+		index_entries();
+		return true;
+	}
+
+	bool ResourceFileFolder::read_manifest() noexcept
+	{
+		entries.clear();
+		directories.clear();
+
+		std::ifstream manifest(manifest_file_name, std::ios_base::binary);
+		if (!manifest)
+		{
+			return false;
+		}
+		const std::vector<char> bytes{
+			std::istreambuf_iterator<char>(manifest),
+			std::istreambuf_iterator<char>() };
+		ManifestReader reader{ bytes.data(), bytes.data() + bytes.size() };
+
+		char magic[4];
+		uint32_t version;
+		uint64_t directory_count;
+		uint64_t entry_count;
+		if (!reader.read(magic) || memcmp(magic, MANIFEST_MAGIC,
+			sizeof(MANIFEST_MAGIC)) != 0
+			|| !reader.read(version) || version != MANIFEST_VERSION
+			|| !reader.read(directory_count) || !reader.read(entry_count))
+		{
+			return false;
+		}
+
+		//NOTE(ches) every record is at least 12 bytes, which stops a corrupt
+		// count from reserving a huge amount of memory
+		const size_t remaining = static_cast<size_t>(reader.end
+			- reader.position);
+		if (directory_count + entry_count > remaining / 12)
+		{
+			return false;
+		}
+
+		directories.resize(static_cast<size_t>(directory_count));
+		for (ManifestDirectory& directory : directories)
+		{
+			if (!reader.read(directory.name)
+				|| !reader.read(directory.modified))
+			{
+				directories.clear();
+				return false;
+			}
+		}
+
+		entries.resize(static_cast<size_t>(entry_count));
+		for (ManifestEntry& entry : entries)
+		{
+			if (!reader.read(entry.name) || !reader.read(entry.size)
+				|| !reader.read(entry.modified))
+			{
+				directories.clear();
+				entries.clear();
+				return false;
+			}
+		}
+		return true;
+	}
+
+	[[nodiscard]]
+	bool ResourceFileFolder::manifest_is_current() const noexcept
+	{
+		if (directories.empty())
+		{
+			return false;
+		}
+		for (const ManifestDirectory& directory : directories)
+		{
+			const int64_t modified = modified_time(
+				resource_folder_name + directory.name);
+			if (modified == 0 || modified != directory.modified)
+			{
+				return false;
+			}
+		}
+
+		//NOTE(ches) overwriting a file in place doesn't touch its directory,
+		// so those are only caught when the file is loaded, see
+		// load_resource
 		return true;
 	}
 
+	void ResourceFileFolder::scan_folder() noexcept
+	{
+		entries.clear();
+		directories.clear();
+		directories.push_back({ std::string(),
+			modified_time(resource_folder_name) });
+
+		std::error_code error;
+		for (auto const& file : fs::recursive_directory_iterator{
+			resource_folder_name, error })
+		{
+			//NOTE(ches) names are relative to the folder, so they can be
+			// used to load the resource
+			std::string name = file.path().lexically_relative(
+				resource_folder_name).generic_string();
+
+			if (file.is_directory(error))
+			{
+				directories.push_back({ std::move(name),
+					modified_time(file.path()) });
+			}
+			else if (file.is_regular_file(error))
+			{
+				entries.push_back({ std::move(name),
+					static_cast<uint64_t>(file.file_size(error)),
+					modified_time(file.path()) });
+			}
+		}
+
+		std::sort(entries.begin(), entries.end(),
+			[](const ManifestEntry& a, const ManifestEntry& b)
+			{
+				return a.name < b.name;
+			});
+	}
+
+	void ResourceFileFolder::write_manifest() noexcept
+	{
+		//NOTE(ches) written to the side and renamed over, so a crash part way
+		// through never leaves a truncated manifest behind
+		const std::string temporary_name = manifest_file_name + ".tmp";
+		{
+			std::ofstream manifest(temporary_name,
+				std::ios_base::binary | std::ios_base::trunc);
+			if (!manifest)
+			{
+				LOG_WARNING("Could not write the resource manifest "
+					+ manifest_file_name);
+				return;
+			}
+
+			manifest.write(MANIFEST_MAGIC, sizeof(MANIFEST_MAGIC));
+			write_value(manifest, MANIFEST_VERSION);
+			write_value(manifest, static_cast<uint64_t>(directories.size()));
+			write_value(manifest, static_cast<uint64_t>(entries.size()));
+			for (const ManifestDirectory& directory : directories)
+			{
+				write_string(manifest, directory.name);
+				write_value(manifest, directory.modified);
+			}
+			for (const ManifestEntry& entry : entries)
+			{
+				write_string(manifest, entry.name);
+				write_value(manifest, entry.size);
+				write_value(manifest, entry.modified);
+			}
+			if (!manifest)
+			{
+				LOG_WARNING("Could not write the resource manifest "
+					+ manifest_file_name);
+				return;
+			}
+		}
+
+		std::error_code error;
+		fs::rename(temporary_name, manifest_file_name, error);
+		if (error)
+		{
+			LOG_WARNING("Could not replace the resource manifest "
+				+ manifest_file_name);
+			return;
+		}
+		manifest_dirty = false;
+	}
+
+	void ResourceFileFolder::index_entries() noexcept
+	{
+		entry_index.clear();
+		entry_index.reserve(entries.size());
+		for (size_t i = 0; i < entries.size(); ++i)
+		{
+			entry_index.emplace(entries[i].name, i);
+		}
+	}
+
 	size_t ResourceFileFolder::get_raw_resource_size(const Resource& resource)
 	{
+		{
+			std::scoped_lock manifest_lock{ manifest_mutex };
+			auto result = entry_index.find(resource.name);
+			if (result != entry_index.end())
+			{
+				return static_cast<size_t>(entries[result->second].size);
+			}
+		}
+
+		//NOTE(ches) names that aren't in the manifest are rare, since they
+		// don't match the case of the file on disk, so just ask the file
+		// system like we always used to
 		const std::string full_path = resource_folder_name + resource.name;
 		if (!fs::exists(full_path))
 		{
@@ -60,7 +411,34 @@ namespace loquat
 		}
 
 		const std::string full_path = resource_folder_name + resource.name;
-		const auto size = fs::file_size(full_path);
+		std::error_code error;
+		const auto size = fs::file_size(full_path, error);
+		if (error)
+		{
+			LOG_ERROR("Can not find the file " + full_path);
+			return 0;
+		}
+
+		{
+			//NOTE(ches) the buffer was sized from the manifest. A file that
+			// shrank still fits, but one that grew doesn't, so record the
+			// new size for the caller to try again with.
+			std::scoped_lock manifest_lock{ manifest_mutex };
+			auto result = entry_index.find(resource.name);
+			if (result != entry_index.end()
+				&& entries[result->second].size != size)
+			{
+				ManifestEntry& entry = entries[result->second];
+				const uint64_t sized = entry.size;
+				entry.size = size;
+				entry.modified = modified_time(full_path);
+				manifest_dirty = true;
+				if (size > sized)
+				{
+					return 0;
+				}
+			}
+		}
 
 		std::ifstream file_bytes(full_path, std::ios_base::binary);
 		file_bytes.read(buffer, size);
@@ -68,33 +446,340 @@ namespace loquat
 		return size;
 	}
 
+	size_t ResourceFileFolder::load_range(const Resource& resource,
+		size_t offset, size_t length, char* buffer)
+	{
+		if (buffer == nullptr)
+		{
+			LOG_WARNING("Destination buffer is null");
+			return 0;
+		}
+
+		const std::string full_path = resource_folder_name + resource.name;
+		std::ifstream file_bytes(full_path, std::ios_base::binary);
+		if (!file_bytes.is_open())
+		{
+			LOG_ERROR("Can not find the file " + full_path);
+			return 0;
+		}
+		return read_file_range(file_bytes, offset, length, buffer);
+	}
+
+	std::shared_ptr<ResourceStream> ResourceFileFolder::open_stream(
+		const Resource& resource)
+	{
+		const size_t size = get_raw_resource_size(resource);
+		if (size == 0)
+		{
+			return std::shared_ptr<ResourceStream>();
+		}
+
+		const std::string full_path = resource_folder_name + resource.name;
+		std::shared_ptr<FolderResourceStream> stream(
+			alloc<FolderResourceStream>(this, resource, size, full_path));
+		if (!stream->is_open())
+		{
+			LOG_ERROR("Can not open the file " + full_path);
+			return std::shared_ptr<ResourceStream>();
+		}
+		return stream;
+	}
+
+	void ResourceFileFolder::load_batch(std::vector<ResourceRead>& reads)
+	{
+		std::call_once(batch_reader_created, [this]()
+			{
+				batch_reader = make_batch_file_reader(BATCH_QUEUE_DEPTH,
+					BATCH_THREAD_COUNT);
+			});
+
+		std::vector<FileRead> file_reads(reads.size());
+		for (size_t i = 0; i < reads.size(); ++i)
+		{
+			file_reads[i].path = resource_folder_name + reads[i].resource->name;
+			file_reads[i].offset = reads[i].offset;
+			file_reads[i].length = reads[i].length;
+			file_reads[i].buffer = reads[i].buffer;
+		}
+
+		batch_reader->read(file_reads);
+
+		for (size_t i = 0; i < reads.size(); ++i)
+		{
+			reads[i].bytes_read = file_reads[i].bytes_read;
+			if (reads[i].bytes_read < reads[i].length)
+			{
+				//NOTE(ches) most likely the file shrank since the manifest
+				// was written, so record its real size for next time
+				LOG_WARNING("Could only read part of " + file_reads[i].path);
+				refresh_entry(reads[i].resource->name);
+			}
+		}
+	}
+
 	const size_t ResourceFileFolder::get_resource_count()
 	{
-		using predicate = bool (*)(const fs::path&);
-		return std::count_if(fs::directory_iterator{ resource_folder_name },
-			fs::directory_iterator{}, (predicate)fs::is_regular_file);
+		std::scoped_lock manifest_lock{ manifest_mutex };
+		return entries.size();
 	}
 
 	std::string ResourceFileFolder::get_resource_name(size_t index)
 	{
-		std::scoped_lock cache_lock{ cache_mutex };
+		std::scoped_lock manifest_lock{ manifest_mutex };
+
+		LOG_ASSERT(index >= 0 && index < entries.size()
+			&& "Invalid resource index");
+		if (index >= entries.size())
+		{
+			return std::string();
+		}
+
+		return entries[index].name;
+	}
+
+	void ResourceFileFolder::refresh_entry(const std::string& name) noexcept
+	{
+		const fs::path full_path = resource_folder_name + name;
+		std::error_code error;
+		const bool exists = fs::is_regular_file(full_path, error);
+
+		std::scoped_lock manifest_lock{ manifest_mutex };
+		auto result = entry_index.find(name);
+		if (exists && result != entry_index.end())
+		{
+			ManifestEntry& entry = entries[result->second];
+			entry.size = fs::file_size(full_path, error);
+			entry.modified = modified_time(full_path);
+		}
+		else if (exists)
+		{
+			ManifestEntry entry{ name, fs::file_size(full_path, error),
+				modified_time(full_path) };
+			auto position = std::lower_bound(entries.begin(), entries.end(),
+				name, [](const ManifestEntry& entry, const std::string& name)
+				{
+					return entry.name < name;
+				});
+			entries.insert(position, std::move(entry));
+			index_entries();
+		}
+		else if (result != entry_index.end())
+		{
+			entries.erase(entries.begin() + result->second);
+			index_entries();
+		}
+		manifest_dirty = true;
+	}
+
+#if defined(__linux__)
+
+	namespace
+	{
+		constexpr uint32_t WATCH_EVENTS = IN_CLOSE_WRITE | IN_MOVED_TO
+			| IN_MOVED_FROM | IN_CREATE | IN_DELETE;
+	}
+
+	bool ResourceFileFolder::watch()
+	{
+		if (watch_descriptor >= 0)
+		{
+			return true;
+		}
+
+		watch_descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (watch_descriptor < 0)
+		{
+			LOG_WARNING("Could not start watching " + resource_folder_name);
+			return false;
+		}
+		add_watch(std::string(), nullptr);
+		return true;
+	}
+
+	void ResourceFileFolder::add_watch(const std::string& name,
+		std::vector<std::string>* found_files) noexcept
+	{
+		const std::string full_path = resource_folder_name + name;
+		const int watch = inotify_add_watch(watch_descriptor,
+			full_path.c_str(), WATCH_EVENTS);
+		if (watch < 0)
+		{
+			LOG_WARNING("Could not watch " + full_path);
+			return;
+		}
+		watched_directories[watch] = name;
+
+		{
+			std::scoped_lock manifest_lock{ manifest_mutex };
+			auto known = std::find_if(directories.begin(), directories.end(),
+				[&name](const ManifestDirectory& directory)
+				{
+					return directory.name == name;
+				});
+			if (known == directories.end())
+			{
+				directories.push_back({ name, modified_time(full_path) });
+			}
+		}
+
+		std::error_code error;
+		for (auto const& file : fs::directory_iterator{ full_path, error })
+		{
+			std::string file_name = file.path().lexically_relative(
+				resource_folder_name).generic_string();
+			if (file.is_directory(error))
+			{
+				add_watch(file_name, found_files);
+			}
+			else if (found_files != nullptr && file.is_regular_file(error))
+			{
+				found_files->push_back(std::move(file_name));
+			}
+		}
+	}
+
+	void ResourceFileFolder::remove_watch(const std::string& name,
+		std::vector<std::string>& removed_files) noexcept
+	{
+		const std::string prefix = name + '/';
+		const auto is_inside = [&name, &prefix](const std::string& other)
+			{
+				return other == name || other.starts_with(prefix);
+			};
+
+		//NOTE(ches) a deleted directory drops its own watches, but one that
+		// was moved out would keep telling us about files we no longer have
+		for (const auto& [watch, directory] : watched_directories)
+		{
+			if (is_inside(directory))
+			{
+				inotify_rm_watch(watch_descriptor, watch);
+			}
+		}
+
+		std::scoped_lock manifest_lock{ manifest_mutex };
+		std::erase_if(directories,
+			[&is_inside](const ManifestDirectory& directory)
+			{
+				return is_inside(directory.name);
+			});
+		auto entry = std::lower_bound(entries.begin(), entries.end(), prefix,
+			[](const ManifestEntry& entry, const std::string& name)
+			{
+				return entry.name < name;
+			});
+		for (; entry != entries.end() && entry->name.starts_with(prefix);
+			++entry)
+		{
+			removed_files.push_back(entry->name);
+		}
+	}
+
+	void ResourceFileFolder::poll_changes(
+		std::vector<std::string>& changed_names)
+	{
+		if (watch_descriptor < 0)
+		{
+			return;
+		}
 
-		if (!has_file_name_cache)
+		std::vector<std::string> changed;
+		alignas(inotify_event) char buffer[4096];
+		while (true)
 		{
-			for (auto const& file :
-				fs::recursive_directory_iterator{ resource_folder_name })
+			const ssize_t length = ::read(watch_descriptor, buffer,
+				sizeof(buffer));
+			if (length <= 0)
 			{
-				if (!fs::is_regular_file(file))
+				break;
+			}
+
+			for (char* position = buffer; position < buffer + length;)
+			{
+				const inotify_event* event =
+					reinterpret_cast<const inotify_event*>(position);
+				position += sizeof(inotify_event) + event->len;
+
+				if ((event->mask & IN_Q_OVERFLOW) != 0)
+				{
+					LOG_WARNING("Missed changes to " + resource_folder_name
+						+ ", some resources may be stale");
+					continue;
+				}
+
+				auto directory = watched_directories.find(event->wd);
+				if ((event->mask & IN_IGNORED) != 0)
+				{
+					if (directory != watched_directories.end())
+					{
+						watched_directories.erase(directory);
+					}
+					continue;
+				}
+				if (directory == watched_directories.end() || event->len == 0)
+				{
+					continue;
+				}
+
+				const std::string name = directory->second.empty()
+					? std::string(event->name)
+					: directory->second + '/' + event->name;
+
+				if ((event->mask & IN_ISDIR) != 0)
 				{
+					//NOTE(ches) a directory that was moved in already has
+					// files in it that we won't hear about otherwise
+					if ((event->mask & (IN_CREATE | IN_MOVED_TO)) != 0)
+					{
+						add_watch(name, &changed);
+					}
+					else if ((event->mask & (IN_DELETE | IN_MOVED_FROM)) != 0)
+					{
+						remove_watch(name, changed);
+					}
 					continue;
 				}
-				cached_file_names.push_back(file.path().string());
+
+				//NOTE(ches) a new file is announced before anything is written
+				// to it, so we wait for it to be closed instead
+				if ((event->mask & IN_CREATE) != 0)
+				{
+					continue;
+				}
+				changed.push_back(name);
 			}
 		}
 
-		LOG_ASSERT(index >= 0 && index < cached_file_names.size()
-			&& "Invalid resource index");
+		std::sort(changed.begin(), changed.end());
+		changed.erase(std::unique(changed.begin(), changed.end()),
+			changed.end());
+		for (const std::string& name : changed)
+		{
+			refresh_entry(name);
+			changed_names.push_back(name);
+		}
+	}
 
-		return cached_file_names[index];
+#else
+
+	bool ResourceFileFolder::watch()
+	{
+		LOG_WARNING("Watching for resource changes is not supported on this "
+			"platform");
+		return false;
 	}
-}
+
+	void ResourceFileFolder::add_watch(const std::string& name,
+		std::vector<std::string>* found_files) noexcept
+	{}
+
+	void ResourceFileFolder::remove_watch(const std::string& name,
+		std::vector<std::string>& removed_files) noexcept
+	{}
+
+	void ResourceFileFolder::poll_changes(
+		std::vector<std::string>& changed_names)
+	{}
+
+#endif
+}
\ No newline at end of file
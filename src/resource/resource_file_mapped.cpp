@@ -0,0 +1,119 @@
+#include "resource/resource_file_mapped.h"
+
+#include <filesystem>
+
+#if defined(_LOQUAT_WIN32)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "debug/logger.h"
+#include "resource/resource.h"
+
+namespace loquat
+{
+	namespace fs = std::filesystem;
+
+	ResourceFileMapped::ResourceFileMapped(
+		const std::string resource_folder_name)
+		: ResourceFileFolder{ resource_folder_name }
+	{}
+
+	ResourceFileMapped::~ResourceFileMapped() = default;
+
+	ResourceMapping ResourceFileMapped::map_resource(const Resource& resource)
+	{
+		if (is_watching())
+		{
+			return ResourceMapping();
+		}
+		return map_file(resource_folder_name + resource.name);
+	}
+
+#if defined(_LOQUAT_WIN32)
+
+	[[nodiscard]]
+	ResourceMapping map_file(const std::string& path) noexcept
+	{
+		ResourceMapping mapping;
+
+		HANDLE file = CreateFileW(fs::path(path).c_str(), GENERIC_READ,
+			FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return mapping;
+		}
+
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+		{
+			CloseHandle(file);
+			return mapping;
+		}
+
+		HANDLE file_mapping = CreateFileMappingW(file, nullptr,
+			PAGE_WRITECOPY, 0, 0, nullptr);
+		CloseHandle(file);
+		if (file_mapping == nullptr)
+		{
+			return mapping;
+		}
+
+		void* view = MapViewOfFile(file_mapping, FILE_MAP_COPY, 0, 0, 0);
+		CloseHandle(file_mapping);
+		if (view == nullptr)
+		{
+			return mapping;
+		}
+
+		mapping.data = static_cast<char*>(view);
+		mapping.size = static_cast<size_t>(file_size.QuadPart);
+		mapping.owner = std::shared_ptr<void>(view,
+			[](void* view) { UnmapViewOfFile(view); });
+		return mapping;
+	}
+
+#else
+
+	[[nodiscard]]
+	ResourceMapping map_file(const std::string& path) noexcept
+	{
+		ResourceMapping mapping;
+
+		const int file = ::open(path.c_str(), O_RDONLY);
+		if (file < 0)
+		{
+			return mapping;
+		}
+
+		struct stat file_status;
+		if (fstat(file, &file_status) != 0 || file_status.st_size == 0)
+		{
+			::close(file);
+			return mapping;
+		}
+		const size_t size = static_cast<size_t>(file_status.st_size);
+
+		void* view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+			file, 0);
+		::close(file);
+		if (view == MAP_FAILED)
+		{
+			LOG_WARNING("Failed to map " + path);
+			return mapping;
+		}
+
+		mapping.data = static_cast<char*>(view);
+		mapping.size = size;
+		mapping.owner = std::shared_ptr<void>(view,
+			[size](void* view) { munmap(view, size); });
+		return mapping;
+	}
+
+#endif
+}
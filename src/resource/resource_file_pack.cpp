@@ -0,0 +1,363 @@
+#include "resource/resource_file_pack.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "debug/logger.h"
+#include "resource/resource.h"
+#include "resource/resource_file_mapped.h"
+
+namespace loquat
+{
+	namespace fs = std::filesystem;
+
+	namespace
+	{
+		constexpr char PACK_MAGIC[4] = { 'L', 'Q', 'P', 'K' };
+
+		static_assert(sizeof(ResourcePackHeader) == 40,
+			"The pack header layout is part of the file format");
+		static_assert(sizeof(ResourcePackEntry) == 32,
+			"The pack entry layout is part of the file format");
+
+		[[nodiscard]]
+		constexpr uint64_t align_up(uint64_t value, uint64_t alignment)
+			noexcept
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+		/// <summary>
+		/// Whether a range lies within a limit, without overflowing.
+		/// </summary>
+		[[nodiscard]]
+		constexpr bool range_fits(const uint64_t offset, const uint64_t size,
+			const uint64_t limit) noexcept
+		{
+			return offset <= limit && size <= limit - offset;
+		}
+
+		[[nodiscard]]
+		constexpr bool entry_before(const ResourcePackEntry& entry,
+			uint64_t hash, std::string_view name, const char* names) noexcept
+		{
+			if (entry.name_hash != hash)
+			{
+				return entry.name_hash < hash;
+			}
+			return std::string_view(names + entry.name_offset,
+				entry.name_length) < name;
+		}
+	}
+
+	ResourceFilePack::ResourceFilePack(const std::string pack_file_name)
+		: pack_file_name{ pack_file_name }
+	{
+		LOG_INFO("Opening the resource pack " + pack_file_name);
+	}
+
+	ResourceFilePack::~ResourceFilePack() = default;
+
+	bool ResourceFilePack::open()
+	{
+		pack = map_file(pack_file_name);
+		if (pack.data == nullptr)
+		{
+			LOG_ERROR("Resource pack " + pack_file_name + " does not exist!");
+			return false;
+		}
+
+		ResourcePackHeader header;
+		if (pack.size < sizeof(header))
+		{
+			LOG_ERROR("Resource pack " + pack_file_name + " is truncated");
+			return false;
+		}
+		memcpy(&header, pack.data, sizeof(header));
+
+		if (memcmp(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0
+			|| header.version != RESOURCE_PACK_VERSION)
+		{
+			LOG_ERROR(pack_file_name + " is not a supported resource pack");
+			return false;
+		}
+
+		if (header.toc_offset % alignof(ResourcePackEntry) != 0
+			|| header.entry_count > pack.size / sizeof(ResourcePackEntry)
+			|| !range_fits(header.toc_offset,
+				header.entry_count * sizeof(ResourcePackEntry), pack.size)
+			|| !range_fits(header.names_offset, header.names_size, pack.size))
+		{
+			LOG_ERROR("Resource pack " + pack_file_name
+				+ " has a corrupt table of contents");
+			return false;
+		}
+
+		//NOTE(ches) everything that reads the pack trusts the entries, so
+		// they are all checked once here rather than on every read
+		const ResourcePackEntry* toc = reinterpret_cast<
+			const ResourcePackEntry*>(pack.data + header.toc_offset);
+		for (uint64_t i = 0; i < header.entry_count; ++i)
+		{
+			if (!range_fits(toc[i].data_offset, toc[i].size, pack.size)
+				|| !range_fits(toc[i].name_offset, toc[i].name_length,
+					header.names_size))
+			{
+				LOG_ERROR("Resource pack " + pack_file_name
+					+ " has a corrupt entry");
+				return false;
+			}
+		}
+
+		entries = toc;
+		entry_count = static_cast<size_t>(header.entry_count);
+		names = pack.data + header.names_offset;
+		return true;
+	}
+
+	[[nodiscard]]
+	const ResourcePackEntry* ResourceFilePack::find(const Resource& resource)
+		const noexcept
+	{
+		const uint64_t hash = resource_pack_hash(resource.name);
+		const ResourcePackEntry* end = entries + entry_count;
+		const ResourcePackEntry* entry = std::lower_bound(entries, end,
+			resource.name, [hash, this](const ResourcePackEntry& entry,
+				const std::string& name)
+			{
+				return entry_before(entry, hash, name, names);
+			});
+
+		if (entry == end || entry->name_hash != hash
+			|| std::string_view(names + entry->name_offset,
+				entry->name_length) != resource.name)
+		{
+			return nullptr;
+		}
+		return entry;
+	}
+
+	size_t ResourceFilePack::get_raw_resource_size(const Resource& resource)
+	{
+		const ResourcePackEntry* entry = find(resource);
+		if (entry == nullptr)
+		{
+			LOG_ERROR("Can not find " + resource.name + " in the resource pack");
+			return 0;
+		}
+		return static_cast<size_t>(entry->size);
+	}
+
+	size_t ResourceFilePack::get_resource_offset(const Resource& resource)
+	{
+		const ResourcePackEntry* entry = find(resource);
+		return entry ? static_cast<size_t>(entry->data_offset) : 0;
+	}
+
+	size_t ResourceFilePack::load_resource(const Resource& resource,
+		char* buffer)
+	{
+		if (buffer == nullptr)
+		{
+			LOG_WARNING("Destination buffer is null");
+			return 0;
+		}
+
+		const ResourcePackEntry* entry = find(resource);
+		if (entry == nullptr)
+		{
+			return 0;
+		}
+
+		memcpy(buffer, pack.data + entry->data_offset, entry->size);
+		return static_cast<size_t>(entry->size);
+	}
+
+	size_t ResourceFilePack::load_range(const Resource& resource,
+		size_t offset, size_t length, char* buffer)
+	{
+		if (buffer == nullptr)
+		{
+			LOG_WARNING("Destination buffer is null");
+			return 0;
+		}
+
+		const ResourcePackEntry* entry = find(resource);
+		if (entry == nullptr || offset >= entry->size)
+		{
+			return 0;
+		}
+
+		const size_t count = std::min<size_t>(length,
+			static_cast<size_t>(entry->size) - offset);
+		memcpy(buffer, pack.data + entry->data_offset + offset, count);
+		return count;
+	}
+
+	ResourceMapping ResourceFilePack::map_resource(const Resource& resource)
+	{
+		ResourceMapping mapping;
+		const ResourcePackEntry* entry = find(resource);
+		if (entry == nullptr || entry->size == 0)
+		{
+			return mapping;
+		}
+
+		mapping.data = pack.data + entry->data_offset;
+		mapping.size = static_cast<size_t>(entry->size);
+		mapping.owner = pack.owner;
+		return mapping;
+	}
+
+	const size_t ResourceFilePack::get_resource_count()
+	{
+		return entry_count;
+	}
+
+	std::string ResourceFilePack::get_resource_name(size_t index)
+	{
+		LOG_ASSERT(index < entry_count && "Invalid resource index");
+		if (index >= entry_count)
+		{
+			return std::string();
+		}
+		const ResourcePackEntry& entry = entries[index];
+		return std::string(names + entry.name_offset, entry.name_length);
+	}
+
+	bool ResourceFilePack::build(const std::string& folder_name,
+		const std::string& pack_file_name) noexcept
+	{
+		if (!fs::is_directory(folder_name))
+		{
+			LOG_ERROR("Resource folder " + folder_name + " does not exist!");
+			return false;
+		}
+
+		struct Source
+		{
+			std::string name;
+			fs::path path;
+			ResourcePackEntry entry;
+		};
+
+		std::vector<Source> sources;
+		for (auto const& file : fs::recursive_directory_iterator{ folder_name })
+		{
+			if (!fs::is_regular_file(file))
+			{
+				continue;
+			}
+
+			//NOTE(ches) resource names are always lower case, so the pack
+			// stores them that way
+			Resource resource{ fs::relative(file.path(), folder_name)
+				.generic_string() };
+			Source source{ resource.name, file.path(), {} };
+			source.entry.name_hash = resource_pack_hash(source.name);
+			source.entry.size = fs::file_size(file.path());
+			sources.push_back(std::move(source));
+		}
+
+		std::sort(sources.begin(), sources.end(),
+			[](const Source& a, const Source& b)
+			{
+				if (a.entry.name_hash != b.entry.name_hash)
+				{
+					return a.entry.name_hash < b.entry.name_hash;
+				}
+				return a.name < b.name;
+			});
+
+		auto duplicate = std::adjacent_find(sources.begin(), sources.end(),
+			[](const Source& a, const Source& b) { return a.name == b.name; });
+		if (duplicate != sources.end())
+		{
+			LOG_ERROR("Resource names differ only by case: " + duplicate->name);
+			return false;
+		}
+
+		ResourcePackHeader header{};
+		memcpy(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+		header.version = RESOURCE_PACK_VERSION;
+		header.entry_count = sources.size();
+		header.toc_offset = align_up(sizeof(header),
+			alignof(ResourcePackEntry));
+		header.names_offset = header.toc_offset
+			+ sources.size() * sizeof(ResourcePackEntry);
+
+		uint64_t names_size = 0;
+		for (Source& source : sources)
+		{
+			source.entry.name_offset = static_cast<uint32_t>(names_size);
+			source.entry.name_length = static_cast<uint32_t>(
+				source.name.size());
+			names_size += source.name.size();
+		}
+		header.names_size = names_size;
+
+		uint64_t data_offset = align_up(header.names_offset + names_size,
+			RESOURCE_PACK_ALIGNMENT);
+		for (Source& source : sources)
+		{
+			source.entry.data_offset = data_offset;
+			data_offset = align_up(data_offset + source.entry.size,
+				RESOURCE_PACK_ALIGNMENT);
+		}
+
+		std::ofstream pack(pack_file_name,
+			std::ios_base::binary | std::ios_base::trunc);
+		if (!pack)
+		{
+			LOG_ERROR("Could not create resource pack " + pack_file_name);
+			return false;
+		}
+
+		auto pad_to = [&pack](uint64_t offset)
+		{
+			static const char zeros[RESOURCE_PACK_ALIGNMENT] = {};
+			uint64_t position = static_cast<uint64_t>(pack.tellp());
+			while (position < offset)
+			{
+				const uint64_t count = std::min<uint64_t>(offset - position,
+					sizeof(zeros));
+				pack.write(zeros, count);
+				position += count;
+			}
+		};
+
+		pack.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		pad_to(header.toc_offset);
+		for (const Source& source : sources)
+		{
+			pack.write(reinterpret_cast<const char*>(&source.entry),
+				sizeof(source.entry));
+		}
+		for (const Source& source : sources)
+		{
+			pack.write(source.name.data(), source.name.size());
+		}
+
+		std::vector<char> buffer;
+		for (const Source& source : sources)
+		{
+			pad_to(source.entry.data_offset);
+			buffer.resize(static_cast<size_t>(source.entry.size));
+			std::ifstream file_bytes(source.path, std::ios_base::binary);
+			file_bytes.read(buffer.data(), buffer.size());
+			if (static_cast<uint64_t>(file_bytes.gcount())
+				!= source.entry.size)
+			{
+				LOG_ERROR("Could not read " + source.path.string());
+				return false;
+			}
+			pack.write(buffer.data(), buffer.size());
+		}
+		pad_to(data_offset);
+
+		return static_cast<bool>(pack);
+	}
+}
@@ -1,5 +1,6 @@
 #include "resource/resource_handle.h"
 
+#include "debug/logger.h"
 #include "main/memory_utils.h"
 #include "resource/resource_cache.h"
 
@@ -17,6 +18,12 @@ namespace loquat
 		return size;
 	}
 
+	[[nodiscard]]
+	double ResourceHandle::get_reload_cost() const noexcept
+	{
+		return reload_cost;
+	}
+
 	[[nodiscard]]
 	const char* ResourceHandle::get_buffer() const noexcept
 	{
@@ -26,6 +33,12 @@ namespace loquat
 	[[nodiscard]]
 	char* ResourceHandle::get_writeable_buffer() const noexcept
 	{
+		if (shared_buffer.load(std::memory_order_relaxed))
+		{
+			LOG_WARNING(resource.name + " shares its data with other "
+				"resources, so it can't be written");
+			return nullptr;
+		}
 		return buffer;
 	}
 
@@ -35,6 +48,13 @@ namespace loquat
 		return extra;
 	}
 
+	[[nodiscard]]
+	const std::vector<std::string>& ResourceHandle::get_dependencies() const
+		noexcept
+	{
+		return dependencies;
+	}
+
 	void ResourceHandle::set_extra(std::shared_ptr<ResourceExtraData> extra) noexcept
 	{
 		this->extra = extra;
@@ -45,13 +65,22 @@ namespace loquat
 		: resource{ resource }
 		, buffer{ buffer }
 		, size{ size }
+		, charged_size{ size }
+		, buffer_size{ size }
 		, extra{ std::shared_ptr<ResourceExtraData>() }
 		, resource_cache{ resource_cache }
 	{}
 
 	ResourceHandle::~ResourceHandle()
 	{
-		safe_delete_array(buffer);
-		resource_cache->memory_has_been_freed(size);
+		if (mapping)
+		{
+			mapping.reset();
+		}
+		else
+		{
+			resource_cache->release_buffer(buffer, buffer_size);
+		}
+		resource_cache->memory_has_been_freed(charged_size);
 	}
 }
\ No newline at end of file
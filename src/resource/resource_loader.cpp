@@ -1,9 +1,52 @@
 #include "resource/resource_loader.h"
 
+#include "resource/resource_handle.h"
+#include "resource/resource_stream.h"
+
 namespace loquat
 {
 	bool ResourceLoader::append_null()
 	{
 		return false;
 	}
+
+	void ResourceLoader::get_dependencies(const char* raw_buffer,
+		size_t raw_size, std::vector<std::string>& dependencies)
+	{}
+
+	std::string ResourceLoader::get_derived_data_version()
+	{
+		return std::string();
+	}
+
+	double ResourceLoader::get_reload_cost(size_t raw_size,
+		size_t loaded_size)
+	{
+		//NOTE(ches) assumes about a gigabyte a second from the file, and
+		// that finding and opening a resource costs as much as reading 50K
+		(void)loaded_size;
+		return 50.0 + static_cast<double>(raw_size) / 1000.0;
+	}
+
+	size_t ResourceLoader::get_streamed_resource_size(ResourceStream& stream)
+	{
+		return stream.get_size() - stream.tell();
+	}
+
+	bool ResourceLoader::load_stream(ResourceStream& stream,
+		std::shared_ptr<ResourceHandle> handle)
+	{
+		return stream.read(handle->get_writeable_buffer(), handle->get_size())
+			== handle->get_size();
+	}
+
+	bool ResourceLoader::prefer_mapped_raw()
+	{
+		return false;
+	}
+
+	bool ResourceLoader::use_stream()
+	{
+		return false;
+	}
 }
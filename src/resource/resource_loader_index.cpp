@@ -0,0 +1,132 @@
+#include "resource/resource_loader_index.h"
+
+#include <mutex>
+#include <string_view>
+
+#include "resource/resource_cache.h"
+
+namespace loquat
+{
+	namespace
+	{
+		/// <summary>
+		/// Everything after the last dot in a name, which may be empty.
+		/// </summary>
+		[[nodiscard]]
+		std::string_view extension_of(std::string_view name) noexcept
+		{
+			const size_t dot = name.rfind('.');
+			if (dot == std::string_view::npos)
+			{
+				return std::string_view();
+			}
+			return name.substr(dot + 1);
+		}
+	}
+
+	void ResourceLoaderIndex::add(std::shared_ptr<ResourceLoader> loader)
+		noexcept
+	{
+		CompiledPattern compiled;
+		compiled.pattern = loader->get_pattern();
+		compiled.loader = std::move(loader);
+
+		//NOTE(ches) a '?' never matches a dot, and a suffix without a dot
+		// has no extension to key on, so both of those stay globs
+		const std::string_view pattern = compiled.pattern;
+		const size_t literal_start = pattern.find_first_not_of('*');
+		const std::string_view suffix = literal_start == std::string_view::npos
+			? std::string_view() : pattern.substr(literal_start);
+		const bool suffix_pattern = literal_start != 0
+			&& suffix.find_first_of("*?") == std::string_view::npos
+			&& suffix.find('.') != std::string_view::npos;
+
+		std::unique_lock index_lock{ index_mutex };
+		compiled.priority = next_priority++;
+		if (suffix_pattern)
+		{
+			compiled.suffix = suffix;
+			std::vector<CompiledPattern>& bucket =
+				by_extension[std::string(extension_of(suffix))];
+			bucket.insert(bucket.begin(), std::move(compiled));
+		}
+		else
+		{
+			globs.insert(globs.begin(), std::move(compiled));
+		}
+		chosen.clear();
+	}
+
+	[[nodiscard]]
+	std::shared_ptr<ResourceLoader> ResourceLoaderIndex::match(
+		const std::string& name) const noexcept
+	{
+		const CompiledPattern* best = nullptr;
+
+		auto bucket = by_extension.find(extension_of(name));
+		if (bucket != by_extension.end())
+		{
+			for (const CompiledPattern& compiled : bucket->second)
+			{
+				if (name.ends_with(compiled.suffix))
+				{
+					best = &compiled;
+					break;
+				}
+			}
+		}
+
+		for (const CompiledPattern& compiled : globs)
+		{
+			if (best != nullptr && compiled.priority < best->priority)
+			{
+				break;
+			}
+			if (compiled.pattern == "*"
+				|| wildcard_match(compiled.pattern.c_str(), name.c_str()))
+			{
+				best = &compiled;
+				break;
+			}
+		}
+
+		return best ? best->loader : std::shared_ptr<ResourceLoader>();
+	}
+
+	[[nodiscard]]
+	std::shared_ptr<ResourceLoader> ResourceLoaderIndex::find(
+		const std::string& name) noexcept
+	{
+		std::shared_ptr<ResourceLoader> loader;
+		size_t priority_seen;
+		{
+			std::shared_lock index_lock{ index_mutex };
+			auto result = chosen.find(name);
+			if (result != chosen.end())
+			{
+				return result->second;
+			}
+			loader = match(name);
+			priority_seen = next_priority;
+		}
+
+		if (loader)
+		{
+			//NOTE(ches) if a loader was added while we were matching, our
+			// answer may already be out of date, so don't remember it
+			std::unique_lock index_lock{ index_mutex };
+			if (priority_seen == next_priority)
+			{
+				//NOTE(ches) starting over is cheaper than tracking which
+				// names were used least recently, and a forgotten choice is
+				// only a match away
+				if (chosen.size() >= MAX_CHOSEN)
+				{
+					chosen.clear();
+				}
+				chosen.emplace(name, loader);
+			}
+		}
+		return loader;
+	}
+}
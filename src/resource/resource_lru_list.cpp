@@ -0,0 +1,95 @@
+#include "resource/resource_lru_list.h"
+
+#include "debug/logger.h"
+#include "resource/resource_handle.h"
+
+namespace loquat
+{
+	void ResourceLRUList::push_front(ResourceHandle* handle) noexcept
+	{
+		LOG_ASSERT(!contains(handle) && "Handle is already in an LRU list");
+
+		handle->lru_previous = nullptr;
+		handle->lru_next = head;
+		if (head)
+		{
+			head->lru_previous = handle;
+		}
+		else
+		{
+			tail = handle;
+		}
+		head = handle;
+		++count;
+	}
+
+	void ResourceLRUList::remove(ResourceHandle* handle) noexcept
+	{
+		if (!contains(handle))
+		{
+			return;
+		}
+
+		if (handle->lru_previous)
+		{
+			handle->lru_previous->lru_next = handle->lru_next;
+		}
+		else
+		{
+			head = handle->lru_next;
+		}
+
+		if (handle->lru_next)
+		{
+			handle->lru_next->lru_previous = handle->lru_previous;
+		}
+		else
+		{
+			tail = handle->lru_previous;
+		}
+
+		handle->lru_previous = nullptr;
+		handle->lru_next = nullptr;
+		--count;
+	}
+
+	void ResourceLRUList::move_to_front(ResourceHandle* handle) noexcept
+	{
+		if (head == handle)
+		{
+			return;
+		}
+		remove(handle);
+		push_front(handle);
+	}
+
+	[[nodiscard]]
+	bool ResourceLRUList::contains(const ResourceHandle* handle) const noexcept
+	{
+		return handle->lru_previous != nullptr || head == handle;
+	}
+
+	[[nodiscard]]
+	ResourceHandle* ResourceLRUList::front() const noexcept
+	{
+		return head;
+	}
+
+	[[nodiscard]]
+	ResourceHandle* ResourceLRUList::back() const noexcept
+	{
+		return tail;
+	}
+
+	[[nodiscard]]
+	bool ResourceLRUList::empty() const noexcept
+	{
+		return count == 0;
+	}
+
+	[[nodiscard]]
+	size_t ResourceLRUList::size() const noexcept
+	{
+		return count;
+	}
+}
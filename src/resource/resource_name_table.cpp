@@ -0,0 +1,185 @@
+#include "resource/resource_name_table.h"
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cstring>
+
+#include "resource/resource_file.h"
+
+namespace loquat
+{
+	namespace
+	{
+		constexpr size_t WORD_SIZE = sizeof(uint64_t);
+
+		/// <summary>
+		/// The most names whose heads and tails are checked before the ones
+		/// that passed are matched in full, one bit per name.
+		/// </summary>
+		constexpr size_t FILTER_BLOCK = 64;
+
+		/// <summary>
+		/// Pack the first eight characters of some text into a word, padded
+		/// with zeros at the end.
+		/// </summary>
+		[[nodiscard]]
+		uint64_t head_word(std::string_view text) noexcept
+		{
+			char bytes[WORD_SIZE] = {};
+			memcpy(bytes, text.data(), std::min(text.size(), WORD_SIZE));
+			uint64_t word;
+			memcpy(&word, bytes, WORD_SIZE);
+			return word;
+		}
+
+		/// <summary>
+		/// Pack the last eight characters of some text into a word, padded
+		/// with zeros at the start.
+		/// </summary>
+		[[nodiscard]]
+		uint64_t tail_word(std::string_view text) noexcept
+		{
+			char bytes[WORD_SIZE] = {};
+			const size_t length = std::min(text.size(), WORD_SIZE);
+			memcpy(bytes + WORD_SIZE - length,
+				text.data() + text.size() - length, length);
+			uint64_t word;
+			memcpy(&word, bytes, WORD_SIZE);
+			return word;
+		}
+
+		/// <summary>
+		/// A mask over the characters head_word packed from text of a given
+		/// length.
+		/// </summary>
+		[[nodiscard]]
+		uint64_t head_mask(const size_t length) noexcept
+		{
+			char bytes[WORD_SIZE] = {};
+			memset(bytes, 0xff, std::min(length, WORD_SIZE));
+			uint64_t mask;
+			memcpy(&mask, bytes, WORD_SIZE);
+			return mask;
+		}
+
+		/// <summary>
+		/// A mask over the characters tail_word packed from text of a given
+		/// length.
+		/// </summary>
+		[[nodiscard]]
+		uint64_t tail_mask(const size_t length) noexcept
+		{
+			char bytes[WORD_SIZE] = {};
+			const size_t masked = std::min(length, WORD_SIZE);
+			memset(bytes + WORD_SIZE - masked, 0xff, masked);
+			uint64_t mask;
+			memcpy(&mask, bytes, WORD_SIZE);
+			return mask;
+		}
+
+		[[nodiscard]]
+		std::string lowercase(std::string_view text) noexcept
+		{
+			std::string result{ text };
+			std::transform(result.begin(), result.end(), result.begin(),
+				[](unsigned char c) { return std::tolower(c); });
+			return result;
+		}
+	}
+
+	ResourceNameTable::ResourceNameTable(ResourceFile& file) noexcept
+	{
+		const size_t count = file.get_resource_count();
+		offsets.reserve(count + 1);
+		heads.reserve(count);
+		tails.reserve(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			offsets.push_back(static_cast<uint32_t>(names.size()));
+			names += file.get_resource_name(i);
+		}
+		offsets.push_back(static_cast<uint32_t>(names.size()));
+
+		lowered = lowercase(names);
+		for (size_t i = 0; i < count; ++i)
+		{
+			const std::string_view name = get_lowered_name(i);
+			heads.push_back(head_word(name));
+			tails.push_back(tail_word(name));
+		}
+	}
+
+	[[nodiscard]]
+	size_t ResourceNameTable::size() const noexcept
+	{
+		return heads.size();
+	}
+
+	[[nodiscard]]
+	std::string_view ResourceNameTable::get_name(const size_t index) const
+		noexcept
+	{
+		return std::string_view(names).substr(offsets[index],
+			offsets[index + 1] - offsets[index]);
+	}
+
+	[[nodiscard]]
+	std::string_view ResourceNameTable::get_lowered_name(const size_t index)
+		const noexcept
+	{
+		return std::string_view(lowered).substr(offsets[index],
+			offsets[index + 1] - offsets[index]);
+	}
+
+	void ResourceNameTable::filter(const GlobPattern& pattern,
+		std::string_view lowered_prefix, std::string_view lowered_suffix,
+		bool ignore_case, std::vector<uint32_t>& matches) const noexcept
+	{
+		const uint64_t head_key = head_word(lowered_prefix);
+		const uint64_t head_bits = head_mask(lowered_prefix.size());
+		const uint64_t tail_key = tail_word(lowered_suffix);
+		const uint64_t tail_bits = tail_mask(lowered_suffix.size());
+
+		const size_t count = size();
+		for (size_t block = 0; block < count; block += FILTER_BLOCK)
+		{
+			//NOTE(ches) no branches in here, so the compiler is free to
+			// check several names per instruction
+			const size_t block_end = std::min(count, block + FILTER_BLOCK);
+			uint64_t candidates = 0;
+			for (size_t i = block; i < block_end; ++i)
+			{
+				const bool pass = ((heads[i] & head_bits) == head_key)
+					& ((tails[i] & tail_bits) == tail_key);
+				candidates |= static_cast<uint64_t>(pass) << (i - block);
+			}
+
+			while (candidates != 0)
+			{
+				const size_t index = block + std::countr_zero(candidates);
+				candidates &= candidates - 1;
+				const std::string_view name = ignore_case
+					? get_lowered_name(index) : get_name(index);
+				if (pattern.matches(name))
+				{
+					matches.push_back(static_cast<uint32_t>(index));
+				}
+			}
+		}
+	}
+
+	[[nodiscard]]
+	std::vector<uint32_t> ResourceNameTable::match(const GlobPattern& pattern,
+		const bool ignore_case) const noexcept
+	{
+		//NOTE(ches) the heads and tails are lowercased, which only tells us
+		// which names can't match, so a case sensitive match still has to
+		// check the real names afterwards
+		const std::string prefix = lowercase(pattern.get_prefix());
+		const std::string suffix = lowercase(pattern.get_suffix());
+		std::vector<uint32_t> matches;
+		filter(pattern, prefix, suffix, ignore_case, matches);
+		return matches;
+	}
+}
@@ -0,0 +1,110 @@
+#include "resource/resource_stream.h"
+
+#include <algorithm>
+
+#include "debug/logger.h"
+#include "main/memory_utils.h"
+#include "resource/resource_file.h"
+
+namespace loquat
+{
+	size_t ResourceStream::read_range(size_t offset, size_t length,
+		char* buffer) noexcept
+	{
+		return file->load_range(resource, offset, length, buffer);
+	}
+
+	ResourceStream::ResourceStream(ResourceFile* file,
+		const Resource& resource, size_t size) noexcept
+		: file{ file }
+		, resource{ resource }
+		, size{ size }
+	{}
+
+	ResourceStream::~ResourceStream()
+	{}
+
+	[[nodiscard]]
+	const std::string& ResourceStream::get_name() const noexcept
+	{
+		return resource.name;
+	}
+
+	[[nodiscard]]
+	size_t ResourceStream::get_size() const noexcept
+	{
+		return size;
+	}
+
+	[[nodiscard]]
+	size_t ResourceStream::tell() const noexcept
+	{
+		return position;
+	}
+
+	[[nodiscard]]
+	bool ResourceStream::at_end() const noexcept
+	{
+		return position >= size;
+	}
+
+	bool ResourceStream::seek(size_t offset) noexcept
+	{
+		if (offset > size)
+		{
+			return false;
+		}
+		position = offset;
+		return true;
+	}
+
+	size_t ResourceStream::read(char* buffer, size_t length) noexcept
+	{
+		const size_t count = read_at(position, length, buffer);
+		position += count;
+		return count;
+	}
+
+	size_t ResourceStream::read_at(size_t offset, size_t length,
+		char* buffer) noexcept
+	{
+		if (buffer == nullptr || offset >= size)
+		{
+			return 0;
+		}
+		return read_range(offset, std::min(length, size - offset), buffer);
+	}
+
+	bool ResourceStream::for_each_chunk(size_t chunk_size,
+		const ResourceChunkCallback& callback) noexcept
+	{
+		if (chunk_size == 0)
+		{
+			return false;
+		}
+
+		const size_t buffer_size = std::min(chunk_size, size - position);
+		const size_t allocation_size = std::max<size_t>(buffer_size, 1);
+		char* chunk = static_cast<char*>(
+			g_allocator->allocate_bytes(allocation_size));
+		bool success = true;
+		while (!at_end())
+		{
+			const size_t expected = std::min(buffer_size, size - position);
+			const size_t count = read(chunk, expected);
+			if (count != expected)
+			{
+				LOG_WARNING("Could not read all of " + resource.name);
+				success = false;
+				break;
+			}
+			if (!callback(chunk, count))
+			{
+				success = false;
+				break;
+			}
+		}
+		g_allocator->deallocate_bytes(chunk, allocation_size);
+		return success;
+	}
+}
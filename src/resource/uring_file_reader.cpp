@@ -0,0 +1,539 @@
+#include "resource/uring_file_reader.h"
+
+#include "debug/logger.h"
+#include "main/memory_utils.h"
+
+#if defined(__linux__)
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace loquat
+{
+	namespace
+	{
+		/// <summary>
+		/// What each submission is doing, kept in the low bits of its user
+		/// data, with the index of its read above them.
+		/// </summary>
+		enum Operation : uint64_t
+		{
+			OPERATION_OPEN = 0,
+			OPERATION_READ = 1,
+			OPERATION_CLOSE = 2
+		};
+
+		constexpr uint64_t OPERATION_BITS = 2;
+		constexpr uint64_t OPERATION_MASK = (1 << OPERATION_BITS) - 1;
+
+		/// <summary>
+		/// The most we ask for in one read, since the length is 32 bits.
+		/// </summary>
+		constexpr size_t MAX_READ_LENGTH = size_t{ 1 } << 30;
+
+		[[nodiscard]]
+		uint32_t load_acquire(uint32_t* value) noexcept
+		{
+			return std::atomic_ref<uint32_t>{ *value }.load(
+				std::memory_order_acquire);
+		}
+
+		void store_release(uint32_t* value, uint32_t new_value) noexcept
+		{
+			std::atomic_ref<uint32_t>{ *value }.store(new_value,
+				std::memory_order_release);
+		}
+
+		[[nodiscard]]
+		void* map_ring(int ring, size_t size, off_t offset) noexcept
+		{
+			void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, ring, offset);
+			return mapping == MAP_FAILED ? nullptr : mapping;
+		}
+	}
+
+	[[nodiscard]]
+	UringFileReader* UringFileReader::create(size_t queue_depth) noexcept
+	{
+		UringFileReader* reader = alloc<UringFileReader>();
+		reader->queue_depth = static_cast<uint32_t>(
+			std::clamp<size_t>(queue_depth, 1, 4096));
+
+		//NOTE(ches) the first ring is only kept if it can do everything we
+		// need, the rest are made as threads need them
+		Ring* ring = alloc<Ring>();
+		if (!ring->setup(reader->queue_depth) || !ring->supports_operations())
+		{
+			safe_delete(ring);
+			safe_delete(reader);
+			return nullptr;
+		}
+		reader->idle_rings.push_back(ring);
+		reader->ring_count = 1;
+		return reader;
+	}
+
+	[[nodiscard]]
+	bool UringFileReader::Ring::setup(uint32_t depth) noexcept
+	{
+		io_uring_params params;
+		memset(&params, 0, sizeof(params));
+		ring = static_cast<int>(syscall(__NR_io_uring_setup, depth, &params));
+		if (ring < 0)
+		{
+			return false;
+		}
+		queue_depth = params.sq_entries;
+		completion_depth = params.cq_entries;
+
+		submission_ring_size = params.sq_off.array
+			+ params.sq_entries * sizeof(uint32_t);
+		completion_ring_size = params.cq_off.cqes
+			+ params.cq_entries * sizeof(io_uring_cqe);
+
+		//NOTE(ches) newer kernels map both rings together, in which case
+		// the one mapping has to be big enough for either
+		const bool single_mapping =
+			(params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if (single_mapping)
+		{
+			submission_ring_size = std::max(submission_ring_size,
+				completion_ring_size);
+			completion_ring_size = submission_ring_size;
+		}
+
+		submission_ring = map_ring(ring, submission_ring_size,
+			IORING_OFF_SQ_RING);
+		if (submission_ring == nullptr)
+		{
+			return false;
+		}
+		completion_ring = single_mapping ? submission_ring
+			: map_ring(ring, completion_ring_size, IORING_OFF_CQ_RING);
+		if (completion_ring == nullptr)
+		{
+			return false;
+		}
+
+		submission_entries_size = params.sq_entries * sizeof(io_uring_sqe);
+		submission_entries = static_cast<io_uring_sqe*>(map_ring(ring,
+			submission_entries_size, IORING_OFF_SQES));
+		if (submission_entries == nullptr)
+		{
+			return false;
+		}
+
+		char* submission_base = static_cast<char*>(submission_ring);
+		submission_head = reinterpret_cast<uint32_t*>(
+			submission_base + params.sq_off.head);
+		submission_tail = reinterpret_cast<uint32_t*>(
+			submission_base + params.sq_off.tail);
+		submission_mask = reinterpret_cast<uint32_t*>(
+			submission_base + params.sq_off.ring_mask);
+		submission_array = reinterpret_cast<uint32_t*>(
+			submission_base + params.sq_off.array);
+
+		char* completion_base = static_cast<char*>(completion_ring);
+		completion_head = reinterpret_cast<uint32_t*>(
+			completion_base + params.cq_off.head);
+		completion_tail = reinterpret_cast<uint32_t*>(
+			completion_base + params.cq_off.tail);
+		completion_mask = reinterpret_cast<uint32_t*>(
+			completion_base + params.cq_off.ring_mask);
+		completions = reinterpret_cast<io_uring_cqe*>(
+			completion_base + params.cq_off.cqes);
+		return true;
+	}
+
+	[[nodiscard]]
+	bool UringFileReader::Ring::supports_operations() noexcept
+	{
+		constexpr size_t PROBE_OPERATIONS = 256;
+		std::vector<char> storage(sizeof(io_uring_probe)
+			+ PROBE_OPERATIONS * sizeof(io_uring_probe_op), 0);
+		io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(
+			storage.data());
+
+		if (syscall(__NR_io_uring_register, ring, IORING_REGISTER_PROBE,
+			probe, PROBE_OPERATIONS) < 0)
+		{
+			return false;
+		}
+
+		for (const uint8_t operation : { IORING_OP_OPENAT, IORING_OP_READ,
+			IORING_OP_CLOSE })
+		{
+			if (operation > probe->last_op
+				|| (probe->ops[operation].flags & IO_URING_OP_SUPPORTED) == 0)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	[[nodiscard]]
+	bool UringFileReader::Ring::queue_submission(const io_uring_sqe& entry)
+		noexcept
+	{
+		const uint32_t head = load_acquire(submission_head);
+		const uint32_t tail = *submission_tail;
+		if (tail - head >= queue_depth)
+		{
+			return false;
+		}
+
+		const uint32_t index = tail & *submission_mask;
+		submission_entries[index] = entry;
+		submission_array[index] = index;
+		store_release(submission_tail, tail + 1);
+		return true;
+	}
+
+	[[nodiscard]]
+	uint32_t UringFileReader::Ring::unqueue_submissions() noexcept
+	{
+		//NOTE(ches) the kernel only takes entries while we are in
+		// io_uring_enter, so the ones past its head are still ours
+		const uint32_t head = load_acquire(submission_head);
+		const uint32_t unqueued = *submission_tail - head;
+		store_release(submission_tail, head);
+		return unqueued;
+	}
+
+	UringFileReader::Ring::~Ring()
+	{
+		if (submission_entries != nullptr)
+		{
+			munmap(submission_entries, submission_entries_size);
+		}
+		if (completion_ring != nullptr && completion_ring != submission_ring)
+		{
+			munmap(completion_ring, completion_ring_size);
+		}
+		if (submission_ring != nullptr)
+		{
+			munmap(submission_ring, submission_ring_size);
+		}
+		if (ring >= 0)
+		{
+			close(ring);
+		}
+	}
+
+	UringFileReader::~UringFileReader()
+	{
+		for (Ring* ring : idle_rings)
+		{
+			safe_delete(ring);
+		}
+	}
+
+	[[nodiscard]]
+	UringFileReader::Ring* UringFileReader::take_ring() noexcept
+	{
+		{
+			std::lock_guard<std::mutex> lock(ring_mutex);
+			if (!idle_rings.empty())
+			{
+				Ring* ring = idle_rings.back();
+				idle_rings.pop_back();
+				return ring;
+			}
+			++ring_count;
+		}
+
+		Ring* ring = alloc<Ring>();
+		if (ring->setup(queue_depth))
+		{
+			return ring;
+		}
+		safe_delete(ring);
+
+		//NOTE(ches) most likely we are out of locked memory for rings, so
+		// share the ones we have
+		std::unique_lock<std::mutex> lock(ring_mutex);
+		--ring_count;
+		ring_returned.wait(lock, [this]()
+			{
+				return !idle_rings.empty() || ring_count == 0;
+			});
+		if (idle_rings.empty())
+		{
+			return nullptr;
+		}
+		ring = idle_rings.back();
+		idle_rings.pop_back();
+		return ring;
+	}
+
+	void UringFileReader::return_ring(Ring* ring) noexcept
+	{
+		{
+			std::lock_guard<std::mutex> lock(ring_mutex);
+			idle_rings.push_back(ring);
+		}
+		ring_returned.notify_one();
+	}
+
+	void UringFileReader::discard_ring(Ring* ring) noexcept
+	{
+		safe_delete(ring);
+		{
+			std::lock_guard<std::mutex> lock(ring_mutex);
+			--ring_count;
+		}
+		ring_returned.notify_all();
+	}
+
+	void UringFileReader::read(std::vector<FileRead>& reads) noexcept
+	{
+		for (FileRead& file_read : reads)
+		{
+			file_read.bytes_read = 0;
+		}
+
+		Ring* ring = take_ring();
+		if (ring == nullptr)
+		{
+			LOG_ERROR("No io_uring left to read with");
+			return;
+		}
+
+		struct Pending
+		{
+			size_t index;
+			Operation operation;
+		};
+
+		std::vector<int> descriptors(reads.size(), -1);
+		std::deque<Pending> pending;
+		for (size_t i = 0; i < reads.size(); ++i)
+		{
+			pending.push_back({ i, OPERATION_OPEN });
+		}
+
+		size_t finished = 0;
+		size_t in_flight = 0;
+		uint32_t unsubmitted = 0;
+		bool failed = false;
+		while (finished < reads.size())
+		{
+			//NOTE(ches) never have more in flight than the completion queue
+			// holds, so completions can't be dropped
+			while (!pending.empty() && in_flight < ring->completion_depth)
+			{
+				const Pending next = pending.front();
+				FileRead& file_read = reads[next.index];
+
+				io_uring_sqe entry;
+				memset(&entry, 0, sizeof(entry));
+				entry.user_data = (static_cast<uint64_t>(next.index)
+					<< OPERATION_BITS) | next.operation;
+				if (next.operation == OPERATION_OPEN)
+				{
+					entry.opcode = IORING_OP_OPENAT;
+					entry.fd = AT_FDCWD;
+					entry.addr = reinterpret_cast<uint64_t>(
+						file_read.path.c_str());
+					entry.open_flags = O_RDONLY | O_CLOEXEC;
+				}
+				else if (next.operation == OPERATION_READ)
+				{
+					entry.opcode = IORING_OP_READ;
+					entry.fd = descriptors[next.index];
+					entry.addr = reinterpret_cast<uint64_t>(
+						file_read.buffer + file_read.bytes_read);
+					entry.len = static_cast<uint32_t>(std::min(MAX_READ_LENGTH,
+						file_read.length - file_read.bytes_read));
+					entry.off = file_read.offset + file_read.bytes_read;
+				}
+				else
+				{
+					entry.opcode = IORING_OP_CLOSE;
+					entry.fd = descriptors[next.index];
+				}
+
+				if (!ring->queue_submission(entry))
+				{
+					break;
+				}
+				if (next.operation == OPERATION_CLOSE)
+				{
+					//NOTE(ches) the close owns the descriptor now, so it
+					// can't be closed twice if we have to give up
+					descriptors[next.index] = -1;
+				}
+				pending.pop_front();
+				++unsubmitted;
+				++in_flight;
+			}
+
+			const int submitted = static_cast<int>(syscall(
+				__NR_io_uring_enter, ring->ring, unsubmitted, 1,
+				IORING_ENTER_GETEVENTS, nullptr, 0));
+			if (submitted < 0)
+			{
+				if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+				{
+					continue;
+				}
+				//NOTE(ches) this only happens if we misuse the ring
+				LOG_ERROR(std::string("io_uring_enter failed: ")
+					+ strerror(errno));
+				failed = true;
+				break;
+			}
+			unsubmitted -= static_cast<uint32_t>(submitted);
+
+			uint32_t head = *ring->completion_head;
+			const uint32_t tail = load_acquire(ring->completion_tail);
+			while (head != tail)
+			{
+				const io_uring_cqe& completion =
+					ring->completions[head & *ring->completion_mask];
+				++head;
+				--in_flight;
+
+				const size_t index = static_cast<size_t>(
+					completion.user_data >> OPERATION_BITS);
+				const Operation operation = static_cast<Operation>(
+					completion.user_data & OPERATION_MASK);
+				FileRead& file_read = reads[index];
+
+				if (operation == OPERATION_OPEN)
+				{
+					if (completion.res < 0)
+					{
+						++finished;
+						continue;
+					}
+					descriptors[index] = completion.res;
+					pending.push_back({ index, file_read.length > 0
+						? OPERATION_READ : OPERATION_CLOSE });
+				}
+				else if (operation == OPERATION_READ)
+				{
+					if (completion.res == -EAGAIN || completion.res == -EINTR)
+					{
+						pending.push_back({ index, OPERATION_READ });
+						continue;
+					}
+					if (completion.res > 0)
+					{
+						file_read.bytes_read +=
+							static_cast<size_t>(completion.res);
+					}
+					//NOTE(ches) short reads are allowed, so keep reading
+					// until the file runs out
+					const bool more = completion.res > 0
+						&& file_read.bytes_read < file_read.length;
+					pending.push_back({ index, more ? OPERATION_READ
+						: OPERATION_CLOSE });
+				}
+				else
+				{
+					++finished;
+				}
+			}
+			store_release(ring->completion_head, head);
+		}
+
+		if (!failed)
+		{
+			return_ring(ring);
+			return;
+		}
+
+		//NOTE(ches) whatever the kernel has taken can still write into the
+		// buffers, so wait for all of it before handing them back
+		in_flight -= ring->unqueue_submissions();
+		bool drained = true;
+		while (in_flight > 0)
+		{
+			if (syscall(__NR_io_uring_enter, ring->ring, 0, 1,
+				IORING_ENTER_GETEVENTS, nullptr, 0) < 0)
+			{
+				if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+				{
+					continue;
+				}
+				drained = false;
+				break;
+			}
+
+			uint32_t head = *ring->completion_head;
+			const uint32_t tail = load_acquire(ring->completion_tail);
+			for (; head != tail; ++head)
+			{
+				const io_uring_cqe& completion =
+					ring->completions[head & *ring->completion_mask];
+				--in_flight;
+				if ((completion.user_data & OPERATION_MASK) == OPERATION_OPEN
+					&& completion.res >= 0)
+				{
+					close(completion.res);
+				}
+			}
+			store_release(ring->completion_head, head);
+		}
+
+		for (const int descriptor : descriptors)
+		{
+			if (descriptor >= 0)
+			{
+				close(descriptor);
+			}
+		}
+		if (!drained)
+		{
+			LOG_ERROR("Gave up waiting on io_uring, closing it to cancel "
+				"the rest of the batch");
+		}
+		//NOTE(ches) don't trust the ring with another batch
+		discard_ring(ring);
+	}
+
+	[[nodiscard]]
+	const char* UringFileReader::get_name() const noexcept
+	{
+		return "io_uring";
+	}
+}
+
+#else
+
+namespace loquat
+{
+	[[nodiscard]]
+	UringFileReader* UringFileReader::create(size_t queue_depth) noexcept
+	{
+		return nullptr;
+	}
+
+	UringFileReader::~UringFileReader()
+	{}
+
+	void UringFileReader::read(std::vector<FileRead>& reads) noexcept
+	{
+		LOG_ERROR("io_uring is only available on Linux");
+	}
+
+	[[nodiscard]]
+	const char* UringFileReader::get_name() const noexcept
+	{
+		return "io_uring";
+	}
+}
+
+#endif
@@ -7,30 +7,61 @@
 namespace loquat
 {
 	ShaderModule::ShaderModule(std::string_view name)
+		: name{ name }
 	{
 		Resource shader_resource{ name };
 		auto handle = g_resource_cache->get_handle(&shader_resource);
 
+		if (!handle || !create(handle))
+		{
+			LOG_FATAL(std::format("Could not load shader module {}!", name));
+		}
+
+		subscription = g_resource_cache->subscribe(shader_resource,
+			[this](std::shared_ptr<ResourceHandle> handle)
+			{
+				if (!create(handle))
+				{
+					LOG_ERROR(std::format(
+						"Could not reload shader module {}, keeping the old one",
+						this->name));
+				}
+			});
+	}
+
+	ShaderModule::~ShaderModule()
+	{
+		g_resource_cache->unsubscribe(subscription);
+		if (shader_module)
+		{
+			vkDestroyShaderModule(g_global_state->device->logical_device,
+				shader_module, nullptr);
+		}
+	}
+
+	bool ShaderModule::create(const std::shared_ptr<ResourceHandle>& handle)
+		noexcept
+	{
 		VkShaderModuleCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
 		createInfo.codeSize = handle->get_size();
 		createInfo.pCode = reinterpret_cast<const uint32_t*>(
 			handle->get_buffer());
 
-		if (vkCreateShaderModule(g_global_state->device->logical_device, 
-			&createInfo, nullptr, &shader_module) != VK_SUCCESS)
+		VkShaderModule created = nullptr;
+		if (vkCreateShaderModule(g_global_state->device->logical_device,
+			&createInfo, nullptr, &created) != VK_SUCCESS)
 		{
-			LOG_FATAL(std::format("Could not load shader module {}!", name));
+			return false;
 		}
-	}
 
-	ShaderModule::~ShaderModule()
-	{
 		if (shader_module)
 		{
 			vkDestroyShaderModule(g_global_state->device->logical_device,
 				shader_module, nullptr);
 		}
+		shader_module = created;
+		return true;
 	}
 
 	[[nodiscard]]
@@ -71,4 +102,12 @@ namespace loquat
 	}
 
 	Shader::~Shader() = default;
+
+	void Shader::refresh_modules() noexcept
+	{
+		for (size_t i = 0; i < modules.size(); ++i)
+		{
+			create_info_list[i].module = modules[i]->shader_module;
+		}
+	}
 }
\ No newline at end of file
@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "debug/logger.h"
+#include "main/memory_tracking.h"
+#include "main/memory_utils.h"
+#include "resource/resource.h"
+#include "resource/resource_cache.h"
+
+namespace loquat
+{
+	Allocator* g_allocator = new Allocator(
+		&get_memory_resource(MemoryTag::General));
+	ResourceCache* g_resource_cache;
+}
+
+namespace
+{
+	using namespace loquat;
+
+	/// <summary>
+	/// The size of every resource, small so that the cache itself is what
+	/// gets measured rather than copying data.
+	/// </summary>
+	constexpr size_t RESOURCE_SIZE = 16;
+
+	/// <summary>
+	/// The number of hits timed for each row.
+	/// </summary>
+	constexpr size_t LOOKUP_COUNT = 1000000;
+
+	/// <summary>
+	/// The number of resources in the hot set, few enough that everything
+	/// a hit touches for them stays in cache.
+	/// </summary>
+	constexpr size_t HOT_COUNT = 1024;
+
+	/// <summary>
+	/// A resource file that makes up its resources, so nothing is read
+	/// from disk.
+	/// </summary>
+	class GeneratedResourceFile : public ResourceFile
+	{
+	public:
+		explicit GeneratedResourceFile(const size_t count)
+			: count(count)
+		{}
+
+		bool open() override
+		{
+			return true;
+		}
+
+		size_t get_raw_resource_size(const Resource&) override
+		{
+			return RESOURCE_SIZE;
+		}
+
+		size_t load_resource(const Resource&, char* buffer) override
+		{
+			memset(buffer, 1, RESOURCE_SIZE);
+			return RESOURCE_SIZE;
+		}
+
+		const size_t get_resource_count() override
+		{
+			return count;
+		}
+
+		std::string get_resource_name(size_t index) override
+		{
+			return "bench/" + std::to_string(index) + ".bin";
+		}
+
+	private:
+		size_t count;
+	};
+
+	/// <summary>
+	/// Time hits on resources picked in a given order.
+	/// </summary>
+	/// <returns>The average time of one hit, in nanoseconds.</returns>
+	[[nodiscard]]
+	double time_hits(ResourceCache& cache, std::vector<Resource>& resources,
+		const std::vector<size_t>& order)
+	{
+		size_t bytes = 0;
+		const auto start = std::chrono::steady_clock::now();
+		for (const size_t index : order)
+		{
+			bytes += cache.get_handle(&resources[index])->get_size();
+		}
+		const auto end = std::chrono::steady_clock::now();
+
+		//NOTE(ches) used, so the hits can't be optimized away
+		if (bytes != order.size() * RESOURCE_SIZE)
+		{
+			fprintf(stderr, "A hit returned the wrong resource\n");
+		}
+		return std::chrono::duration<double, std::nano>(end - start).count()
+			/ static_cast<double>(order.size());
+	}
+}
+
+/// <summary>
+/// Measures how long a resource cache hit takes as the number of resident
+/// resources grows. Each row times hits on names picked at random from
+/// everything resident, and then hits on a fixed hot set of names.
+///
+/// The hot set column is what the cache's own work costs, and should stay
+/// flat. The random column also pays for cache and TLB misses on the map
+/// node, the handle and its neighbours in the eviction list, which grow
+/// with the working set rather than with any search.
+///
+/// Usage: loquat_bench_cache [largest resident count]
+/// </summary>
+int main(int argc, char* argv[])
+{
+	const size_t largest = argc > 1
+		? static_cast<size_t>(strtoull(argv[1], nullptr, 10)) : 1000000;
+
+	Logger::init();
+	printf("%12s %14s %14s\n", "resident", "random ns/hit", "hot ns/hit");
+	for (size_t count = 100; count <= largest; count *= 10)
+	{
+		GeneratedResourceFile* file = alloc<GeneratedResourceFile>(count);
+		ResourceCache* cache = alloc<ResourceCache>(4096, file);
+		if (!cache->init())
+		{
+			fprintf(stderr, "Failed to initialize the resource cache\n");
+			safe_delete(cache);
+			return 1;
+		}
+
+		std::vector<Resource> resources;
+		resources.reserve(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			resources.emplace_back(file->get_resource_name(i));
+			//NOTE(ches) only warms the cache, the handle isn't needed
+			(void)cache->get_handle(&resources[i]);
+		}
+
+		std::mt19937_64 random(count);
+		std::uniform_int_distribution<size_t> any(0, count - 1);
+		std::vector<size_t> hot(std::min(count, HOT_COUNT));
+		for (size_t& index : hot)
+		{
+			index = any(random);
+		}
+		std::uniform_int_distribution<size_t> any_hot(0, hot.size() - 1);
+
+		std::vector<size_t> random_order(LOOKUP_COUNT);
+		std::vector<size_t> hot_order(LOOKUP_COUNT);
+		for (size_t i = 0; i < LOOKUP_COUNT; ++i)
+		{
+			random_order[i] = any(random);
+			hot_order[i] = hot[any_hot(random)];
+		}
+
+		const double random_time = time_hits(*cache, resources,
+			random_order);
+		const double hot_time = time_hits(*cache, resources, hot_order);
+		printf("%12zu %14.1f %14.1f\n", count, random_time, hot_time);
+		fflush(stdout);
+
+		safe_delete(cache);
+	}
+	Logger::destroy();
+	return 0;
+}
@@ -0,0 +1,51 @@
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#include "resource/compressed_resource.h"
+
+/// <summary>
+/// Compresses a single file into the compressed resource format. The output
+/// should be named with a .lz extension, so that CompressedResourceLoader
+/// picks it up.
+/// 
+/// Usage: loquat_compress [input file] [output file]
+/// </summary>
+int main(int argc, char* argv[])
+{
+	if (argc != 3)
+	{
+		std::cerr << "Usage: " << argv[0]
+			<< " [input file] [output file]" << std::endl;
+		return 1;
+	}
+
+	std::ifstream input(argv[1], std::ios_base::binary);
+	if (!input)
+	{
+		std::cerr << "Could not open " << argv[1] << std::endl;
+		return 1;
+	}
+	const std::vector<char> data{ std::istreambuf_iterator<char>(input),
+		std::istreambuf_iterator<char>() };
+
+	std::vector<char> compressed;
+	if (!loquat::compress_resource(data.data(), data.size(), compressed))
+	{
+		std::cerr << "Failed to compress " << argv[1] << std::endl;
+		return 1;
+	}
+
+	std::ofstream output(argv[2], std::ios_base::binary | std::ios_base::trunc);
+	output.write(compressed.data(), compressed.size());
+	if (!output)
+	{
+		std::cerr << "Could not write " << argv[2] << std::endl;
+		return 1;
+	}
+
+	std::cout << argv[1] << ": " << data.size() << " -> "
+		<< compressed.size() << " bytes" << std::endl;
+	return 0;
+}
@@ -0,0 +1,38 @@
+#include <iostream>
+
+#include "debug/logger.h"
+#include "main/memory_tracking.h"
+#include "main/memory_utils.h"
+#include "resource/resource_file_pack.h"
+
+namespace loquat
+{
+	Allocator* g_allocator = new Allocator(
+		&get_memory_resource(MemoryTag::General));
+}
+
+/// <summary>
+/// Packs a resource folder into a single resource pack.
+/// 
+/// Usage: loquat_pack [resource folder] [output pack]
+/// </summary>
+int main(int argc, char* argv[])
+{
+	if (argc != 3)
+	{
+		std::cerr << "Usage: " << argv[0]
+			<< " [resource folder] [output pack]" << std::endl;
+		return 1;
+	}
+
+	Logger::init();
+	const bool packed = loquat::ResourceFilePack::build(argv[1], argv[2]);
+	Logger::destroy();
+
+	if (!packed)
+	{
+		std::cerr << "Failed to pack " << argv[1] << std::endl;
+		return 1;
+	}
+	return 0;
+}